@@ -27,6 +27,8 @@
 #include "CL_layout_classes.h"
 #include "NL_genericinput.h"
 #include "NL_population.h"
+#include "SC_export_cache.h"
+#include "SC_error_reporter.h"
 
 QString dim::toString()
 {
@@ -486,13 +488,11 @@ void Component::load(QDomDocument *doc)
     QStringList validated = validateComponent();
 #ifdef _OUTPUT_A_MESSAGE_ABOUT_VALIDATION_
     if (validated.size() > 1) {
-        QMessageBox msgBox;
         QString message;
         for (int i = 0; i < (int) validated.size(); ++i) {
             message += validated[i] + "\n";
         }
-        msgBox.setText(message);
-        msgBox.exec();
+        errorReporter::report(message);
     }
 #endif
 }
@@ -540,12 +540,7 @@ void Component::write(QDomDocument *doc)
 
     if (!errors.isEmpty()) {
         // display errors
-        QMessageBox msgBox;
-        msgBox.setText("<P><b>" + this->name + ":Component validation failed</b></P>" + errors);
-        msgBox.setIcon(QMessageBox::Warning);
-        msgBox.setTextFormat(Qt::RichText);
-        msgBox.setModal(false);
-        msgBox.exec();
+        errorReporter::report("<P><b>" + this->name + ":Component validation failed</b></P>" + errors, QMessageBox::Warning, Qt::RichText);
         return;
     }
 
@@ -1755,23 +1750,20 @@ void ParameterInstance::writeExplicitListNodeData(QXmlStreamWriter &xmlOut)
         xmlOut.writeAttribute("file_name", uniqueName);
         xmlOut.writeAttribute("num_elements", QString::number(this->value.size()));
 
-        // write out binary data
-        QFile export_file(saveFileName);
-
-        if (!export_file.open( QIODevice::WriteOnly | QIODevice::Truncate)) {
-            QMessageBox msgBox;
-            msgBox.setText("Error creating binary file '" + saveFileName
-                           + "' - is there sufficient disk space?");
-            msgBox.exec();
-            return;
+        // write out the data, index first, then value, then next
+        // index-value pair... An unchanged file isn't rewritten when
+        // exporting for a run.
+        QByteArray data;
+        data.reserve(this->value.size() * (sizeof(int) + sizeof(double)));
+        for (int i = 0; i < this->value.size(); ++i) {
+            data.append((const char*) &this->indices[i], sizeof(int));
+            data.append((const char*) &this->value[i], sizeof(double));
         }
 
-        // write out the data to the save file, index first, then
-        // value, then next index-value pair...
-        QDataStream access(&export_file);
-        for (int i = 0; i < this->value.size(); ++i) {
-            access.writeRawData((char*) &this->indices[i], sizeof(int));
-            access.writeRawData((char*) &this->value[i], sizeof(double));
+        if (!exportCache::writeFile(saveFileName, data)) {
+            errorReporter::report("Error creating binary file '" + saveFileName
+                                  + "' - is there sufficient disk space?");
+            return;
         }
 
         xmlOut.writeEndElement(); // valueList
@@ -2487,12 +2479,7 @@ Component& Component::operator=(const Component& data)
 
     if (!errors.isEmpty()) {
         // display errors
-        QMessageBox msgBox;
-        msgBox.setText("<P><b>Component validation failed</b></P>" + errors);
-        msgBox.setIcon(QMessageBox::Warning);
-        msgBox.setTextFormat(Qt::RichText);
-        msgBox.setModal(false);
-        msgBox.exec();
+        errorReporter::report("<P><b>Component validation failed</b></P>" + errors, QMessageBox::Warning, Qt::RichText);
     }
 
     return *this;
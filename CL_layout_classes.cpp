@@ -23,6 +23,9 @@
 ****************************************************************************/
 
 #include "CL_layout_classes.h"
+#include "SC_error_reporter.h"
+#include <QCryptographicHash>
+#include <QTemporaryFile>
 
 NineMLLayout::NineMLLayout(QSharedPointer<NineMLLayout>data)
 {
@@ -100,13 +103,11 @@ NineMLLayout& NineMLLayout::operator=(const NineMLLayout& data)
     }
     QStringList validated = validateComponent();
     if (validated.size() > 1) {
-        QMessageBox msgBox;
         QString message;
         for (int i = 0; i < (int) validated.size(); ++i) {
             message += validated[i] + "\n";
         }
-        msgBox.setText(message);
-        msgBox.exec();
+        errorReporter::report(message);
     }
 
     return *this;
@@ -241,13 +242,11 @@ void NineMLLayout::load(QDomDocument *doc)
     // validate this
     QStringList validated = validateComponent();
     if (validated.size() > 1) {
-        QMessageBox msgBox;
         QString message;
         for (int i = 0; i < (int) validated.size(); ++i) {
             message += validated[i] + "\n";
         }
-        msgBox.setText(message);
-        msgBox.exec();
+        errorReporter::report(message);
     }
 }
 
@@ -256,13 +255,11 @@ void NineMLLayout::write(QDomDocument *doc)
     // validate this
     QStringList validated = validateComponent();
     if (validated.size() > 1) {
-        QMessageBox msgBox;
         QString message;
         for (int i = 0; i < (int) validated.size(); ++i) {
             message += validated[i] + "\n";
         }
-        msgBox.setText(message);
-        msgBox.exec();
+        errorReporter::report(message);
     }
 
     // write out:
@@ -450,9 +447,316 @@ void rotateAxes(axisType axis, float angle, float x[3], float y[3], float z[3])
 }
 
 
-void NineMLLayoutData::generateLayout(int numNeurons, QVector <loc> *locations, QString &errRet) {
+/*!
+ * A uniform grid of cells minimumDistance wide, holding the locations placed
+ * so far, so that a candidate location need only be checked against those in
+ * its own cell and the 26 cells around it, rather than against all of them.
+ */
+class layoutDistanceGrid {
+public:
+    layoutDistanceGrid(double minDist);
+    /*!
+     * True if l is closer than minDist to any of the locations in locs
+     * which have been inserted.
+     */
+    bool tooClose(const QVector <loc>& locs, const loc& l) const;
+    //! Add locs[idx] to the grid.
+    void insert(const QVector <loc>& locs, int idx);
+
+private:
+    qint64 cellOf(float v) const;
+    static quint64 key(qint64 ix, qint64 iy, qint64 iz);
+
+    double cellSize;
+    double minDist2;
+    //! The last location inserted into each occupied cell
+    QHash <quint64, int> heads;
+    //! For each location, the previous one inserted into its cell, or -1
+    QVector <int> next;
+};
+
+layoutDistanceGrid::layoutDistanceGrid(double minDist)
+{
+    this->cellSize = minDist;
+    this->minDist2 = pow(minDist, 2);
+}
+
+qint64 layoutDistanceGrid::cellOf(float v) const
+{
+    return (qint64) floor(v / this->cellSize);
+}
+
+quint64 layoutDistanceGrid::key(qint64 ix, qint64 iy, qint64 iz)
+{
+    // 21 bits per axis; distant cells may share a key, which only costs a
+    // few extra distance tests
+    return ((quint64)(ix & 0x1FFFFF) << 42) | ((quint64)(iy & 0x1FFFFF) << 21) | (quint64)(iz & 0x1FFFFF);
+}
+
+bool layoutDistanceGrid::tooClose(const QVector <loc>& locs, const loc& l) const
+{
+    qint64 cx = this->cellOf(l.x);
+    qint64 cy = this->cellOf(l.y);
+    qint64 cz = this->cellOf(l.z);
+    for (qint64 ix = cx-1; ix <= cx+1; ++ix) {
+        for (qint64 iy = cy-1; iy <= cy+1; ++iy) {
+            for (qint64 iz = cz-1; iz <= cz+1; ++iz) {
+                QHash <quint64, int>::const_iterator h = this->heads.find(key(ix, iy, iz));
+                if (h == this->heads.end()) {
+                    continue;
+                }
+                for (int n = h.value(); n != -1; n = this->next[n]) {
+                    double dx = locs[n].x - l.x;
+                    double dy = locs[n].y - l.y;
+                    double dz = locs[n].z - l.z;
+                    if (dx*dx + dy*dy + dz*dz < this->minDist2) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
+
+void layoutDistanceGrid::insert(const QVector <loc>& locs, int idx)
+{
+    if (this->next.size() <= idx) {
+        this->next.resize(idx+1);
+    }
+    quint64 k = key(this->cellOf(locs[idx].x), this->cellOf(locs[idx].y), this->cellOf(locs[idx].z));
+    QHash <quint64, int>::iterator h = this->heads.find(k);
+    if (h == this->heads.end()) {
+        this->next[idx] = -1;
+        this->heads.insert(k, idx);
+    } else {
+        this->next[idx] = h.value();
+        h.value() = idx;
+    }
+}
 
-    float result = 0;
+/*!
+ * The state used to generate a layout's locations one at a time: a copy of
+ * the variables, and a register file for each compiled equation, so that
+ * each thread can have its own.
+ */
+class layoutEvaluator {
+public:
+    layoutEvaluator(const vector <layoutProgram>& alprogs, const vector <layoutProgram>& trprogs,
+                    const vector <int>& trslot, int aliasBase, const vector <float>& vars,
+                    int xslot, int yslot, int zslot);
+    /*!
+     * Run the aliases, then the translations, on vars, with random numbers
+     * from rng, and return the resulting location.
+     */
+    loc step(layoutRandom& rng);
+
+    vector <float> vars;
+
+private:
+    const vector <layoutProgram>& alprogs;
+    const vector <layoutProgram>& trprogs;
+    const vector <int>& trslot;
+    int aliasBase;
+    int xslot;
+    int yslot;
+    int zslot;
+    vector < vector <float> > alregs;
+    vector < vector <float> > trregs;
+};
+
+layoutEvaluator::layoutEvaluator(const vector <layoutProgram>& alprogs, const vector <layoutProgram>& trprogs,
+                                 const vector <int>& trslot, int aliasBase, const vector <float>& vars,
+                                 int xslot, int yslot, int zslot)
+    : vars(vars), alprogs(alprogs), trprogs(trprogs), trslot(trslot)
+{
+    this->aliasBase = aliasBase;
+    this->xslot = xslot;
+    this->yslot = yslot;
+    this->zslot = zslot;
+    this->alregs.resize(alprogs.size());
+    for (uint j = 0; j < alprogs.size(); ++j) {
+        this->alregs[j].resize(alprogs[j].numRegs());
+        alprogs[j].initRegs(&this->alregs[j][0]);
+    }
+    this->trregs.resize(trprogs.size());
+    for (uint t = 0; t < trprogs.size(); ++t) {
+        this->trregs[t].resize(trprogs[t].numRegs());
+        trprogs[t].initRegs(&this->trregs[t][0]);
+    }
+}
+
+loc layoutEvaluator::step(layoutRandom& rng)
+{
+    // do aliases:
+    for (uint j = 0; j < this->alprogs.size(); ++j) {
+        // assign back to the Alias:
+        this->vars[this->aliasBase+j] = this->alprogs[j].eval(&this->vars[0], &this->alregs[j][0], rng);
+    }
+
+    // do translations
+    for (uint t = 0; t < this->trprogs.size(); ++t) {
+        float result = this->trprogs[t].eval(&this->vars[0], &this->trregs[t][0], rng);
+        // assign result to the given statevariable
+        if (this->trslot[t] != -1) {
+            this->vars[this->trslot[t]] = result;
+        }
+    }
+
+    loc l = {0,0,0};
+    if (this->xslot != -1) { l.x = this->vars[this->xslot]; }
+    if (this->yslot != -1) { l.y = this->vars[this->yslot]; }
+    if (this->zslot != -1) { l.z = this->vars[this->zslot]; }
+    return l;
+}
+
+// Change this when a change to generateLayout() would give different layouts
+#define LAYOUT_CACHE_VERSION 1
+// The cache directory, in the project directory
+#define LAYOUT_CACHE_DIR ".layout_cache"
+// The size above which the least recently used layouts are removed
+#define LAYOUT_CACHE_MAX_BYTES (Q_INT64_C(64) * 1024 * 1024)
+
+QString NineMLLayoutData::layoutCacheFileName(int numNeurons)
+{
+    QByteArray keyData;
+    QDataStream key(&keyData, QIODevice::WriteOnly);
+    key << (qint32) LAYOUT_CACHE_VERSION;
+    key << this->component->name;
+    for (int i = 0; i < this->component->AliasList.size(); ++i) {
+        key << this->component->AliasList[i]->name << this->component->AliasList[i]->maths->equation;
+    }
+    if (this->component->RegimeList.size() > 0) {
+        RegimeSpace * regime = this->component->RegimeList.front();
+        for (int i = 0; i < regime->TransformList.size(); ++i) {
+            Transform * tr = regime->TransformList[i];
+            key << (qint32) tr->order << (qint32) tr->type << tr->maths->equation;
+            key << (tr->variable ? tr->variable->name : tr->variableName);
+        }
+    }
+    for (int i = 0; i < this->StateVariableList.size(); ++i) {
+        key << this->StateVariableList[i]->name << this->StateVariableList[i]->value[0];
+    }
+    for (int i = 0; i < this->ParameterList.size(); ++i) {
+        // generateLayout() overrides the numNeurons parameter's value with
+        // its argument, which is keyed below
+        if (this->ParameterList[i]->name == "numNeurons") {
+            continue;
+        }
+        key << this->ParameterList[i]->name << this->ParameterList[i]->value[0];
+    }
+    key << (qint32) numNeurons << (qint32) this->seed << this->minimumDistance;
+
+    QString hash = QCryptographicHash::hash(keyData, QCryptographicHash::Sha1).toHex();
+
+    return layoutCacheDir().absoluteFilePath("layout_" + hash + ".bin");
+}
+
+QDir NineMLLayoutData::layoutCacheDir()
+{
+    // Beside the current project's files, if it has been saved...
+    QSettings settings;
+    QFileInfo project(settings.value("files/currentFileName", "").toString());
+    QDir dir;
+    if (project.isDir()) {
+        dir = QDir(project.absoluteFilePath());
+    } else if (project.isFile()) {
+        dir = project.absoluteDir();
+    } else {
+        // ...otherwise in the library directory
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+        dir = QDir(QDesktopServices::storageLocation(QDesktopServices::DataLocation));
+#else
+        dir = QDir(QStandardPaths::writableLocation(QStandardPaths::DataLocation));
+#endif
+    }
+    if (!dir.exists(LAYOUT_CACHE_DIR)) {
+        if (!dir.mkpath(LAYOUT_CACHE_DIR)) {
+            DBG() << "error creating layout cache in" << dir.absolutePath();
+        }
+    }
+    dir.cd(LAYOUT_CACHE_DIR);
+    return dir;
+}
+
+void NineMLLayoutData::evictLayoutCache(QDir dir)
+{
+    // Least recently used first; readLayoutCache() touches the files it uses
+    QFileInfoList files = dir.entryInfoList(QStringList() << "layout_*.bin", QDir::Files, QDir::Time | QDir::Reversed);
+    qint64 total = 0;
+    for (int i = 0; i < files.size(); ++i) {
+        total += files[i].size();
+    }
+    for (int i = 0; i < files.size() && total > LAYOUT_CACHE_MAX_BYTES; ++i) {
+        if (QFile::remove(files[i].absoluteFilePath())) {
+            total -= files[i].size();
+        }
+    }
+}
+
+bool NineMLLayoutData::readLayoutCache(const QString& fileName, int numNeurons, QVector <loc> *locations)
+{
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    qint64 bytes = (qint64) numNeurons * 3 * sizeof(float);
+    if (f.size() != bytes) {
+        return false;
+    }
+    locations->resize(numNeurons);
+    if (bytes == 0) {
+        return true;
+    }
+    uchar * data = f.map(0, bytes);
+    if (data == NULL) {
+        locations->clear();
+        return false;
+    }
+    const float * xyz = (const float *) data;
+    for (int i = 0; i < numNeurons; ++i) {
+        (*locations)[i].x = xyz[3*i];
+        (*locations)[i].y = xyz[3*i+1];
+        (*locations)[i].z = xyz[3*i+2];
+    }
+    f.unmap(data);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+    // mark it as recently used, for evictLayoutCache()
+    f.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+#endif
+    return true;
+}
+
+void NineMLLayoutData::writeLayoutCache(const QString& fileName, const QVector <loc>& locations)
+{
+    QVector <float> xyz(locations.size() * 3);
+    for (int i = 0; i < locations.size(); ++i) {
+        xyz[3*i] = locations[i].x;
+        xyz[3*i+1] = locations[i].y;
+        xyz[3*i+2] = locations[i].z;
+    }
+
+    // Write to a temporary file and rename it into place, so that a reader
+    // never sees a partly written cache
+    QTemporaryFile tmp(fileName + ".XXXXXX");
+    if (!tmp.open()) {
+        DBG() << "NineMLLayoutData::writeLayoutCache(): could not create" << tmp.fileName();
+        return;
+    }
+    qint64 bytes = (qint64) xyz.size() * sizeof(float);
+    if (tmp.write((const char *) xyz.constData(), bytes) != bytes || !tmp.flush()) {
+        DBG() << "NineMLLayoutData::writeLayoutCache(): could not write" << tmp.fileName();
+        return;
+    }
+    tmp.close();
+    // another generation of the same layout may have got there first
+    if (!QFile::exists(fileName) && tmp.rename(fileName)) {
+        tmp.setAutoRemove(false);
+        evictLayoutCache(QFileInfo(fileName).absoluteDir());
+    }
+}
+
+void NineMLLayoutData::generateLayout(int numNeurons, QVector <loc> *locations, QString &errRet) {
 
     locations->clear();
 
@@ -476,6 +780,12 @@ void NineMLLayoutData::generateLayout(int numNeurons, QVector <loc> *locations,
 
     }
 
+    // the same layout may already have been generated
+    QString cacheFileName = this->layoutCacheFileName(numNeurons);
+    if (this->readLayoutCache(cacheFileName, numNeurons, locations)) {
+        return;
+    }
+
     /*float x[3] = {1,0,0};
     float y[3] = {0,1,0};
     float z[3] = {0,0,1};*/
@@ -521,13 +831,11 @@ void NineMLLayoutData::generateLayout(int numNeurons, QVector <loc> *locations,
 
         }
 
-        // create stacks:
-        vector < vector < valop > > trstacks;
+        // compile the equations:
+        vector < layoutProgram > trprogs(order.size());
         for (int trans = 0; trans < order.size(); ++trans) {
             QString err;
-            vector < valop > newStack;
-            trstacks.push_back(newStack);
-            err = createStack(regime->TransformList[order[trans]]->maths->equation, varList, &trstacks.back());
+            err = trprogs[trans].compile(regime->TransformList[order[trans]]->maths->equation, varList);
 
             // if error doing maths...
             if (err != "") {
@@ -539,12 +847,10 @@ void NineMLLayoutData::generateLayout(int numNeurons, QVector <loc> *locations,
                 return;
            }
         }
-        vector < vector < valop > > alstacks;
+        vector < layoutProgram > alprogs(this->component->AliasList.size());
         for (int j = 0; j < this->component->AliasList.size(); ++j) {
             QString err;
-            vector < valop > newStack;
-            alstacks.push_back(newStack);
-            err = createStack(this->component->AliasList[j]->maths->equation, varList, &alstacks.back());
+            err = alprogs[j].compile(this->component->AliasList[j]->maths->equation, varList);
 
             // if error doing maths...
             if (err != "") {
@@ -557,91 +863,132 @@ void NineMLLayoutData::generateLayout(int numNeurons, QVector <loc> *locations,
            }
         }
 
-        srand(this->seed);
-
-        int loop = 0;
-
-        for (int i = 0; i < (int) numNeurons; ++i) {
+        // The programs read the variables from slots, in varList order
+        vector < float > vars(varList.size());
+        for (uint v = 0; v < varList.size(); ++v) {
+            vars[v] = varList[v].value;
+        }
 
-            if (loop > 1000) {
-                errRet = "Cannot satisfy distance constraint";
-                locations->clear();
-                return;
+        // find the slots written by the translations, and the location slots
+        vector < int > trslot(order.size(), -1);
+        for (int trans = 0; trans < order.size(); ++trans) {
+            if (regime->TransformList[order[trans]]->type == TRANSLATE) {
+                for (int j = 0; j < this->StateVariableList.size(); ++j) {
+                    if (varList[j].name == regime->TransformList[order[trans]]->variable->name) {
+                        trslot[trans] = j;
+                    }
+                }
             }
+        }
+        int xslot = -1, yslot = -1, zslot = -1;
+        for (int sv = 0; sv < this->StateVariableList.size(); ++sv) {
+            if (varList[sv].name == "x" ) { xslot = sv; }
+            if (varList[sv].name == "y" ) { yslot = sv; }
+            if (varList[sv].name == "z" ) { zslot = sv; }
+        }
 
-            // back up the variables in case we infringe minimum distance
-            vector < lookup > varListBack = varList;
-
-            // do aliases:
-            for (int j = 0; j < this->component->AliasList.size(); ++j) {
-
-                float result;
-                // find the correct alias
-                //Alias * currAlias;
-
-                //currAlias = this->component->AliasList[j];
+        // A slot carries state from one neuron to the next if it is written
+        // by an alias or translation, and read before that write happens.
+        int aliasBase = this->StateVariableList.size();
+        vector < bool > written(vars.size(), false);
+        for (uint j = 0; j < alprogs.size(); ++j) {
+            written[aliasBase+j] = true;
+        }
+        for (int trans = 0; trans < order.size(); ++trans) {
+            if (trslot[trans] != -1) {
+                written[trslot[trans]] = true;
+            }
+        }
+        vector < bool > done(vars.size(), false);
+        bool carried = false;
+        for (uint j = 0; j < alprogs.size(); ++j) {
+            for (uint v = 0; v < vars.size(); ++v) {
+                if (written[v] && !done[v] && alprogs[j].readsVar(v)) {
+                    carried = true;
+                }
+            }
+            done[aliasBase+j] = true;
+        }
+        for (int trans = 0; trans < order.size(); ++trans) {
+            for (uint v = 0; v < vars.size(); ++v) {
+                if (written[v] && !done[v] && trprogs[trans].readsVar(v)) {
+                    carried = true;
+                }
+            }
+            if (trslot[trans] != -1) {
+                done[trslot[trans]] = true;
+            }
+        }
 
-                result = interpretMaths(alstacks[j]);
+        // Random numbers are drawn from a stream per neuron, so each
+        // neuron's first candidate location depends only on the seed and
+        // its index. Without carried state these are all independent, and
+        // are generated across threads up front.
+        QVector <loc> candidates;
+        QVector <quint32> candidateDraws;
+        if (!carried) {
+            candidates.resize(numNeurons);
+            candidateDraws.resize(numNeurons);
+#pragma omp parallel
+            {
+                layoutEvaluator tev(alprogs, trprogs, trslot, aliasBase, vars, xslot, yslot, zslot);
+#pragma omp for schedule(static)
+                for (int i = 0; i < numNeurons; ++i) {
+                    layoutRandom rng(this->seed, i);
+                    candidates[i] = tev.step(rng);
+                    candidateDraws[i] = rng.draws;
+                }
+            }
+        }
 
-                // assign back to the Alias:
-                varList[StateVariableList.size()+j].value = result;
+        // Accept the candidates in order, so that the minimum distance test
+        // sees the same locations whatever the number of threads; a rejected
+        // neuron carries on along its own stream.
+        layoutEvaluator ev(alprogs, trprogs, trslot, aliasBase, vars, xslot, yslot, zslot);
+        vector < float > varsBack;
 
-            }
+        layoutDistanceGrid grid(this->minimumDistance);
 
-            // do translations
-            for (int trans = 0; trans < order.size(); ++trans) {
+        locations->reserve(numNeurons);
 
-                result = interpretMaths(trstacks[trans]);
+        for (int i = 0; i < (int) numNeurons; ++i) {
 
-                // assign result to the given statevariable
-                if (regime->TransformList[order[trans]]->type == TRANSLATE) {
-                    for (int j = 0; j < this->StateVariableList.size(); ++j) {
-                        if (varList[j].name == regime->TransformList[order[trans]]->variable->name) {
-                            varList[j].value = result;
-                        }
-                    }
-                }
+            // back up the variables in case we infringe minimum distance
+            if (this->minimumDistance > 0) {
+                varsBack = ev.vars;
             }
 
-
-            // write out the location
-            loc newLoc = {0,0,0};
-            for (int sv = 0; sv < this->StateVariableList.size(); ++sv) {
-                if (varList[sv].name == "x" ) {
-                    newLoc.x = varList[sv].value;
-                }
-                if (varList[sv].name == "y" ) {
-                    newLoc.y = varList[sv].value;
-                }
-                if (varList[sv].name == "z" ) {
-                    newLoc.z = varList[sv].value;
-                }
+            layoutRandom rng(this->seed, i);
+            loc newLoc;
+            if (carried) {
+                newLoc = ev.step(rng);
+            } else {
+                newLoc = candidates[i];
+                rng.draws = candidateDraws[i];
             }
 
             // check if minimum distance is infringed:
             if (this->minimumDistance > 0) {
-
-                bool tooClose = false;
-
-                for (int l = 0; l < locations->size(); ++l) {
-                    if (pow((*locations)[l].x - newLoc.x,2) + pow((*locations)[l].y - newLoc.y, 2) + pow((*locations)[l].z - newLoc.z,2) < pow(this->minimumDistance,2)) {
-                        tooClose = true;
-                        break;
+                int loop = 0;
+                while (grid.tooClose(*locations, newLoc)) {
+                    if (++loop > 1000) {
+                        errRet = "Cannot satisfy distance constraint";
+                        locations->clear();
+                        return;
                     }
+                    // do this neuron again!
+                    ev.vars = varsBack;
+                    newLoc = ev.step(rng);
                 }
-                if (!tooClose) {
-                    locations->push_back(newLoc);
-                    loop = 0;
-                } else {
-                    // do this iteration again!
-                    --i;
-                    varList = varListBack;
-                    ++loop;
-                }
-            } else
-                locations->push_back(newLoc);
+            }
 
+            locations->push_back(newLoc);
+            if (this->minimumDistance > 0) {
+                grid.insert(*locations, locations->size()-1);
+            }
         }
+
+        this->writeLayoutCache(cacheFileName, *locations);
     }
 
 
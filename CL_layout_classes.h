@@ -129,6 +129,32 @@ public:
     void import_parameters_from_xml(QDomNode &e);
     void generateLayout(int numNeurons, QVector <loc> *locations, QString &errRet);
     QVector < loc > locations;
+
+private:
+    /*!
+     * The file in layoutCacheDir() which caches the layout for numNeurons
+     * neurons. Its name is a hash of everything which determines the
+     * layout: the component's equations, the parameter (other than
+     * numNeurons, which generateLayout() overrides) and state variable
+     * values, numNeurons, seed and minimumDistance.
+     */
+    QString layoutCacheFileName(int numNeurons);
+    /*!
+     * The layout cache directory: a hidden directory in the current
+     * project's directory, or in the library directory if the project has
+     * not been saved.
+     */
+    static QDir layoutCacheDir();
+    //! Remove the least recently used layouts in dir, to bound its size.
+    static void evictLayoutCache(QDir dir);
+    /*!
+     * Read numNeurons locations from the cache file fileName, which holds
+     * them as packed native float32 x,y,z. Returns false if there is no
+     * usable cache.
+     */
+    bool readLayoutCache(const QString& fileName, int numNeurons, QVector <loc> *locations);
+    //! Write locations to the cache file fileName.
+    void writeLayoutCache(const QString& fileName, const QVector <loc>& locations);
 };
 
 
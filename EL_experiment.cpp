@@ -26,6 +26,7 @@
 #include "SC_network_layer_rootdata.h"
 #include "SC_projectobject.h"
 #include "SC_utilities.h"
+#include "SC_error_reporter.h"
 #include <QRegularExpression>
 
 experiment::experiment()
@@ -2845,10 +2846,7 @@ void exptOutput::writeXML(QXmlStreamWriter * writer, projectObject * data)
                 QSharedPointer <population> pop = qSharedPointerDynamicCast<population> (source->owner);
                 CHECK_CAST(pop)
                 if (inds[i].toInt() < 0 || inds[i].toInt() > pop->numNeurons-1) {
-                    QMessageBox msgBox;
-                    msgBox.setIcon(QMessageBox::Critical);
-                    msgBox.setText("Output index out of range - indices must be between 0 and the number of neurons - 1. Output will not be logged.");
-                    msgBox.exec();
+                    errorReporter::report("Output index out of range - indices must be between 0 and the number of neurons - 1. Output will not be logged.", QMessageBox::Critical);
                     return;
                 }
             }
@@ -2857,10 +2855,7 @@ void exptOutput::writeXML(QXmlStreamWriter * writer, projectObject * data)
                 CHECK_CAST(proj)
                 QSharedPointer <population> pop = proj->destination;
                 if (inds[i].toInt() < 0 || inds[i].toInt() > pop->numNeurons-1) {
-                    QMessageBox msgBox;
-                    msgBox.setIcon(QMessageBox::Warning);
-                    msgBox.setText("Output index out of range - indices must be between 0 and the number of target neurons - 1. Output will not be logged.");
-                    msgBox.exec();
+                    errorReporter::report("Output index out of range - indices must be between 0 and the number of target neurons - 1. Output will not be logged.", QMessageBox::Warning);
                     return;
                 }
             }
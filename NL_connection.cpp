@@ -42,15 +42,33 @@ get_caller_info (PyObject* self, PyObject* args)
 #endif
 
 #include <cmath>
+#include <cstring>
+#include <cstddef>
 #include <QUuid>
 #include <QSettings>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "NL_connection.h"
+#include "SC_utilities.h"
 #include "SC_layout_cinterpreter.h"
-#include "SC_python_connection_generate_dialog.h"
+#include "SC_python_connection_worker.h"
+#include "SC_export_cache.h"
+#include "SC_error_reporter.h"
 #include "SC_viewVZlayoutedithandler.h"
 #include "filteroutundoredoevents.h"
 
+// progress, in percent, of a connection script job at each stage. The part
+// between the start and end of the script is filled in by the script itself,
+// if it calls spinecreator_progress().
+#define PY_PROGRESS_SCRIPT_START 10
+#define PY_PROGRESS_SCRIPT_END 90
+#define PY_PROGRESS_UNPACKED 95
+
+//! The fewest rows setData() grows the mapped data file to
+#define MIN_MAPPED_ROWS 1024
+
 connection::connection()
 {
     this->type = none;
@@ -513,6 +531,11 @@ csv_connection::csv_connection()
     this->values.push_back("delay");
 
     copiedFrom = NULL;
+    importCancelled = false;
+
+    this->cacheCols = -1;
+    this->mapped = (uchar*)0;
+    this->mappedRows = 0;
 
     // Generate the unique UUID style filename here in the constructor.
     this->generateUUIDFilename();
@@ -535,6 +558,8 @@ QDir csv_connection::getLibDir (void) const
 
 csv_connection::~csv_connection()
 {
+    this->unmapData();
+
     // remove generator
     if (this->generator) {
         delete this->generator;
@@ -668,17 +693,19 @@ void csv_connection::write_node_xml(QXmlStreamWriter &xmlOut)
         this->generateFilename();
     }
 
+    // The data file is read directly below
+    this->unmapData();
+
     QFile f;
     QDir lib_dir = this->getLibDir(); // This is the temporary location for conn data files
     f.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
     if (!f.open( QIODevice::ReadOnly)) {
-        QMessageBox msgBox;
-        msgBox.setText("csv_connection::write_node_xml(QXmlStreamWriter &xmlOut): Could not open temporary file '" + f.fileName() + "' for Explicit Connection");
-        msgBox.exec();
+        errorReporter::report("csv_connection::write_node_xml(QXmlStreamWriter &xmlOut): Could not open temporary file '" + f.fileName() + "' for Explicit Connection");
         return;
     }
     f.seek(0);
     QDataStream access(&f);
+    this->setupPackedStream (access);
 
     // ok, check if we have a generator, and if it is up-to-date
     if (this->generator) {
@@ -687,7 +714,7 @@ void csv_connection::write_node_xml(QXmlStreamWriter &xmlOut)
         // if we have changes then...
         if (pyConn->changed()) {
             // ... regenerate the connectivity!
-            pyConn->regenerateConnections();
+            pyConn->regenerateForExport();
         }
     }
 
@@ -744,10 +771,8 @@ void csv_connection::write_node_xml(QXmlStreamWriter &xmlOut)
         project_dir.cdUp();
 
         if (this->filename.isEmpty()) {
-            QMessageBox msgBox;
-            msgBox.setText("Error creating exported binary connection file srcName/dstName:'" + this->srcName
-                           + "/" + this->dstName + "' (filename could not be generated from src/dest population names)");
-            msgBox.exec();
+            errorReporter::report("Error creating exported binary connection file srcName/dstName:'" + this->srcName
+                                  + "/" + this->dstName + "' (filename could not be generated from src/dest population names)");
             return;
         }
         saveFullFileName = QDir::toNativeSeparators(project_dir.absoluteFilePath(this->filename));
@@ -764,52 +789,19 @@ void csv_connection::write_node_xml(QXmlStreamWriter &xmlOut)
         xmlOut.writeAttribute("explicit_delay_flag", QString::number(float(getNumCols()==3)));
         xmlOut.writeAttribute("packed_data", "true");
 
-        // re-write the data
-        if (getNumCols()==3) {
-            QVector <conn> conns;
-            this->getAllData(conns);
-
-            // write out
-            QFile export_file(saveFullFileName);
-
-            if (!export_file.open( QIODevice::WriteOnly)) {
-                QMessageBox msgBox;
-                msgBox.setText("Error creating exported binary connection file '" + saveFullFileName
-                               + "' (Check disk space; permissions)");
-                msgBox.exec();
-                return;
-            }
-
-            QDataStream access2(&export_file);
-            for (int i = 0; i < conns.size(); ++i) {
-                access2.writeRawData((char*) &conns[i].src, sizeof(int));
-                access2.writeRawData((char*) &conns[i].dst, sizeof(int));
-                access2.writeRawData((char*) &conns[i].metric, sizeof(float));
-            }
-        }
-        if (getNumCols()==2) {
-            QVector <conn> conns;
-            this->getAllData(conns);
-
-            // write out
-            QFile export_file(saveFullFileName);
-
-            if (!export_file.open( QIODevice::WriteOnly)) {
-                QMessageBox msgBox;
-                msgBox.setText("Error creating exported binary connection file '" + saveFullFileName
-                               + "' (Check disk space; permissions)");
-                msgBox.exec();
-                return;
-            }
-
-            QDataStream access3(&export_file);
-            for (int i = 0; i < conns.size(); ++i) {
-                access3.writeRawData((char*) &conns[i].src, sizeof(int));
-                access3.writeRawData((char*) &conns[i].dst, sizeof(int));
-            }
+        // The working data file is already in the packed format, so copy it.
+        // Close our handle first (the regeneration above may have replaced it).
+        // The data file may hold rows past numRows (the row count is
+        // reduced without truncating it), or fewer; pad or trim to numRows.
+        // When exporting for a run, an unchanged file isn't copied again.
+        f.close();
+        qint64 exportSize = (qint64)this->getNumRows() * this->rowBytes(this->getNumCols());
+        if (!exportCache::copyFile(lib_dir.absoluteFilePath(this->uuidFilename), saveFullFileName, exportSize)) {
+            errorReporter::report("Error creating exported binary connection file '" + saveFullFileName
+                                  + "' (Check disk space; permissions)");
+            return;
         }
 
-
     } else { // non-binary; write only into XML
 
         // loop through connections writing them out in XML format.
@@ -884,6 +876,9 @@ void csv_connection::import_parameters_from_xml(QDomNode &e)
 
     QDomNodeList BinaryFileList = e.toElement().elementsByTagName("BinaryFile");
 
+    // The data file is about to be replaced
+    this->unmapData();
+
     if (BinaryFileList.count() == 1) {
 
         // is a binary file so load accordingly
@@ -942,13 +937,11 @@ void csv_connection::import_parameters_from_xml(QDomNode &e)
 
             // open the storage file
             if( !f.open( QIODevice::ReadWrite | QIODevice::Truncate) ) {
-                QMessageBox msgBox;
-                msgBox.setText("csv_connection::import_parameters_from_xml(QDomNode &e): Could not open temporary file '" + f.fileName() + "' for Explicit Connection");
-                msgBox.exec();
+                errorReporter::report("csv_connection::import_parameters_from_xml(QDomNode &e): Could not open temporary file '" + f.fileName() + "' for Explicit Connection");
                 return;
             }
 
-            // now we need to read from the savedData file and put this into a QDataStream...
+            // the saved file is in the working format already, so copy it over
             this->import_packed_binary(savedData, f);
             f.close();
 
@@ -968,12 +961,11 @@ void csv_connection::import_parameters_from_xml(QDomNode &e)
         QDir lib_dir = this->getLibDir();
         f.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
         if (!f.open( QIODevice::ReadWrite | QIODevice::Truncate)) {
-            QMessageBox msgBox;
-            msgBox.setText("csv_connection::import_parameters_from_xml(QDomNode &e) [2]: Could not open temporary file '" + f.fileName() + "' for Explicit Connection");
-            msgBox.exec();
+            errorReporter::report("csv_connection::import_parameters_from_xml(QDomNode &e) [2]: Could not open temporary file '" + f.fileName() + "' for Explicit Connection");
             return;
         }
         QDataStream access(&f);
+        this->setupPackedStream (access);
 
         QDomNodeList connInstList = e.toElement().elementsByTagName("Connection");
 
@@ -1046,7 +1038,84 @@ void csv_connection::fetch_headings()
 {
 }
 
-bool csv_connection::import_csv (QString fileName)
+/*!
+ * The columns parsed from one chunk of a connection CSV file, and the
+ * lines in it which couldn't be parsed.
+ */
+struct connCSVChunk {
+    QVector<qint32> src;
+    QVector<qint32> dst;
+    QVector<float> delay;
+    //! The number of lines in the chunk
+    qint64 lines;
+    //! Chunk relative line numbers of the malformed lines, and the number
+    //! of fields found on each (or -1 where a field wasn't a number)
+    QVector<qint64> badLines;
+    QVector<int> badFields;
+    qint64 numBad;
+};
+
+static inline const char* skipCSVBlanks (const char* p, const char* end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) { ++p; }
+    return p;
+}
+
+static void parseConnCSVChunk (const char* p, const char* end, int numFields, connCSVChunk& out)
+{
+    out.lines = 0;
+    out.numBad = 0;
+    for (; p < end; ++out.lines) {
+        const char* eol = (const char*)memchr (p, '\n', end-p);
+        if (eol == (const char*)0) {
+            eol = end;
+        }
+        const char* q = skipCSVBlanks (p, eol);
+        p = eol+1;
+
+        // blank line or comment
+        if (q == eol || *q == '#') {
+            continue;
+        }
+
+        int nf = 1;
+        for (const char* c = q; c < eol; ++c) {
+            if (*c == ',') { ++nf; }
+        }
+        double v[3];
+        if (nf == numFields) {
+            for (int f = 0; f < nf; ++f) {
+                q = SCUtilities::parseNumber (skipCSVBlanks (q, eol), eol, v[f]);
+                if (q == (const char*)0) {
+                    nf = -1;
+                    break;
+                }
+                q = skipCSVBlanks (q, eol);
+                if (q < eol && *q == ',') { ++q; }
+            }
+            if (q != (const char*)0 && q != eol) {
+                // trailing text after the last field
+                nf = -1;
+            }
+        }
+        if (nf != numFields) {
+            if (out.numBad < CONN_IMPORT_MAX_ERRORS) {
+                out.badLines.push_back(out.lines);
+                out.badFields.push_back(nf);
+            }
+            ++out.numBad;
+            continue;
+        }
+
+        out.src.push_back((qint32)v[0]);
+        out.dst.push_back((qint32)v[1]);
+        if (numFields == 3) {
+            out.delay.push_back((float)v[2]);
+        }
+    }
+}
+
+bool csv_connection::import_csv (QString fileName, QStringList* errors)
 {
     DBG() << "csv_connection::import_csv(" << fileName << ") called.";
 
@@ -1055,94 +1124,122 @@ bool csv_connection::import_csv (QString fileName)
         return false;
     }
 
-    // Assume import fails to work. Set true once import has succeeded.
-    bool import_worked = false;
+    QStringList localErrors;
+    if (errors == (QStringList*)0) {
+        errors = &localErrors;
+    }
 
     // open the input csv file for reading
     QFile fileIn(fileName);
     if (!fileIn.open(QIODevice::ReadOnly)) {
-        QMessageBox msgBox;
-        msgBox.setText("Could not open the selected CSV file");
-        msgBox.exec();
-        return import_worked;
+        errorReporter::report("Could not open the selected CSV file");
+        return false;
     }
 
-    QFile f;
-    QDir lib_dir = this->getLibDir();
-    // Set up a temporary uuid
-    f.setFileName(lib_dir.absoluteFilePath (this->uuidFilename));
-    if (!f.open( QIODevice::ReadWrite | QIODevice::Truncate)) {
-        QMessageBox msgBox;
-        msgBox.setText("csv_connection::import_csv(QString): Could not open temporary file '"
-                       + f.fileName() + "' for Explicit Connection");
-        msgBox.exec();
-        return import_worked;
-    } // else the data file for this connection has now been truncated, so numRows can be set to 0.
-
-    this->numRows = 0;
     this->changes.clear();
+    this->importCancelled = false;
 
-    // use textstream so we can read lines into a QString
-    QTextStream stream(&fileIn);
-    QDataStream access(&f);
-
-    // test for consistency:
-    int numFields = -1;
-
-    // load in the csv line by line
-    while (!(stream.atEnd())) {
-
-        // get a line
-        QString line = stream.readLine();
-
-        // see if it is a comment:
-        if (line[0] == '#') {
-            continue;
-        }
-
-        // or a blank line
-        QString line2 = line;
-        line2.replace(" ", "");
-        if (line2 == "\n") {
-            continue;
+    qint64 size = fileIn.size();
+    uchar* mapped = size > 0 ? fileIn.map (0, size) : (uchar*)0;
+    if (mapped == (uchar*)0) {
+        errors->push_back("Could not read " + fileName + ": " + (size > 0 ? fileIn.errorString() : QString("the file is empty")));
+        return false;
+    }
+    const char* text = (const char*)mapped;
+    const char* end = text + size;
+
+    // The first line which isn't blank or a comment sets the number of fields
+    int numFields = 0;
+    for (const char* p = text; p < end && numFields == 0; ) {
+        const char* eol = (const char*)memchr (p, '\n', end-p);
+        if (eol == (const char*)0) {
+            eol = end;
+        }
+        const char* q = skipCSVBlanks (p, eol);
+        if (q != eol && *q != '#') {
+            numFields = 1;
+            for (; q < eol; ++q) {
+                if (*q == ',') { ++numFields; }
+            }
         }
+        p = eol+1;
+    }
+    if (numFields > 3) {
+        errors->push_back("CSV file has too many columns");
+        fileIn.unmap (mapped);
+        return false;
+    }
+    if (numFields < 2) {
+        errors->push_back("CSV file has too few columns");
+        fileIn.unmap (mapped);
+        return false;
+    }
 
-        // not a comment - so begin parsing and create an xml element
-        this->numRows++;
-
-        QStringList fields = line.split(",");
+    // Divide into chunks which each start at the beginning of a line
+    QVector<const char*> starts;
+    starts.push_back(text);
+    while (starts.last() < end) {
+        const char* c = starts.last() + CONN_IMPORT_CHUNK_BYTES;
+        const char* nl = c < end ? (const char*)memchr (c, '\n', end-c) : (const char*)0;
+        starts.push_back(nl ? nl+1 : end);
+    }
+    int nChunks = starts.size()-1;
 
-        if (fields.size() > 3) {
-            QMessageBox msgBox;
-            msgBox.setText("CSV file has too many columns");
-            msgBox.exec();
-            return import_worked;
+    // Parse a chunk per thread at a time, reporting progress (and processing
+    // events, so that the import can be cancelled) between rounds
+    int perRound = 1;
+#ifdef _OPENMP
+    perRound = omp_get_max_threads();
+#endif
+    QVector<qint32> srcs;
+    QVector<qint32> dsts;
+    QVector<float> delays;
+    qint64 linesBefore = 0;
+    qint64 numBad = 0;
+    for (int c0 = 0; c0 < nChunks; c0 += perRound) {
+        int c1 = qMin (nChunks, c0 + perRound);
+        QVector<connCSVChunk> parts(c1-c0);
+
+#pragma omp parallel for schedule(dynamic,1)
+        for (int c = c0; c < c1; ++c) {
+            parseConnCSVChunk (starts[c], starts[c+1], numFields, parts[c-c0]);
+        }
+
+        for (int i = 0; i < parts.size(); ++i) {
+            connCSVChunk& part = parts[i];
+            srcs += part.src;
+            dsts += part.dst;
+            delays += part.delay;
+            for (int b = 0; b < part.badLines.size() && numBad + b < CONN_IMPORT_MAX_ERRORS; ++b) {
+                qint64 lineNum = linesBefore + part.badLines[b] + 1;
+                if (part.badFields[b] == -1) {
+                    errors->push_back(QString("Line %1: not a number").arg(lineNum));
+                } else {
+                    errors->push_back(QString("Line %1: expected %2 fields, found %3")
+                                      .arg(lineNum).arg(numFields).arg(part.badFields[b]));
+                }
+            }
+            numBad += part.numBad;
+            linesBefore += part.lines;
+            part = connCSVChunk();
         }
 
-        if (fields.size() < 2) {
-            QMessageBox msgBox;
-            msgBox.setText("CSV file has too few columns");
-            msgBox.exec();
-            return import_worked;
+        // The rest of the progress is for writing out
+        emit progress ((int)((starts[c1]-text) * 90 / size));
+        QCoreApplication::processEvents();
+        if (this->importCancelled) {
+            fileIn.unmap (mapped);
+            errors->push_back("Import cancelled");
+            return false;
         }
+    }
+    fileIn.unmap (mapped);
 
-        if (numFields == -1) {
-            numFields = fields.size();
-        } else if (numFields != fields.size()) {
-            DBG() << "something is wrong!";
-            --numRows;
-            continue;
-        }
-        // for each field
-        for (int i = 0; i < (int)fields.size(); ++i) {
-            if (i < 2) {
-                qint32 num = fields[i].toUInt();
-                access << num;
-            } else {
-                float num = fields[i].toFloat();
-                access << num;
-            }
-        }
+    if (numBad > CONN_IMPORT_MAX_ERRORS) {
+        errors->push_back(QString("... and %1 more malformed lines").arg(numBad - CONN_IMPORT_MAX_ERRORS));
+    }
+    if (numBad > 0) {
+        DBG() << "Skipped" << numBad << "malformed lines importing" << fileName;
     }
 
     values.clear();
@@ -1152,57 +1249,50 @@ bool csv_connection::import_csv (QString fileName)
         if (i == 2) { this->values.push_back("delay"); }
     }
 
-    // flush out the output...
-    f.flush();
-    f.close();
+    // (writeAllData's own progress would restart from 0)
+    this->blockSignals (true);
+    bool written = this->writeAllData (srcs.size(), srcs.constData(), dsts.constData(),
+                                       delays.isEmpty() ? (const float*)0 : delays.constData());
+    this->blockSignals (false);
+    emit progress (100);
+    if (!written) {
+        return false;
+    }
 
     // Sort the connection list now.
     this->sortData();
 
-    import_worked = true;
-    return import_worked;
+    return true;
+}
+
+void csv_connection::cancelImport (void)
+{
+    this->importCancelled = true;
 }
 
 void csv_connection::import_packed_binary(QFile& fileIn, QFile& fileOut)
 {
     this->changes.clear();
+    this->unmapData();
 
     //wipe file;
     fileOut.resize(0);
 
     fileOut.seek(0);
 
-    QDataStream access(&fileOut);
-
-    int count = 0;
-
-    // load in the binary packed data
+    // The packed binary format is also the working format; copy in blocks
+    QByteArray block;
+    qint64 total = 0;
     while (!(fileIn.atEnd())) {
-
-        // read in the required values:
-        // first two int32s
-        int srcVal, dstVal;
-        float delayVal;
-
-        fileIn.read((char *) &srcVal,sizeof(int));
-        fileIn.read((char *) &dstVal,sizeof(int));
-
-        // add the row...
-        qint32 num = srcVal;
-        access << num;
-        num = dstVal;
-        access << num;
-
-        // if we have a delay then read that too
-        if (this->values.size() == 3) {
-            // we have a delay
-            fileIn.read((char *) &delayVal,sizeof(float));
-            access << delayVal;
+        block = fileIn.read(1 << 20);
+        if (block.isEmpty()) {
+            break;
         }
-        ++count;
+        fileOut.write(block);
+        total += block.size();
     }
 
-    if (count != this->getNumRows()) {
+    if (total != (qint64)this->getNumRows() * this->rowBytes(this->values.size())) {
         DBG() << "Mismatch between the number of rows in the XML and in the binary file";
     }
 
@@ -1259,131 +1349,139 @@ bool csv_connection::sorttwo (conn a, conn b)
     return false;
 }
 
-// Note that the connection file contains src, dst and delay. The
-// weights may be held in a separate file (an explicitDataBinaryFile).
-void csv_connection::getAllData(QVector<conn>& conns)
+int csv_connection::rowBytes (int nc) const
 {
-    //DBG() << "csv_connection::getAllData called";
-    conns.clear();
+    // (int S)(int D)(opt float L), close packed, in the host's byte order
+    return nc > 2 ? 12 : 8;
+}
 
-    QFile f;
-    QDir lib_dir = this->getLibDir();
-    f.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
-    if (!f.open( QIODevice::ReadOnly)) {
-        return;
+void csv_connection::setupPackedStream (QDataStream& ds) const
+{
+    if (QSysInfo::ByteOrder == QSysInfo::LittleEndian) {
+        ds.setByteOrder (QDataStream::LittleEndian);
+    } else {
+        ds.setByteOrder (QDataStream::BigEndian);
     }
+    ds.setFloatingPointPrecision (QDataStream::SinglePrecision);
+}
 
-    QDataStream access(&f);
+void csv_connection::mapData (void) const
+{
+    int nc = this->getNumCols();
+    if (this->cacheCols == nc) {
+        return;
+    }
+    // (Re)map; the number of columns may have changed since the last map
+    this->unmapData();
+    this->cacheCols = nc;
 
-    //DBG() << "There are " << this->getNumRows() << " rows and " << this->getNumCols() << " cols";
-    conns.resize(this->getNumRows());
-    int counter = 0;
+    QDir lib_dir = this->getLibDir();
+    this->mapFile.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
+    if (!this->mapFile.open( QIODevice::ReadWrite)) {
+        errorReporter::report("csv_connection::mapData(): Could not open temporary file "
+                              + this->uuidFilename + " for Explicit Connection");
+        return;
+    }
+    this->mapRows (this->mapFile.size() / this->rowBytes(nc));
+}
 
-    for (int i = 0; i < this->getNumRows(); ++i) {
+void csv_connection::mapRows (int rows) const
+{
+    if (this->mapped != (uchar*)0) {
+        this->mapFile.unmap(this->mapped);
+        this->mapped = (uchar*)0;
+    }
+    this->mappedRows = 0;
+    if (rows == 0 || !this->mapFile.isOpen()) {
+        // Can't map an empty file
+        return;
+    }
+    qint64 sz = (qint64)rows * this->rowBytes(this->cacheCols);
+    if (this->mapFile.size() < sz && !this->mapFile.resize(sz)) {
+        DBG() << "Couldn't resize" << this->mapFile.fileName() << ":" << this->mapFile.errorString();
+        return;
+    }
+    this->mapped = this->mapFile.map(0, sz);
+    if (this->mapped == (uchar*)0) {
+        DBG() << "Couldn't map" << this->mapFile.fileName() << ":" << this->mapFile.errorString();
+        return;
+    }
+    this->mappedRows = rows;
+}
 
-        conn newConn;
-        qint32 src;
-        qint32 dst;
+void csv_connection::unmapData (void) const
+{
+    if (this->mapped != (uchar*)0) {
+        this->mapFile.unmap(this->mapped);
+    }
+    if (this->mapFile.isOpen()) {
+        this->mapFile.close();
+    }
+    this->mapped = (uchar*)0;
+    this->mappedRows = 0;
+    this->cacheCols = -1;
+}
 
-        access >> src;
-        access >> dst;
+void csv_connection::flushChangesToDisk (void) const
+{
+    // The mapping is shared with the file, so this only has to release it
+    this->unmapData();
+}
 
-        if (this->getNumCols() > 2) {
-            float temp_delay;
-            access >> temp_delay;
-            newConn.metric = temp_delay;
+// Note that the connection file contains src, dst and delay. The
+// weights may be held in a separate file (an explicitDataBinaryFile).
+void csv_connection::getAllData(QVector<conn>& conns)
+{
+    //DBG() << "csv_connection::getAllData called";
+    this->mapData();
+
+    int rows = this->getNumRows();
+    int rb = this->rowBytes(this->cacheCols);
+    conns.resize(rows);
+
+    const uchar* p = this->mapped;
+    for (int i = 0; i < rows; ++i) {
+        conn& c = conns[i];
+        if (i < this->mappedRows) {
+            memcpy (&c.src, p, sizeof(qint32));
+            memcpy (&c.dst, p+4, sizeof(qint32));
+            if (this->cacheCols > 2) {
+                memcpy (&c.metric, p+8, sizeof(float));
+            }
+            p += rb;
+        } else {
+            // past the end of the data file
+            c.src = 0;
+            c.dst = 0;
+            if (this->cacheCols > 2) {
+                c.metric = 0;
+            }
         }
-
-        newConn.src = src;
-        newConn.dst = dst;
-
-        conns[counter] = (newConn);
-        ++counter;
     }
-
-    f.close();
 }
 
 float csv_connection::getData(int rowV, int col) const
 {
-    QFile f;
-    QDir lib_dir = this->getLibDir();
-    f.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
-    if (!f.open( QIODevice::ReadOnly)) {
-        QMessageBox msgBox;
-        msgBox.setText("csv_connection::getData(int, int): Could not open file for Explicit Connection");
-        msgBox.exec();
-        return -0.1f;
-    }
+    this->mapData();
 
-    // we multiply by cols +1 as QT seems to do some padding on the stream
-    int colVal = this->getNumCols();
-    if (colVal > 2) { ++colVal; }
-    int seekTo = rowV*(colVal)+col;
-
-    if (seekTo*4 > f.size()) {
+    if (rowV < 0 || rowV >= this->mappedRows || col < 0 || col >= this->cacheCols) {
         return -1;
     }
-
-    f.seek(seekTo*4); // seek to location in bytes
-
-    // get a datastream to serialise the data
-    QDataStream access(&f);
+    const uchar* p = this->mapped + (qint64)rowV * this->rowBytes(this->cacheCols) + col*4;
     if (col < 2) {
         qint32 data;
-        access >> data;
-        f.close();
+        memcpy (&data, p, sizeof(data));
         return float(data);
     } else {
         float data;
-        access >> data;
-        f.close();
+        memcpy (&data, p, sizeof(data));
         return data;
     }
-
-    return -0.1f;
 }
 
 float csv_connection::getData(QModelIndex &index) const
 {
-    QFile f;
-    QDir lib_dir = this->getLibDir();
-    f.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
-    if (!f.open( QIODevice::ReadOnly)) {
-        QMessageBox msgBox;
-        msgBox.setText("csv_connection::getData(QModelIndex&): Could not open file '"
-                       + this->uuidFilename + "' for Explicit Connection");
-        msgBox.exec();
-        return -0.1f;
-    }
-
-    int colVal = getNumCols();
-    if (colVal > 2) ++colVal;
-    // we multiply by cols +1 as QT seems to do some padding on the stream
-    int seekTo = index.row()*(colVal)+index.column();
-
-    if (seekTo*4 > f.size()) {
-        return -1;
-    }
-
-    f.seek(seekTo*4); // seek to location in bytes
-
-    // get a datastream to serialise the data
-    QDataStream access(&f);
-    if (index.column() < 2) {
-        qint32 data;
-        access >> data;
-        f.close();
-        return float(data);
-    }
-    else {
-        float data;
-        access >> data;
-        f.close();
-        return data;
-    }
-
-    return -0.1f;
+    return this->getData (index.row(), index.column());
 }
 
 /*!
@@ -1506,59 +1604,27 @@ void csv_connection::updateDataForNumCols (int num)
 
 void csv_connection::setData(const QModelIndex & index, float value)
 {
-    QFile f;
-    QDir lib_dir = this->getLibDir();
-    f.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
-    if (!f.open( QIODevice::ReadWrite)) {
-        QMessageBox msgBox;
-        msgBox.setText("csv_connection::setData(const QModelIndex&, float): Could not open temporary file " + this->uuidFilename + " for Explicit Connection");
-        msgBox.exec();
-        return;
-    }
-
-    // get a datastream to serialise the data
-    f.seek(f.size());
-
-    QDataStream access(&f);
-
-    if (index.row() > this->getNumRows()) {
-        // resize
-        for (int i = getNumRows()*getNumCols(); i < getNumCols()*index.row(); ++i) {
-            qint32 num = 0;
-            access << num;
-        }
-    }
-
-    int colVal = getNumCols();
-    if (colVal > 2) ++colVal;
-    int seekTo = index.row()*(colVal)+index.column();
-
-    f.seek(seekTo*4); // seek to location in bytes
-
-    if (index.column() < 2) {
-        access << (qint32) value;
-    } else {
-        access << (float) value;
-    }
-    f.flush();
-    f.close();
+    this->setData (index.row(), index.column(), value);
 }
 
 void
 csv_connection::setupDataStream (QFile& f, QDataStream& ds)
 {
+    // The caller appends to the data file directly
+    this->unmapData();
+
     QDir lib_dir = this->getLibDir();
     f.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
     if (!f.open( QIODevice::ReadWrite)) {
-        QMessageBox msgBox;
-        msgBox.setText("csv_connection::setupDataStream(QFile&): Could not open temporary file "
-                       + this->uuidFilename + " for Explicit Connection");
-        msgBox.exec();
+        errorReporter::report("csv_connection::setupDataStream(QFile&): Could not open temporary file "
+                              + this->uuidFilename + " for Explicit Connection");
         return;
     }
-    // get a datastream to serialise the data
-    f.seek(f.size());
+    // get a datastream to serialise the data, appending after the last
+    // row (the file may hold spare rows past numRows)
+    f.seek((qint64)this->getNumRows() * this->rowBytes(this->getNumCols()));
     ds.setDevice(&f);
+    this->setupPackedStream (ds);
     return;
 }
 
@@ -1571,68 +1637,36 @@ csv_connection::shutdownDataStream (QFile& f)
 
 void csv_connection::setData(int row, int col, float value)
 {
-    QFile f;
-    QDir lib_dir = this->getLibDir();
-    f.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
-    if (!f.open( QIODevice::ReadWrite)) {
-        QMessageBox msgBox;
-        msgBox.setText("csv_connection::setData(int, int, float): Could not open temporary file "
-                       + this->uuidFilename + " for Explicit Connection");
-        msgBox.exec();
+    this->mapData();
+
+    if (row < 0 || col < 0 || col >= this->cacheCols) {
         return;
     }
 
-    // get a datastream to serialise the data
-    f.seek(f.size());
-
-    QDataStream access(&f);
-
-    if (row > this->getNumRows()) {
-        // resize
-        for (int i = getNumRows()*getNumCols(); i < getNumCols()*row; ++i) {
-            qint32 num = 0;
-            access << num;
+    if (row >= this->mappedRows) {
+        // Grow the file (zero filled) and remap. Grow geometrically so that
+        // filling a connection row by row remaps O(log rows) times; numRows
+        // stays the row count, and saving trims the file to it.
+        this->mapRows (qMax (row+1, qMax (2*this->mappedRows, MIN_MAPPED_ROWS)));
+        if (row >= this->mappedRows) {
+            return;
         }
     }
 
-    int colVal = getNumCols();
-    if (colVal > 2) ++colVal;
-    int seekTo = row*(colVal)+col;
-
-    f.seek(seekTo*4); // seek to location in bytes
-
+    // Writes go straight through the shared mapping to the file
+    uchar* p = this->mapped + (qint64)row * this->rowBytes(this->cacheCols) + col*4;
     if (col < 2) {
-        access << (qint32) value;
+        qint32 data = (qint32) value;
+        memcpy (p, &data, sizeof(data));
     } else {
-        access << (float) value;
+        memcpy (p, &value, sizeof(value));
     }
-    f.flush();
-    f.close();
 }
 
 void csv_connection::setAllData (QVector<conn>& conns)
 {
-    QFile f;
-    QDir lib_dir = this->getLibDir();
-    f.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
-    if (!f.open( QIODevice::ReadWrite | QIODevice::Truncate)) {
-        QMessageBox msgBox;
-        msgBox.setText("csv_connection::setAllData(QVector<conn>&): Could not open temporary file "
-                       + this->uuidFilename + " for Explicit Connection");
-        msgBox.exec();
-        return;
-    }
-
-    // get a datastream to serialise the data
-    f.seek(f.size());
-
-    QDataStream access(&f);
-
     int nc = this->getNumCols();
 
-    int seekTo = 0;
-    f.seek(seekTo*4);
-
     float singleDelay = -1.0;
     if (nc == 3) {
         if (this->delay != (ParameterInstance*)0) {
@@ -1653,24 +1687,73 @@ void csv_connection::setAllData (QVector<conn>& conns)
         }
     }
 
-    for (int i = 0; i<conns.size(); ++i) {
-        access << (qint32) conns[i].src;
-        access << (qint32) conns[i].dst;
-        if (nc == 3) {
-            if (singleDelay > 1.0) {
-                access << (float) singleDelay;
-            } else {
-                access << (float) conns[i].metric;
+    if (conns.isEmpty()) {
+        this->writeAllData (0, (const int*)0, (const int*)0, (const float*)0);
+    } else if (singleDelay > 1.0) {
+        this->writeAllData (conns.size(), &conns[0].src, &conns[0].dst, (const float*)0,
+                            sizeof(conn), singleDelay);
+    } else {
+        this->writeAllData (conns.size(), &conns[0].src, &conns[0].dst, &conns[0].metric,
+                            sizeof(conn));
+    }
+}
+
+bool csv_connection::writeAllData (int n, const int* src, const int* dst, const float* delay,
+                                   int stride, float fixedDelay)
+{
+    // All of the data file is re-written
+    this->unmapData();
+
+    QFile f;
+    QDir lib_dir = this->getLibDir();
+    f.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
+    if (!f.open( QIODevice::WriteOnly | QIODevice::Truncate)) {
+        errorReporter::report("csv_connection::writeAllData(): Could not open temporary file "
+                              + this->uuidFilename + " for Explicit Connection");
+        return false;
+    }
+
+    int nc = this->getNumCols();
+    int rb = this->rowBytes(nc);
+    const char* srcBytes = (const char*)src;
+    const char* dstBytes = (const char*)dst;
+    const char* delayBytes = (const char*)delay;
+    bool report = n >= CONN_WRITE_PROGRESS_ROWS;
+
+    // Pack a block of rows at a time, and write each block in one call
+    QByteArray block;
+    block.resize(qMin (n, CONN_WRITE_BLOCK_ROWS) * rb);
+    for (int r0 = 0; r0 < n; r0 += CONN_WRITE_BLOCK_ROWS) {
+        int r1 = qMin (n, r0 + CONN_WRITE_BLOCK_ROWS);
+        char* p = block.data();
+        for (qint64 i = r0; i < r1; ++i, p += rb) {
+            memcpy (p, srcBytes + i*stride, sizeof(qint32));
+            memcpy (p+4, dstBytes + i*stride, sizeof(qint32));
+            if (nc > 2) {
+                memcpy (p+8, delay ? delayBytes + i*stride : (const char*)&fixedDelay, sizeof(float));
             }
         }
-        f.flush();
+        qint64 bytes = (qint64)(r1-r0) * rb;
+        if (f.write (block.constData(), bytes) != bytes) {
+            f.close();
+            errorReporter::report("csv_connection::writeAllData(): Could not write temporary file "
+                                  + this->uuidFilename + " for Explicit Connection (Check disk space)");
+            return false;
+        }
+        if (report) {
+            emit progress ((int)((qint64)r1 * 100 / n));
+        }
     }
 
     f.close();
+    this->numRows = n;
+    return true;
 }
 
 void csv_connection::clearData()
 {
+    this->unmapData();
+
     QFile f;
     QDir lib_dir = this->getLibDir();
     f.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
@@ -1742,9 +1825,12 @@ pythonscript_connection::pythonscript_connection(QSharedPointer <population> src
     this->scriptValidates = false;
     this->hasWeight = false;
     this->hasDelay = false;
+    this->hasBuffers = false;
     this->srcPop = src;
     this->dstPop = dst;
     this->connection_target = conn_targ;
+    this->conns = NULL;
+    this->mutex = NULL;
 }
 
 pythonscript_connection::~pythonscript_connection()
@@ -1823,13 +1909,14 @@ QLayout * pythonscript_connection::drawLayout(nl_rootdata * data, viewVZLayoutEd
         // should we enable the button?
         //gen->setEnabled(this->scriptValidates);
         // connect up to the Connection object
+        // the script runs on the pythonConnectionWorker, and the 3D view
+        // picks the connections up once it has finished
+        gen->setProperty("ptr", qVariantFromValue((void *) this));
         connect(gen, SIGNAL(clicked(bool)), this, SLOT(setUnchanged(bool)));
-        connect(gen, SIGNAL(clicked()), this, SLOT(regenerateConnections()));
+        connect(gen, SIGNAL(clicked()), data->main->viewVZ.OpenGLWidget, SLOT(generateConnections()));
         connect(gen, SIGNAL(clicked()), data, SLOT(reDrawAll()));
         connect(this, SIGNAL(setGenEnabled(bool)), gen, SLOT(setEnabled(bool)));
         if (viewVZhandler) {
-            // redraw to update glview
-            connect(gen, SIGNAL(clicked()), data->main->viewVZ.OpenGLWidget, SLOT(parsChangedProjection()));
             // add the delete signal
             connect(viewVZhandler, SIGNAL(deleteProperties()), gen, SLOT(deleteLater()));
         }
@@ -2145,8 +2232,8 @@ void pythonscript_connection::enableGen(int)
 bool pythonscript_connection::changed()
 {
     // check all pars
-    bool par_changed = false;
-    for (int i = 0; i <this->lastGeneratedParValues.size(); ++i) {
+    bool par_changed = this->lastGeneratedParValues.size() != this->parValues.size();
+    for (int i = 0; i < this->lastGeneratedParValues.size() && i < this->parValues.size(); ++i) {
         if (this->lastGeneratedParValues[i] != this->parValues[i]) {
             par_changed = true;
         }
@@ -2207,6 +2294,7 @@ void pythonscript_connection::configureFromScript(QString script)
     this->parPos.clear();
     this->hasWeight = false;
     this->hasDelay = false;
+    this->hasBuffers = false;
     // parse the script for parameter lines
     QStringList lines = script.split("\n");
     for (int i = 0; i < lines.size(); ++i) {
@@ -2240,6 +2328,9 @@ void pythonscript_connection::configureFromScript(QString script)
         if (lines[i].contains("#HASWEIGHT")) {
             this->hasWeight = true;
         }
+        if (lines[i].contains("#BUFFERS")) {
+            this->hasBuffers = true;
+        }
     }
     // clear the last par vals
     this->lastGeneratedParValues.clear();
@@ -2261,6 +2352,7 @@ void pythonscript_connection::configureFromScript(QString script, const QMap<QSt
     this->parPos.clear();
     this->hasWeight = false;
     this->hasDelay = false;
+    this->hasBuffers = false;
     // parse the script for parameter lines
     QStringList lines = script.split("\n");
     for (int i = 0; i < lines.size(); ++i) {
@@ -2300,6 +2392,9 @@ void pythonscript_connection::configureFromScript(QString script, const QMap<QSt
         if (lines[i].contains("#HASWEIGHT")) {
             this->hasWeight = true;
         }
+        if (lines[i].contains("#BUFFERS")) {
+            this->hasBuffers = true;
+        }
     }
     // clear the last par vals
     this->lastGeneratedParValues.clear();
@@ -2307,7 +2402,7 @@ void pythonscript_connection::configureFromScript(QString script, const QMap<QSt
     this->lastGeneratedParValues.fill(0);
 }
 
-void pythonscript_connection::regenerateConnections()
+void pythonscript_connection::refreshScriptText()
 {
     // refetch the script text
     QSettings settings;
@@ -2323,35 +2418,36 @@ void pythonscript_connection::regenerateConnections()
         this->scriptText = script;
     }
     settings.endGroup();
+}
+
+void pythonscript_connection::regenerateForExport()
+{
+    this->refreshScriptText();
 
     // test if required
     if (!this->changed()) {
         return;
     }
 
-    // generate connections:
-    QMutex * connGenerationMutex = new QMutex();
-
+    // the network being written has to wait for the connections, so the
+    // script runs here rather than on the worker
+    // (projectObject::regenerate_connections() has already tried to bring
+    // everything up to date in parallel).
     this->connections.clear();
-    generate_dialog generate(this, this->srcPop, this->dstPop, this->connections, connGenerationMutex, (QWidget *)NULL);
-    bool retVal = generate.exec();
-    if (!retVal) {
+    this->generate_connections();
+    if (this->changed()) {
+        errorReporter::report("Error generating connections for Python Script Connection: " + this->errorLog + this->pythonErrors);
         return;
     }
 
     if (connections.size() == 0) {
         if (this->connection_target) {
             if (this->connection_target->getNumRows() == 0) {
-                QMessageBox msgBox;
-                msgBox.setText("Error: no connections generated for Python Script Connection");
-                msgBox.exec();
-                delete connGenerationMutex;
+                errorReporter::report("Error: no connections generated for Python Script Connection");
                 return;
             }
         }
     }
-
-    delete connGenerationMutex;
 }
 
 void pythonscript_connection::write_node_xml(QXmlStreamWriter &)
@@ -2483,7 +2579,12 @@ void pythonscript_connection::read_metadata_xml(QDomNode &e)
                          + "current library version as " + this->scriptName + "_lib_<date>).");
         QPushButton* libraryButton = libModel.addButton("Prefer Library", QMessageBox::AcceptRole);
         QPushButton* modelButton = libModel.addButton("Prefer Model", QMessageBox::AcceptRole);
-        libModel.exec();
+        if (errorReporter::batchMode()) {
+            // nobody to ask; run the model as it was saved
+            DBG() << "Batch mode; preferring model version of script.";
+        } else {
+            libModel.exec();
+        }
         if (libModel.clickedButton() == libraryButton) {
             preferLibraryVersionOfScript = true;
         } else if (libModel.clickedButton() == modelButton) {
@@ -2690,6 +2791,91 @@ PyObject * vectorLocToList(QVector <loc> * vect)
     return vectList;
 }
 
+/*!
+ * \brief The locBuffer struct is a Python object which exposes a vector of
+ * locations through the buffer protocol, as a read-only (N,3) float32 array.
+ * numpy.asarray() on it copies nothing. It holds its own (implicitly shared)
+ * copy of the vector, so the data stays valid if the script keeps the array.
+ */
+struct locBuffer
+{
+    PyObject_HEAD
+    QVector <loc> * locs;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+};
+
+static void locBufferDealloc(PyObject * self)
+{
+    delete ((locBuffer *) self)->locs;
+    PyObject_Del(self);
+}
+
+static int locBufferGetBuffer(PyObject * self, Py_buffer * view, int flags)
+{
+    locBuffer * b = (locBuffer *) self;
+    if (flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "neuron locations are read-only");
+        view->obj = NULL;
+        return -1;
+    }
+    view->obj = self;
+    Py_INCREF(self);
+    view->buf = (void *) b->locs->constData();
+    view->len = b->shape[0] * b->strides[0];
+    view->readonly = 1;
+    view->itemsize = sizeof(float);
+    view->format = (flags & PyBUF_FORMAT) ? (char *) "f" : NULL;
+    view->ndim = 2;
+    view->shape = (flags & PyBUF_ND) == PyBUF_ND ? b->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? b->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+static PyTypeObject locBufferType = { PyVarObject_HEAD_INIT(NULL, 0) };
+static PyBufferProcs locBufferProcs;
+
+/*!
+ * \brief vectorLocToBuffer
+ * \param vect
+ * \return
+ * Wrap a vector of locations in a locBuffer, without copying the locations.
+ * Must be called holding the GIL.
+ */
+PyObject * vectorLocToBuffer(const QVector <loc> &vect)
+{
+    if (locBufferType.tp_name == NULL) {
+        locBufferType.tp_name = (char *) "spinecreator.locations";
+        locBufferType.tp_basicsize = sizeof(locBuffer);
+        locBufferType.tp_dealloc = locBufferDealloc;
+        locBufferType.tp_flags = Py_TPFLAGS_DEFAULT
+#ifdef Py_TPFLAGS_HAVE_NEWBUFFER
+                | Py_TPFLAGS_HAVE_NEWBUFFER
+#endif
+                ;
+        locBufferType.tp_doc = (char *) "Neuron locations as a read-only (N,3) float32 buffer";
+        locBufferProcs.bf_getbuffer = locBufferGetBuffer;
+        locBufferType.tp_as_buffer = &locBufferProcs;
+        if (PyType_Ready(&locBufferType) < 0) {
+            locBufferType.tp_name = NULL;
+            return NULL;
+        }
+    }
+
+    locBuffer * b = PyObject_New(locBuffer, &locBufferType);
+    if (b == NULL) {
+        return NULL;
+    }
+    b->locs = new QVector <loc> (vect);
+    b->shape[0] = vect.size();
+    b->shape[1] = 3;
+    b->strides[0] = sizeof(loc);
+    b->strides[1] = sizeof(float);
+    return (PyObject *) b;
+}
+
 /*!
  * \brief listToVector
  * \param list
@@ -2790,6 +2976,203 @@ outputUnPackaged extractOutput(PyObject * output, bool hasDelay, bool hasWeight)
     return outUnPacked;
 }
 
+/*!
+ * \brief The bufferColumn struct is one column of numbers in an object which
+ * exposes the buffer protocol, such as a numpy array.
+ */
+struct bufferColumn
+{
+    const char * data;
+    Py_ssize_t stride;
+    Py_ssize_t size;
+    Py_ssize_t itemsize;
+    // 'i' signed integer, 'u' unsigned integer or 'f' floating point
+    char kind;
+};
+
+/*!
+ * \brief bufferKind
+ * Find the kind of number held in a buffer from its struct format string.
+ * Returns false for anything but a single native-order integer or float.
+ */
+static bool bufferKind(const Py_buffer &view, char &kind)
+{
+    const char * f = view.format ? view.format : "B";
+    if (*f == '@' || *f == '=') {
+        ++f;
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    } else if (*f == '<') {
+#else
+    } else if (*f == '>' || *f == '!') {
+#endif
+        ++f;
+    }
+    if (f[0] == '\0' || f[1] != '\0') {
+        return false;
+    }
+    switch (*f) {
+    case 'b': case 'h': case 'i': case 'l': case 'q': case 'n':
+        kind = 'i';
+        break;
+    case 'B': case 'H': case 'I': case 'L': case 'Q': case 'N':
+        kind = 'u';
+        break;
+    case 'f': case 'd':
+        kind = 'f';
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+template <typename S, typename D>
+static void copyColumn(const bufferColumn &c, char * dst, size_t dstStride)
+{
+    const char * src = c.data;
+    for (Py_ssize_t i = 0; i < c.size; ++i, src += c.stride, dst += dstStride) {
+        *(D *) dst = (D) *(const S *) src;
+    }
+}
+
+/*!
+ * \brief copyBufferColumn
+ * Convert a column into values of type D, written dstStride bytes apart from
+ * dst, with no per-element Python calls.
+ */
+template <typename D>
+static bool copyBufferColumn(const bufferColumn &c, char * dst, size_t dstStride)
+{
+    if (c.kind == 'f') {
+        if (c.itemsize == 4) { copyColumn <float, D> (c, dst, dstStride); return true; }
+        if (c.itemsize == 8) { copyColumn <double, D> (c, dst, dstStride); return true; }
+    } else if (c.kind == 'i') {
+        if (c.itemsize == 1) { copyColumn <qint8, D> (c, dst, dstStride); return true; }
+        if (c.itemsize == 2) { copyColumn <qint16, D> (c, dst, dstStride); return true; }
+        if (c.itemsize == 4) { copyColumn <qint32, D> (c, dst, dstStride); return true; }
+        if (c.itemsize == 8) { copyColumn <qint64, D> (c, dst, dstStride); return true; }
+    } else {
+        if (c.itemsize == 1) { copyColumn <quint8, D> (c, dst, dstStride); return true; }
+        if (c.itemsize == 2) { copyColumn <quint16, D> (c, dst, dstStride); return true; }
+        if (c.itemsize == 4) { copyColumn <quint32, D> (c, dst, dstStride); return true; }
+        if (c.itemsize == 8) { copyColumn <quint64, D> (c, dst, dstStride); return true; }
+    }
+    return false;
+}
+
+/*!
+ * \brief extractBufferOutput
+ * Unpack the output of a connection function which was returned as buffers
+ * rather than as a list of tuples: either a tuple of 1-D buffers (src, dst,
+ * delay, weight), or a single 2-D buffer with those columns. Delay and
+ * weight are optional, as for the list form. The numbers are read straight
+ * out of the buffers into the connection list. Returns false, with the
+ * reason in errs, if output is in neither form.
+ */
+static bool extractBufferOutput(PyObject * output, bool hasDelay, bool hasWeight, outputUnPackaged &out, QString &errs)
+{
+    QTime qtimer;
+    qtimer.start();
+
+    const int flags = PyBUF_STRIDES | PyBUF_FORMAT;
+    QVector <Py_buffer> views;
+    QVector <bufferColumn> cols;
+    bool ok = true;
+
+    if (PyTuple_Check(output)) {
+        for (Py_ssize_t i = 0; i < PyTuple_Size(output) && i < 4 && ok; ++i) {
+            Py_buffer view;
+            if (PyObject_GetBuffer(PyTuple_GetItem(output, i), &view, flags) < 0) {
+                errs = "Python Error: element " + QString::number(i) + " of the returned tuple is not an array";
+                ok = false;
+                break;
+            }
+            views.push_back(view);
+            if (view.ndim != 1) {
+                errs = "Python Error: element " + QString::number(i) + " of the returned tuple is not a 1-D array";
+                ok = false;
+                break;
+            }
+            bufferColumn c;
+            c.data = (const char *) view.buf;
+            c.stride = view.strides[0];
+            c.size = view.shape[0];
+            c.itemsize = view.itemsize;
+            ok = bufferKind(view, c.kind);
+            cols.push_back(c);
+        }
+    } else if (PyObject_CheckBuffer(output)) {
+        Py_buffer view;
+        if (PyObject_GetBuffer(output, &view, flags) < 0) {
+            errs = "Python Error: the returned array could not be read";
+            ok = false;
+        } else {
+            views.push_back(view);
+            if (view.ndim != 2 || view.shape[1] < 2) {
+                errs = "Python Error: the returned array must have 2 dimensions, and at least 2 columns";
+                ok = false;
+            } else {
+                for (Py_ssize_t j = 0; j < view.shape[1] && j < 4 && ok; ++j) {
+                    bufferColumn c;
+                    c.data = (const char *) view.buf + j * view.strides[1];
+                    c.stride = view.strides[0];
+                    c.size = view.shape[0];
+                    c.itemsize = view.itemsize;
+                    ok = bufferKind(view, c.kind);
+                    cols.push_back(c);
+                }
+            }
+        }
+    } else {
+        errs = "Python Error: connectionFunc must return a list, a tuple of arrays or an array";
+        ok = false;
+    }
+
+    if (ok && cols.size() < 2) {
+        errs = "Python Error: connectionFunc must return at least src and dst arrays";
+        ok = false;
+    }
+    for (int i = 1; ok && i < cols.size(); ++i) {
+        if (cols[i].size != cols[0].size) {
+            errs = "Python Error: the returned arrays are not all the same length";
+            ok = false;
+        }
+    }
+
+    if (ok) {
+        Py_ssize_t n = cols[0].size;
+        out.connections.resize(n);
+        out.weights.clear();
+        if (n > 0) {
+            char * base = (char *) out.connections.data();
+            ok = copyBufferColumn <int> (cols[0], base + offsetof(conn, src), sizeof(conn))
+                    && copyBufferColumn <int> (cols[1], base + offsetof(conn, dst), sizeof(conn));
+            if (ok && hasDelay && cols.size() > 2) {
+                ok = copyBufferColumn <float> (cols[2], base + offsetof(conn, metric), sizeof(conn));
+            } else {
+                out.connections[0].metric = NO_DELAY;
+            }
+            if (ok && hasWeight && cols.size() > 3) {
+                out.weights.resize(n);
+                ok = copyBufferColumn <double> (cols[3], (char *) out.weights.data(), sizeof(double));
+            }
+        }
+        if (!ok) {
+            errs = "Python Error: the returned arrays must hold integers or floats";
+        }
+    } else if (errs.isEmpty()) {
+        errs = "Python Error: the returned arrays must hold integers or floats";
+    }
+
+    for (int i = 0; i < views.size(); ++i) {
+        PyBuffer_Release(&views[i]);
+    }
+    PyErr_Clear();
+
+    DBG() << "Extracted buffer output in " << qtimer.elapsed() << " ms";
+    return ok;
+}
+
 /*!
  * \brief createPyFunc
  * \param pymod
@@ -2837,96 +3220,176 @@ PyObject* createPyFunc(PyObject* pymod, QString text, QString &errs)
     return PyObject_GetAttrString (pymod, "connectionFunc");
 }
 
+/*!
+ * \brief scriptProgress
+ * spinecreator_progress(fraction), which a connection script may call to
+ * report how far it has got. Raises KeyboardInterrupt if the job has been
+ * cancelled, so a script that calls it stops promptly even inside C code.
+ */
+static PyObject* scriptProgress(PyObject* self, PyObject* args)
+{
+    double fraction;
+    if (!PyArg_ParseTuple (args, "d", &fraction)) {
+        return NULL;
+    }
+    pythonConnectionJob* job = (pythonConnectionJob*) PyCapsule_GetPointer (self, "pythonConnectionJob");
+    if (!job) {
+        return NULL;
+    }
+    if (job->cancelled.load()) {
+        PyErr_SetString (PyExc_KeyboardInterrupt, "connection generation cancelled");
+        return NULL;
+    }
+    fraction = qBound(0.0, fraction, 1.0);
+    pythonConnectionWorker::reportProgress(job, PY_PROGRESS_SCRIPT_START
+                                           + (int) (fraction * (PY_PROGRESS_SCRIPT_END - PY_PROGRESS_SCRIPT_START)));
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef scriptProgressMethod = {
+    (char*) "spinecreator_progress", scriptProgress, METH_VARARGS,
+    (char*) "spinecreator_progress(fraction): report the progress of the connection script, from 0 to 1"
+};
+
 /*!
  * \brief pythonscript_connection::generate_connections
  * function called to generate the connection into an explicit list -
- * used to draw the connections in the 3D view or export for simulation
+ * used to draw the connections in the 3D view or export for simulation.
+ * Runs the script on the calling thread, which must be the GUI thread; the
+ * generate_dialog queues it on the pythonConnectionWorker instead.
  */
 void pythonscript_connection::generate_connections()
 {
-    QTime qtimer;
-    qtimer.start();
-    conns->clear();
+    pythonConnectionJob job;
+    if (!this->prepareGeneration(job)) {
+        return;
+    }
 
+    PyGILState_STATE gil = PyGILState_Ensure();
+    pythonscript_connection::runGeneration(job);
+    PyGILState_Release(gil);
+
+    this->applyGeneration(job);
+}
+
+bool pythonscript_connection::prepareGeneration(pythonConnectionJob &job)
+{
+    this->errorLog.clear();
     this->pythonErrors.clear();
 
     // regenerate src and dst locations
-    QString errorLog;
-    srcPop->layoutType->generateLayout(srcPop->numNeurons,&srcPop->layoutType->locations,errorLog);
+    srcPop->layoutType->generateLayout(srcPop->numNeurons,&srcPop->layoutType->locations,this->errorLog);
     if (!errorLog.isEmpty()) {
         DBG() << "no src locs";
-        return;
+        return false;
     }
-    dstPop->layoutType->generateLayout(dstPop->numNeurons,&dstPop->layoutType->locations,errorLog);
+    dstPop->layoutType->generateLayout(dstPop->numNeurons,&dstPop->layoutType->locations,this->errorLog);
     if (!errorLog.isEmpty()) {
         DBG() << "no dst locs";
-        return;
+        return false;
     }
 
+    job.conn = this;
+    job.scriptText = this->scriptText;
+    job.parNames = this->parNames;
+    job.parValues = this->parValues;
+    job.parText = this->parText;
+    job.weightProp = this->weightProp;
+    job.srcLocs = srcPop->layoutType->locations;
+    job.dstLocs = dstPop->layoutType->locations;
+    job.hasDelay = this->hasDelay;
+    job.hasWeight = this->hasWeight;
+    job.hasBuffers = this->hasBuffers;
+    return true;
+}
+
+void pythonscript_connection::runGeneration(pythonConnectionJob &job)
+{
+    QTime qtimer;
+    qtimer.start();
+
+    job.connections.clear();
+    job.weights.clear();
+    job.errors.clear();
+
     // a tuple to hold the arguments to the Python Script - size of the scripts pars + the src and dst locations
-    PyObject * argsPy = PyTuple_New(this->parNames.size()+2/* 2 for the src and dst locations*/);
+    PyObject * argsPy = PyTuple_New(job.parNames.size()+2/* 2 for the src and dst locations*/);
+
+    // check the tuple is sound
+    if (!argsPy) {
+        DBG() << "Bad args tuple";
+        return;
+    }
 
-    // convert the locations into Python Objects:
-    PyObject * srcPy = vectorLocToList(&srcPop->layoutType->locations);
-    PyObject * dstPy = vectorLocToList(&dstPop->layoutType->locations);
+    // convert the locations into Python Objects: (N,3) float32 buffers over
+    // the locations for #BUFFERS scripts, otherwise lists of tuples
+    PyObject * srcPy;
+    PyObject * dstPy;
+    if (job.hasBuffers) {
+        srcPy = vectorLocToBuffer(job.srcLocs);
+        dstPy = vectorLocToBuffer(job.dstLocs);
+    } else {
+        srcPy = vectorLocToList(&job.srcLocs);
+        dstPy = vectorLocToList(&job.dstLocs);
+    }
 
-    // add them to the tuple
+    // add them to the tuple, which now owns them
     PyTuple_SetItem(argsPy,0,srcPy);
     PyTuple_SetItem(argsPy,1,dstPy);
 
     // convert the parameters into Python Objects and add them to the tuple
-    for (int i = 0; i < this->parNames.size(); ++i) {
-        if (this->parNames[i].endsWith("_string")) {
-            PyTuple_SetItem(argsPy,i+2,PyUnicode_FromString(parText[i].toStdString().c_str()));
+    for (int i = 0; i < job.parNames.size(); ++i) {
+        if (job.parNames[i].endsWith("_string")) {
+            PyTuple_SetItem(argsPy,i+2,PyUnicode_FromString(job.parText[i].toStdString().c_str()));
         } else {
-            PyTuple_SetItem(argsPy,i+2,PyFloat_FromDouble(parValues[i]));
+            PyTuple_SetItem(argsPy,i+2,PyFloat_FromDouble(job.parValues[i]));
         }
     }
 
-    // check the tuple is sound
-    if (!argsPy) {
-        DBG() << "Bad args tuple";
-        Py_XDECREF(argsPy);
-        Py_XDECREF(srcPy);
-        Py_XDECREF(dstPy);
-        return;
-    }
-
     // Create a new module object
     PyObject* pymod = PyModule_New ("mymod");
 
     // add the function to Python, and get a PyObject for it
-    PyObject* pyFunc = createPyFunc (pymod, this->scriptText, this->pythonErrors);
+    PyObject* pyFunc = createPyFunc (pymod, job.scriptText, job.errors);
 
     // check that function creation worked
     if (!pyFunc) {
         cerr << "createPyFunc returned null" << endl;
-        if (pythonErrors.isEmpty()) {
-            pythonErrors = "Python Error: Script function is not named connectionFunc.";
+        if (job.errors.isEmpty()) {
+            job.errors = "Python Error: Script function is not named connectionFunc.";
         }
         Py_XDECREF(argsPy);
-        Py_XDECREF(srcPy);
-        Py_XDECREF(dstPy);
         Py_XDECREF(pyFunc);
         Py_XDECREF(pymod);
         return;
     }
 
     DBG() << "Set up the python function in " << qtimer.restart() << " ms";
+    pythonConnectionWorker::reportProgress(&job, PY_PROGRESS_SCRIPT_START);
+
+    // let the script report its own progress (and notice a cancel) by calling
+    // spinecreator_progress(fraction). The function's globals are __main__'s.
+    PyObject* mainDict = PyModule_GetDict (PyImport_AddModule ("__main__"));
+    PyObject* jobCapsule = PyCapsule_New (&job, "pythonConnectionJob", NULL);
+    PyObject* progressFunc = PyCFunction_New (&scriptProgressMethod, jobCapsule);
+    PyDict_SetItemString (mainDict, "spinecreator_progress", progressFunc);
+    Py_XDECREF(progressFunc);
+    Py_XDECREF(jobCapsule);
+
     // Call my function
     DBG() << "Calling the function";
     PyObject* output = PyObject_CallObject (pyFunc, argsPy);
     DBG() << "Script call returned in " << qtimer.restart() << " ms";
+    PyDict_DelItemString (mainDict, "spinecreator_progress");
+    pythonConnectionWorker::reportProgress(&job, PY_PROGRESS_SCRIPT_END);
     Py_XDECREF(argsPy);
-    Py_XDECREF(srcPy);
-    Py_XDECREF(dstPy);
 
     Py_XDECREF(pyFunc);
     Py_XDECREF(pymod);
 
     if (!output) {
 
-        this->pythonErrors = "Python Error:";
+        job.errors = "Python Error:";
 
         PyObject *pyExcType;
         PyObject *pyExcValue;
@@ -2936,19 +3399,19 @@ void pythonscript_connection::generate_connections()
 
         PyObject* str_exc_type = PyObject_Repr(pyExcType);
         PyObject* pyStr = PyUnicode_AsEncodedString(str_exc_type, "utf-8", "Error ~");
-        pythonErrors += "\nException type: ";
+        job.errors += "\nException type: ";
         if (pyStr != (PyObject*)0) {
-            pythonErrors += PyBytes_AS_STRING(pyStr);
+            job.errors += PyBytes_AS_STRING(pyStr);
         } else {
-            pythonErrors += "unknown";
+            job.errors += "unknown";
         }
         PyObject* str_exc_value = PyObject_Repr(pyExcValue);
         PyObject* pyExcValueStr = PyUnicode_AsEncodedString(str_exc_value, "utf-8", "Error ~");
-        pythonErrors += "\nException value: ";
+        job.errors += "\nException value: ";
         if (pyExcValueStr != (PyObject*)0) {
-            pythonErrors += PyBytes_AsString(pyExcValueStr);
+            job.errors += PyBytes_AsString(pyExcValueStr);
         } else {
-            pythonErrors += "unkown";
+            job.errors += "unkown";
         }
 
         if (pyExcTraceback) {
@@ -2965,9 +3428,9 @@ void pythonscript_connection::generate_connections()
                     e1 = "<string>";
                 }
                 if (e1 == "<string>") {
-                    pythonErrors += QString("\nError on line: ") + QString::number(errtraceObj->tb_lineno) + QString(" of the connection script");
+                    job.errors += QString("\nError on line: ") + QString::number(errtraceObj->tb_lineno) + QString(" of the connection script");
                 } else {
-                    pythonErrors += QString("\nError on line: ") + QString::number(errtraceObj->tb_lineno) + QString(" of ") + e1;
+                    job.errors += QString("\nError on line: ") + QString::number(errtraceObj->tb_lineno) + QString(" of ") + e1;
                 }
                 Py_XDECREF(tfnStr);
             }
@@ -2985,13 +3448,13 @@ void pythonscript_connection::generate_connections()
                 PyObject* _tn = errtraceObj->tb_frame->f_code->co_name;
                 PyObject* _tnStr = PyUnicode_AsEncodedString(tfn, "utf-8", "Error ~");
 
-                pythonErrors += QString("\nError on line: ") + QString::number(errtraceObj->tb_lineno);
+                job.errors += QString("\nError on line: ") + QString::number(errtraceObj->tb_lineno);
 
                 if (_tfnStr != (PyObject*)0) {
-                    pythonErrors += QString(" of ") + QString (PyBytes_AsString(_tfnStr)) + QString(", ");
+                    job.errors += QString(" of ") + QString (PyBytes_AsString(_tfnStr)) + QString(", ");
                 }
                 if (_tnStr != (PyObject*)0) {
-                    pythonErrors += QString("function ") + QString (PyBytes_AsString(_tnStr));
+                    job.errors += QString("function ") + QString (PyBytes_AsString(_tnStr));
                 }
 
                 Py_XDECREF(_tfn);
@@ -3018,14 +3481,32 @@ void pythonscript_connection::generate_connections()
 
     DBG() << "Checked exceptions in " << qtimer.restart() << " ms";
     // unpack the output into C++ forms
-    outputUnPackaged unpacked = extractOutput (output, this->hasDelay, this->hasWeight);
+    outputUnPackaged unpacked;
+    if (PyList_Check(output)) {
+        unpacked = extractOutput (output, job.hasDelay, job.hasWeight);
+    } else if (!extractBufferOutput (output, job.hasDelay, job.hasWeight, unpacked, job.errors)) {
+        Py_XDECREF(output);
+        return;
+    }
+    Py_XDECREF(output);
+    job.connections = unpacked.connections;
+    job.weights = unpacked.weights;
 
     DBG() << "Unpacked output in " << qtimer.restart() << " ms";
+    pythonConnectionWorker::reportProgress(&job, PY_PROGRESS_UNPACKED);
+}
+
+bool pythonscript_connection::applyGeneration(const pythonConnectionJob &job)
+{
+    this->pythonErrors = job.errors;
+    if (!this->pythonErrors.isEmpty()) {
+        return false;
+    }
 
     // transfer the unpacked output to the local storage location for connections
     if (this->connection_target != NULL) {
 
-        DBG() << "pythonscript_connection::generate_connections: setting src/dst popn names in connection_target";
+        DBG() << "pythonscript_connection::applyGeneration: setting src/dst popn names in connection_target";
         this->connection_target->setSrcName (this->srcPop->name);
         this->connection_target->setDstName (this->dstPop->name);
         QTime subtimer;
@@ -3035,9 +3516,9 @@ void pythonscript_connection::generate_connections()
         DBG() << "Cleared target data in " << subtimer.restart() << " ms";
 
         // if no connections are returned
-        if (unpacked.connections.size() > 0) {
+        if (job.connections.size() > 0) {
             // otherwise...
-            if (this->hasDelay) {
+            if (job.hasDelay) {
                 // if we have delays, resize
                 this->connection_target->setNumCols(3);
             } else {
@@ -3047,34 +3528,51 @@ void pythonscript_connection::generate_connections()
         }
 
         // Transfer the connection to the local file copy
-        QFile f;
-        QDataStream ds;
-        this->connection_target->setupDataStream (f, ds);
-        for (int i = 0; i < unpacked.connections.size(); ++i) {
-            ds << (qint32)unpacked.connections[i].src
-               << (qint32)unpacked.connections[i].dst;
-            if (unpacked.connections[0].metric != NO_DELAY) {
-                ds << (float)unpacked.connections[i].metric;
-            }
+        const QVector<conn>& c = job.connections;
+        if (c.isEmpty()) {
+            this->connection_target->writeAllData (0, (const int*)0, (const int*)0, (const float*)0);
+        } else {
+            const float* delays = c[0].metric != NO_DELAY ? &c[0].metric : (const float*)0;
+            this->connection_target->writeAllData (c.size(), &c[0].src, &c[0].dst, delays, sizeof(conn));
         }
-        this->connection_target->shutdownDataStream (f);
         DBG() << "Transferred connection data in " << subtimer.restart() << " ms";
-        this->connection_target->setNumRows(unpacked.connections.size());
 
     } else {
         DBG() << "connection_target is null";
-        this->connections = unpacked.connections;
-        (*this->conns) = unpacked.connections;
+        this->connections = job.connections;
+        if (this->conns) {
+            (*this->conns) = job.connections;
+        }
     }
 
     // transfer the unpacked output to the local storage location for weights
-    this->weights = unpacked.weights;
+    this->weights = job.weights;
+
+    // move the weights across into the weight property
+    ParameterInstance * par = this->getPropPointer();
+    if (par && job.hasWeight) {
+        par->currType = ExplicitList;
+        par->value = this->weights;
+        par->indices.clear();
+        for (int i = 0; i < this->weights.size(); ++i) {
+            par->indices.push_back(i);
+        }
+    }
 
-    // if we get to the end then that's good enough
+    // if we get to the end then that's good enough. What was generated is
+    // what the job was given, so an edit made while the script ran still
+    // counts as a change.
     this->scriptValidates = true;
-    this->setUnchanged(true);
+    this->srcSize = job.srcLocs.size();
+    this->dstSize = job.dstLocs.size();
+    this->lastGeneratedParValues = job.parValues;
+    this->lastGeneratedWeightProp = job.weightProp;
+    this->lastGeneratedScriptText = job.scriptText;
+    this->hasChanged = false;
 
-    DBG() << "Returning";
+    emit progress(100);
+    emit connectionsDone();
+    return true;
 }
 
 connection * pythonscript_connection::newFromExisting()
@@ -3091,6 +3589,7 @@ connection * pythonscript_connection::newFromExisting()
     c->scriptValidates = this->scriptValidates;
     c->hasWeight = this->hasWeight;
     c->hasDelay = this->hasDelay;
+    c->hasBuffers = this->hasBuffers;
     c->connection_target = this->connection_target;
     c->scriptName = this->scriptName;
     c->scriptText = this->scriptText;
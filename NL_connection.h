@@ -35,6 +35,18 @@
 
 #define NO_DELAY -1 // used to determine if Python Scripts have delay data
 
+// csv_connection::writeAllData writes this many rows per block, and
+// reports progress for writes of at least CONN_WRITE_PROGRESS_ROWS rows.
+#define CONN_WRITE_BLOCK_ROWS (1<<16)
+#define CONN_WRITE_PROGRESS_ROWS (1<<20)
+
+// csv_connection::import_csv parses the file in chunks of this many bytes,
+// and reports at most CONN_IMPORT_MAX_ERRORS malformed lines.
+#define CONN_IMPORT_CHUNK_BYTES (4<<20)
+#define CONN_IMPORT_MAX_ERRORS 100
+
+struct pythonConnectionJob;
+
 struct change {
     int row;
     int col;
@@ -264,9 +276,14 @@ public:
      * This format consists of ASCII text data written as S,D,L/n where S is the source index,
      * D is the destination index and L (optional) is the delay.
      *
+     * The file is memory mapped and parsed in parallel, in newline aligned
+     * chunks. Lines which can't be parsed are skipped, and described in
+     * errors (if given), as is the reason for a failed import. progress()
+     * is emitted as the file is parsed, and cancelImport() stops it.
+     *
      * Returns false if the import failed for any reason, otherwise returns true.
      */
-    bool import_csv (QString filename);
+    bool import_csv (QString filename, QStringList* errors = 0);
 
     /*!
      * \brief import_packed_binary
@@ -322,8 +339,23 @@ public:
      */
     void setAllData (QVector<conn>& conns);
 
+    /*!
+     * Replace the connection data with n connections, read from src, dst
+     * and delay, with stride bytes between consecutive elements of each, so
+     * that both separate arrays and arrays of conn can be passed without a
+     * copy. If delay is null, fixedDelay fills the delay column (when there
+     * is one). The data file is written in large blocks, and numRows set to
+     * n. Emits progress() for large writes. Returns false on failure.
+     */
+    bool writeAllData (int n, const int* src, const int* dst, const float* delay,
+                       int stride = sizeof(int), float fixedDelay = 0.0f);
+
     void clearData (void);
-    void flushChangesToDisk (void);
+    /*!
+     * Release the mapping of the data file, so that it can be changed by
+     * other means. (Changes made by setData() are already in the file.)
+     */
+    void flushChangesToDisk (void) const;
     void abortChanges (void);
     /*!
      * Write out the node xml to the XML files, using the final
@@ -388,6 +420,35 @@ private:
     QVector<change> changes;
     csv_connection* copiedFrom;
 
+    //! Set by cancelImport() to stop import_csv().
+    bool importCancelled;
+
+    /*!
+     * The data file, in the same close packed (int S)(int D)(opt float L)
+     * layout as the BinaryFile written on save, memory mapped read-write by
+     * mapData() for cacheCols columns (-1 when not mapped). getData() and
+     * setData() access the mapping directly, and saving copies the file.
+     * mappedRows is the capacity of the mapping, which setData() grows
+     * geometrically; it may exceed numRows, the number of rows in use.
+     */
+    mutable QFile mapFile;
+    mutable uchar* mapped;
+    mutable int mappedRows;
+    mutable int cacheCols;
+
+    void mapData (void) const;
+    //! Map the first rows rows of the data file, growing it if necessary.
+    void mapRows (int rows) const;
+    /*!
+     * Unmap and close the data file. Called before the data file is read or
+     * written other than through the mapping.
+     */
+    void unmapData (void) const;
+    //! The size of a row in the data file, for nc columns.
+    int rowBytes (int nc) const;
+    //! Set up ds to read or write the packed data file format.
+    void setupPackedStream (QDataStream& ds) const;
+
     /*!
      * Generate a filename based on the source and destination
      * population names, throwing an exception if either of these is
@@ -430,6 +491,17 @@ public slots:
      * Called when the "Global delay" checkbox is changed.
      */
     void updateGlobalDelay (void);
+
+    /*!
+     * Stop an import_csv() which is in progress.
+     */
+    void cancelImport (void);
+
+signals:
+    /*!
+     * Percentage progress through a large writeAllData().
+     */
+    void progress(int);
 };
 
 class pythonscript_connection : public connection
@@ -446,6 +518,9 @@ public:
         this->scriptValidates = false;
         this->hasWeight = false;
         this->hasDelay = false;
+        this->hasBuffers = false;
+        this->conns = NULL;
+        this->mutex = NULL;
     }
 
     ~pythonscript_connection();
@@ -488,6 +563,8 @@ public:
     bool scriptValidates;
     bool hasWeight;
     bool hasDelay;
+    // #BUFFERS scripts get the locations as (N,3) float32 buffers, not lists
+    bool hasBuffers;
 
     ParameterInstance *getPropPointer();
     QStringList getPropList();
@@ -498,7 +575,38 @@ public:
 
     connection * newFromExisting();
 
+    /*!
+     * \brief prepareGeneration
+     * Regenerate the src and dst layouts and copy the script, its parameters
+     * and the neuron locations into job. Must be called on the GUI thread.
+     * Returns false, with the reason in errorLog, if a layout fails.
+     */
+    bool prepareGeneration(pythonConnectionJob &job);
+
+    /*!
+     * \brief runGeneration
+     * Run the script of a prepared job, filling in its connections, weights
+     * and errors. Touches nothing but the job, so it may be called on any
+     * thread, but the caller must hold the Python GIL.
+     */
+    static void runGeneration(pythonConnectionJob &job);
 
+    /*!
+     * \brief applyGeneration
+     * Copy the output of a finished job into this connection (and its
+     * connection_target and weight property). Must be called on the GUI
+     * thread. Returns false, with the reason in pythonErrors, if the script
+     * failed.
+     */
+    bool applyGeneration(const pythonConnectionJob &job);
+
+    /*!
+     * \brief regenerateForExport
+     * Regenerate the connections, if they are out of date, on the calling
+     * thread. Only for writing the network out, which has to wait for them;
+     * the GUI queues generation on the pythonConnectionWorker instead.
+     */
+    void regenerateForExport();
 
 private:
 
@@ -520,7 +628,12 @@ public slots:
     void configureFromScript(QString);
     void configureFromScript(QString script, const QMap<QString, QString>& mparams);
 
-    void regenerateConnections();
+    /*!
+     * \brief refreshScriptText
+     * Refetch the script text from the stored scripts, so that edits to the
+     * script are picked up by changed()
+     */
+    void refreshScriptText();
 
     void setUnchanged(bool);
 
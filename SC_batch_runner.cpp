@@ -0,0 +1,375 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "SC_batch_runner.h"
+#include "SC_experiment_sweep.h"
+#include "SC_network_layer_rootdata.h"
+#include "SC_projectobject.h"
+#include "EL_experiment.h"
+#include "mainwindow.h"
+#include "SC_export_cache.h"
+#include "SC_error_reporter.h"
+#include "SC_network_3d_visualiser_panel.h"
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QThread>
+#include <cstdio>
+
+batchRunner::batchRunner(QObject * parent) :
+    QObject(parent),
+    frameStepMs(BATCH_FRAME_STEP_MS),
+    frameWidth(1024),
+    frameHeight(768),
+    frameFirstMs(0),
+    frameLastMs(-1),
+    maxProcesses(QThread::idealThreadCount()),
+    data(NULL),
+    project(NULL),
+    connectionsOk(true),
+    nextSweep(0),
+    running(0)
+{
+    if (this->maxProcesses < 1) {
+        this->maxProcesses = 1;
+    }
+}
+
+batchRunner::~batchRunner()
+{
+    for (int i = 0; i < this->sweeps.size(); ++i) {
+        delete this->sweeps[i];
+    }
+}
+
+bool batchRunner::parseArgs(QStringList args)
+{
+    for (int i = 1; i < args.size(); ++i) {
+        QString arg = args[i];
+        bool hasValue = i + 1 < args.size();
+        if (arg == "--batch") {
+            continue;
+        } else if (arg == "-e" && hasValue) {
+            bool ok;
+            this->exptNums.push_back(args[++i].toInt(&ok));
+            if (!ok) {
+                return false;
+            }
+        } else if (arg == "-o" && hasValue) {
+            this->outDir = args[++i];
+        } else if (arg == "-j" && hasValue) {
+            bool ok;
+            this->maxProcesses = qMax(1, args[++i].toInt(&ok));
+            if (!ok) {
+                return false;
+            }
+        } else if (arg == "--summary" && hasValue) {
+            this->summaryFile = args[++i];
+        } else if (arg == "--render-frames" && hasValue) {
+            this->framesDir = QDir(args[++i]).absolutePath();
+        } else if (arg == "--frame-step" && hasValue) {
+            bool ok;
+            this->frameStepMs = args[++i].toDouble(&ok);
+            if (!ok || this->frameStepMs <= 0) {
+                return false;
+            }
+        } else if (arg == "--frame-size" && hasValue) {
+            QStringList size = args[++i].toLower().split("x");
+            bool okW = false;
+            bool okH = false;
+            if (size.size() == 2) {
+                this->frameWidth = size[0].toInt(&okW);
+                this->frameHeight = size[1].toInt(&okH);
+            }
+            if (!okW || !okH || this->frameWidth <= 0 || this->frameHeight <= 0) {
+                return false;
+            }
+        } else if (arg == "--frame-range" && hasValue) {
+            QStringList range = args[++i].split(":");
+            bool okFirst = false;
+            bool okLast = false;
+            if (range.size() == 2) {
+                this->frameFirstMs = range[0].toDouble(&okFirst);
+                this->frameLastMs = range[1].toDouble(&okLast);
+            }
+            if (!okFirst || !okLast || this->frameFirstMs < 0 || this->frameLastMs < this->frameFirstMs) {
+                return false;
+            }
+        } else if (this->projectFile.isEmpty() && !arg.startsWith("-")) {
+            this->projectFile = arg;
+        } else {
+            return false;
+        }
+    }
+    return !this->projectFile.isEmpty();
+}
+
+int batchRunner::exec(QStringList args)
+{
+    if (!this->parseArgs(args)) {
+        fprintf(stderr, "Usage: %s --batch model.proj [-e experiment]... [-o outdir] [-j processes] [--summary file]"
+                " [--render-frames dir [--frame-step ms] [--frame-size WxH] [--frame-range first:last]]\n",
+                qPrintable(QFileInfo(args[0]).fileName()));
+        return 2;
+    }
+
+    // errors go to stderr, rather than waiting on a user
+    errorReporter::setBatchMode(true);
+
+    MainWindow::initialisePython();
+
+    this->data = new nl_rootdata();
+    this->data->main = NULL;
+
+    int result;
+    this->project = new projectObject();
+    QString projectPath = QFileInfo(this->projectFile).absoluteFilePath();
+    if (!this->project->open_project(projectPath)) {
+        result = this->writeSummary("The project '" + projectPath + "' could not be loaded");
+    } else {
+        this->project->copy_out_data(this->data);
+        this->data->projects.push_back(this->project);
+        this->data->currProject = this->project;
+
+        if (this->exptNums.isEmpty()) {
+            for (int i = 0; i < this->data->experiments.size(); ++i) {
+                this->exptNums.push_back(i);
+            }
+        }
+        if (this->outDir.isEmpty()) {
+            this->outDir = QDir::current().absoluteFilePath(this->project->getFilenameFriendlyName() + "_batch");
+        }
+        this->outDir = QDir(this->outDir).absolutePath();
+
+        this->connectionsOk = this->project->regenerate_connections(this->data);
+
+        // write the model once; each experiment gets a copy of it
+        QDir dir(this->outDir);
+        QString modelDir = dir.absoluteFilePath("model");
+        bool saved = dir.mkpath("model");
+        if (saved) {
+            exportCache::begin(modelDir);
+            saved = this->project->save_project(modelDir + QDir::separator() + QFileInfo(projectPath).fileName(), this->data);
+            exportCache::end();
+        }
+        this->project->filePath = projectPath;
+
+        if (!saved) {
+            result = this->writeSummary("The model could not be written into '" + modelDir + "'");
+        } else {
+            for (int i = 0; i < this->exptNums.size(); ++i) {
+                int n = this->exptNums[i];
+                QString err;
+                experimentSweep * sweep = NULL;
+                if (n < 0 || n >= this->data->experiments.size()) {
+                    err = "There is no experiment " + QString::number(n);
+                } else {
+                    sweep = new experimentSweep(this->data, this->data->experiments[n], n);
+                    sweep->setMaxProcesses(1);
+                    if (!sweep->prepare(dir.absoluteFilePath("e" + QString::number(n)), err, modelDir)) {
+                        delete sweep;
+                        sweep = NULL;
+                    } else {
+                        connect(sweep, SIGNAL(finished(bool)), this, SLOT(sweepFinished()));
+                    }
+                }
+                this->sweeps.push_back(sweep);
+                this->sweepErrors.push_back(err);
+            }
+
+            this->startNext();
+            if (this->running > 0) {
+                this->loop.exec();
+            }
+            if (!this->framesDir.isEmpty()) {
+                this->renderFrames();
+            }
+            result = this->writeSummary("");
+        }
+    }
+
+    MainWindow::finalisePython();
+    return result;
+}
+
+void batchRunner::startNext()
+{
+    while (this->running < this->maxProcesses && this->nextSweep < this->sweeps.size()) {
+        int i = this->nextSweep++;
+        if (this->sweeps[i] == NULL) {
+            continue;
+        }
+        QString err;
+        if (!this->sweeps[i]->start(err)) {
+            this->sweepErrors[i] = err;
+            continue;
+        }
+        ++this->running;
+        DBG() << "Started experiment" << this->exptNums[i];
+    }
+}
+
+void batchRunner::sweepFinished()
+{
+    --this->running;
+    this->startNext();
+    if (this->running == 0) {
+        this->loop.quit();
+    }
+}
+
+void batchRunner::renderFrames()
+{
+    for (int i = 0; i < this->sweeps.size(); ++i) {
+        this->frameErrors.push_back("");
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(5, 1, 0)
+    // never shown; it draws in its own offscreen context
+    glConnectionWidget widget(this->data);
+    glCamera camera = widget.getCamera();
+
+    for (int i = 0; i < this->sweeps.size(); ++i) {
+        experimentSweep * sweep = this->sweeps[i];
+        if (sweep == NULL || sweep->jobCount() == 0 || sweep->job(0).state != sweepJob::Done) {
+            this->frameErrors[i] = "The experiment did not run";
+            continue;
+        }
+        int n = this->exptNums[i];
+        experiment * expt = this->data->experiments[n];
+
+        // the logs of this experiment's run
+        QDir logs(sweep->job(0).outDir + QDir::separator() + "log");
+        QStringList files = logs.entryList(QStringList() << "*.xml", QDir::Files);
+        QVector <logData *> logList;
+        for (int f = 0; f < files.size(); ++f) {
+            logData * log = new logData();
+            log->logFileXMLname = logs.absoluteFilePath(files[f]);
+            if (!log->setupFromXML()) {
+                delete log;
+                continue;
+            }
+            logList.push_back(log);
+        }
+
+        widget.showModel(&logList);
+        // the logs are indexed by timestep
+        float dt = expt->setup.dt;
+        int endTime = (int) ((expt->setup.duration * 1000) / dt);
+        int firstTime = qMin(endTime, (int) (this->frameFirstMs / dt));
+        int lastTime = endTime;
+        if (this->frameLastMs >= 0) {
+            lastTime = qMin(endTime, (int) (this->frameLastMs / dt));
+        }
+        int step = qMax(1, qRound(this->frameStepMs / dt));
+        QString dirName = QDir(this->framesDir).absoluteFilePath("e" + QString::number(n));
+        QString err;
+        if (!widget.renderFrameSequence(dirName, this->frameWidth, this->frameHeight, camera,
+                                        firstTime, lastTime, step, err)) {
+            this->frameErrors[i] = err;
+            fprintf(stderr, "Experiment %d: %s\n", n, qPrintable(err));
+        }
+
+        widget.clear();
+        for (int f = 0; f < logList.size(); ++f) {
+            delete logList[f];
+        }
+    }
+#else
+    for (int i = 0; i < this->sweeps.size(); ++i) {
+        this->frameErrors[i] = "Rendering frames needs Qt 5.1 or later";
+    }
+#endif
+}
+
+int batchRunner::writeSummary(QString error)
+{
+    bool ok = error.isEmpty() && this->connectionsOk;
+
+    QJsonObject summary;
+    summary["project"] = QFileInfo(this->projectFile).absoluteFilePath();
+    summary["output_dir"] = this->outDir;
+    summary["connections_regenerated"] = this->connectionsOk;
+    if (!error.isEmpty()) {
+        summary["error"] = error;
+    }
+
+    QJsonArray runs;
+    for (int i = 0; i < this->sweeps.size(); ++i) {
+        QJsonObject run;
+        int n = this->exptNums[i];
+        run["experiment"] = n;
+        if (n >= 0 && n < this->data->experiments.size()) {
+            run["name"] = this->data->experiments[n]->name;
+        }
+        experimentSweep * sweep = this->sweeps[i];
+        if (sweep == NULL || sweep->jobCount() == 0) {
+            run["status"] = sweepJob::stateName(sweepJob::Failed);
+            run["error"] = this->sweepErrors[i];
+            ok = false;
+        } else {
+            const sweepJob &j = sweep->job(0);
+            run["status"] = sweepJob::stateName(j.state);
+            run["exit_code"] = j.exitCode;
+            run["sim_time_ms"] = j.simTime;
+            run["wall_time_s"] = j.wallTime / 1000.0;
+            run["output_dir"] = j.outDir;
+            if (!j.errors.isEmpty()) {
+                run["error"] = j.errors;
+            } else if (!this->sweepErrors[i].isEmpty()) {
+                run["error"] = this->sweepErrors[i];
+            }
+            if (j.state != sweepJob::Done) {
+                ok = false;
+            }
+        }
+        if (!this->framesDir.isEmpty() && i < this->frameErrors.size()) {
+            if (this->frameErrors[i].isEmpty()) {
+                run["frames_dir"] = QDir(this->framesDir).absoluteFilePath("e" + QString::number(n));
+            } else {
+                run["frames_error"] = this->frameErrors[i];
+                ok = false;
+            }
+        }
+        runs.append(run);
+    }
+    summary["runs"] = runs;
+    summary["ok"] = ok;
+
+    QByteArray json = QJsonDocument(summary).toJson();
+    if (this->summaryFile.isEmpty()) {
+        fwrite(json.constData(), 1, json.size(), stdout);
+        fflush(stdout);
+    } else {
+        QFile file(this->summaryFile);
+        if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+            fprintf(stderr, "Could not write the summary to %s\n", qPrintable(this->summaryFile));
+            return 2;
+        }
+    }
+
+    if (!error.isEmpty()) {
+        return 2;
+    }
+    return ok ? 0 : 1;
+}
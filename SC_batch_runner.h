@@ -0,0 +1,114 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef BATCHRUNNER_H
+#define BATCHRUNNER_H
+
+#include "globalHeader.h"
+#include <QEventLoop>
+
+/*!
+ * The simulated time between frames drawn by --render-frames, in ms, when
+ * --frame-step isn't given
+ */
+#define BATCH_FRAME_STEP_MS 10
+
+class experimentSweep;
+
+/*!
+ * \brief Runs the experiments of a project from the command line, without
+ * a MainWindow:
+ *
+ *   spinecreator --batch model.proj [-e N]... [-o dir] [-j N] [--summary file]
+ *                [--render-frames dir [--frame-step ms] [--frame-size WxH]
+ *                 [--frame-range first:last]]
+ *
+ * The project is loaded, its out of date Python connections regenerated and
+ * the model written once into the output directory (by default
+ * <project>_batch in the current directory). Each chosen experiment (-e,
+ * all of them by default) is then run by the simulator set up for it in the
+ * settings, up to -j at a time, in a directory of its own. A JSON summary of
+ * the runs is written to stdout, or to the --summary file, and the exit code
+ * is 0 only if every experiment ran. The simulators are configured in the
+ * settings as for the GUI.
+ *
+ * With --render-frames, once the runs are over the whole network is drawn
+ * by the 3D visualiser, coloured from each experiment's logs, to
+ * dir/e<N>/frame_000000.png and on. A frame is drawn every --frame-step ms
+ * of simulated time (BATCH_FRAME_STEP_MS by default, and never more often
+ * than the timestep), --frame-size pixels (1024x768 by default), over the
+ * --frame-range in ms (the whole experiment by default).
+ *
+ * Errors met by the model code are written to stderr by the errorReporter,
+ * in batch mode, rather than shown, so nothing waits for a user.
+ */
+class batchRunner : public QObject
+{
+    Q_OBJECT
+public:
+    explicit batchRunner(QObject * parent = 0);
+    ~batchRunner();
+
+    /*!
+     * Run the batch given by the application's arguments, and return the
+     * exit code.
+     */
+    int exec(QStringList args);
+
+private slots:
+    void sweepFinished();
+
+private:
+    bool parseArgs(QStringList args);
+    void startNext();
+    int writeSummary(QString error);
+    void renderFrames();
+
+    QString projectFile;
+    QVector <int> exptNums;
+    QString outDir;
+    QString summaryFile;
+    QString framesDir;
+    double frameStepMs;
+    int frameWidth;
+    int frameHeight;
+    double frameFirstMs;
+    // negative for the end of the experiment
+    double frameLastMs;
+    int maxProcesses;
+
+    nl_rootdata * data;
+    projectObject * project;
+    bool connectionsOk;
+    // one for each experiment, NULL if it couldn't be prepared
+    QVector <experimentSweep *> sweeps;
+    QStringList sweepErrors;
+    // for --render-frames, empty where the frames were rendered
+    QStringList frameErrors;
+    int nextSweep;
+    int running;
+    QEventLoop loop;
+};
+
+#endif // BATCHRUNNER_H
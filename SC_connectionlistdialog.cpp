@@ -26,6 +26,7 @@
 #include "ui_connectionlistdialog.h"
 #include "SC_connectionmodel.h"
 #include "NL_connection.h"
+#include <QProgressDialog>
 
 connectionListDialog::connectionListDialog (csv_connection* c, QWidget* parent) :
     QDialog(parent),
@@ -91,7 +92,33 @@ void connectionListDialog::importCSV (void)
                                                      qgetenv("HOME"),
                                                      tr("CSV files (*.csv *.txt);; All files (*.*)"));
 
-    if (this->newConn->import_csv (fileName) == true) {
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    // Large files take a while; show progress, and allow cancelling
+    QProgressDialog progress (tr("Importing connections..."), tr("Cancel"), 0, 100, this);
+    progress.setWindowModality (Qt::WindowModal);
+    progress.setMinimumDuration (500);
+    connect (this->newConn, SIGNAL(progress(int)), &progress, SLOT(setValue(int)));
+    connect (&progress, SIGNAL(canceled()), this->newConn, SLOT(cancelImport()));
+
+    QStringList errors;
+    bool imported = this->newConn->import_csv (fileName, &errors);
+    progress.reset();
+
+    if (!errors.isEmpty()) {
+        QMessageBox msgBox;
+        if (imported) {
+            msgBox.setText (tr("Some lines of the CSV file could not be read, and were skipped."));
+        } else {
+            msgBox.setText (tr("The CSV file could not be imported."));
+        }
+        msgBox.setDetailedText (errors.join ("\n"));
+        msgBox.exec();
+    }
+
+    if (imported == true) {
         // Import was successful
         this->vModel->deleteLater();
         this->vModel = new csv_connectionModel();
@@ -0,0 +1,52 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "SC_error_reporter.h"
+#include <cstdio>
+
+bool errorReporter::batch = false;
+
+void errorReporter::setBatchMode(bool batch)
+{
+    errorReporter::batch = batch;
+}
+
+bool errorReporter::batchMode()
+{
+    return errorReporter::batch;
+}
+
+void errorReporter::report(QString text, QMessageBox::Icon icon, Qt::TextFormat format)
+{
+    if (errorReporter::batch) {
+        text.replace(QRegExp("<[^>]*>"), " ");
+        fprintf(stderr, "%s\n", qPrintable(text.simplified()));
+        return;
+    }
+    QMessageBox msgBox;
+    msgBox.setText(text);
+    msgBox.setIcon(icon);
+    msgBox.setTextFormat(format);
+    msgBox.exec();
+}
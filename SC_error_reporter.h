@@ -0,0 +1,53 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef ERRORREPORTER_H
+#define ERRORREPORTER_H
+
+#include "globalHeader.h"
+
+/*!
+ * \brief Where the errors met loading, saving and running a model go.
+ *
+ * With the GUI each is shown in a message box. In batch mode, set by
+ * spinecreator --batch, they are written to stderr instead, so that nothing
+ * waits on a user who isn't there.
+ */
+class errorReporter
+{
+public:
+    static void setBatchMode(bool batch);
+    static bool batchMode();
+
+    /*!
+     * Show text in a message box with the given icon and text format, or
+     * in batch mode write it, less any markup, to stderr.
+     */
+    static void report(QString text, QMessageBox::Icon icon = QMessageBox::NoIcon, Qt::TextFormat format = Qt::AutoText);
+
+private:
+    static bool batch;
+};
+
+#endif // ERRORREPORTER_H
@@ -0,0 +1,742 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "SC_experiment_sweep.h"
+#include "SC_network_layer_rootdata.h"
+#include "SC_projectobject.h"
+#include "EL_experiment.h"
+#include "SC_export_cache.h"
+#include "SC_simulation_progress.h"
+#include <QThread>
+#include <cmath>
+
+simulatorCommand::simulatorCommand() :
+    rebuild(false)
+{
+}
+
+bool simulatorCommand::load(QString simName, QString &err)
+{
+    QSettings settings;
+    this->simName = simName;
+
+    settings.beginGroup("simulators/" + simName);
+    QString path = settings.value("path").toString();
+    QString wk_dir_string = settings.value("working_dir").toString();
+    // REBUILD is kept with the environment variables, but the convert
+    // scripts take it as the -r option
+    this->rebuild = settings.value("envVar/REBUILD").toString() == "true";
+    settings.endGroup();
+
+    // the same checks as viewELExptPanelHandler::run()
+    QFile the_script(path);
+#ifdef Q_OS_WIN
+    if (simName != "BRAHMS") {
+#endif
+    if (!the_script.exists()) {
+        err = "The simulator '" + path + "' does not exist.";
+        return false;
+    }
+    if (!(the_script.permissions() & (QFile::ExeOwner|QFile::ExeGroup|QFile::ExeOther))) {
+        err = "The simulator '" + path + "' is not executable.";
+        return false;
+    }
+#ifdef Q_OS_WIN
+    }
+#endif
+
+    wk_dir_string = QDir::toNativeSeparators(wk_dir_string);
+#ifdef Q_OS_WIN
+    if (simName == "BRAHMS") {
+        // on windows using Ubuntu BASH we must convert the path
+        wk_dir_string = wk_dir_string.replace("\\","/");
+        wk_dir_string = wk_dir_string.replace("C:","/mnt/c");
+        wk_dir_string = wk_dir_string.replace("D:","/mnt/d");
+    }
+#endif
+    this->workingDir = QDir(wk_dir_string).absolutePath();
+
+    this->env = QProcessEnvironment::systemEnvironment();
+    settings.beginGroup("simulators/" + simName + "/envVar");
+    QStringList keys = settings.childKeys();
+    for (int i = 0; i < keys.size(); ++i) {
+        this->env.insert(keys[i], settings.value(keys[i]).toString());
+    }
+    settings.endGroup();
+    this->env.insert("PATH", this->env.value("PATH", "") + ":" + this->workingDir);
+
+    // a python convert script is given as "python script"
+    this->program = path;
+    this->scriptArgs.clear();
+#ifdef Q_OS_WIN
+    QString pythonName = "python.exe";
+#else
+    QString pythonName = "python";
+#endif
+    if (path.contains(pythonName)) {
+        QStringList pathbits = path.split(pythonName + " ");
+        if (pathbits.size() > 1) {
+            this->program = pathbits[0] + pythonName;
+            this->scriptArgs << QDir::toNativeSeparators(pathbits[1]);
+        }
+    }
+
+    return true;
+}
+
+void simulatorCommand::start(QProcess * process, QString modelDir, QString outDir, int exptNum, simulationProgress * progress) const
+{
+    process->setWorkingDirectory(this->workingDir);
+    QProcessEnvironment env = this->env;
+    if (progress != NULL) {
+        progress->addToEnvironment(env);
+    }
+    process->setProcessEnvironment(env);
+
+#ifdef Q_OS_WIN
+    if (this->simName == "BRAHMS") {
+        // BRAHMS runs under the Ubuntu BASH, which needs its own paths
+        QStringList paths;
+        paths << modelDir << outDir;
+        for (int i = 0; i < paths.size(); ++i) {
+            paths[i] = paths[i].replace("\\","/");
+            paths[i] = paths[i].replace("C:","/mnt/c");
+            paths[i] = paths[i].replace("D:","/mnt/d");
+        }
+        QString cmd = this->program + " -m " + paths[0] + " -w " + this->workingDir
+                + " -o " + paths[1] + " -e " + QString::number(exptNum);
+        if (this->rebuild) {
+            cmd += " -r";
+        }
+        process->start("c:\\WINDOWS\\sysnative\\bash.exe", QStringList() << "-c" << cmd);
+        return;
+    }
+#endif
+
+    QStringList al = this->scriptArgs;
+    al << "-m" << QDir::toNativeSeparators(modelDir)
+       << "-w" << QDir::toNativeSeparators(this->workingDir)
+       << "-o" << QDir::toNativeSeparators(outDir)
+       << "-e" << QString::number(exptNum);
+    if (this->rebuild) {
+        al << "-r";
+    }
+    DBG() << "Starting" << this->program << al;
+    process->start(this->program, al);
+}
+
+bool sweepAxis::parseValues(QString text, QVector <double> &values)
+{
+    values.clear();
+    text = text.trimmed();
+    if (text.isEmpty()) {
+        return false;
+    }
+
+    // start:step:end
+    if (text.contains(":")) {
+        QStringList parts = text.split(":");
+        if (parts.size() != 3) {
+            return false;
+        }
+        bool ok1, ok2, ok3;
+        double start = parts[0].trimmed().toDouble(&ok1);
+        double step = parts[1].trimmed().toDouble(&ok2);
+        double end = parts[2].trimmed().toDouble(&ok3);
+        if (!ok1 || !ok2 || !ok3 || step == 0 || (end - start) / step < 0) {
+            return false;
+        }
+        // allow for rounding in the step so that end is included
+        int n = (int) floor((end - start) / step + 1e-9) + 1;
+        for (int i = 0; i < n; ++i) {
+            values.push_back(start + i * step);
+        }
+        return true;
+    }
+
+    QStringList parts = text.split(QRegExp("[,\\s]+"), QString::SkipEmptyParts);
+    for (int i = 0; i < parts.size(); ++i) {
+        bool ok;
+        values.push_back(parts[i].toDouble(&ok));
+        if (!ok) {
+            values.clear();
+            return false;
+        }
+    }
+    return !values.isEmpty();
+}
+
+QString sweepJob::stateName(jobState state)
+{
+    switch (state) {
+    case Waiting:
+        return "Waiting";
+    case Running:
+        return "Running";
+    case Done:
+        return "Done";
+    case Failed:
+        return "Failed";
+    case Cancelled:
+        return "Cancelled";
+    }
+    return "";
+}
+
+experimentSweep::experimentSweep(nl_rootdata * data, experiment * expt, int exptNum, QObject * parent) :
+    QAbstractTableModel(parent),
+    rootData(data),
+    expt(expt),
+    exptNum(exptNum),
+    nextJob(0),
+    running(0),
+    maxProcesses(QThread::idealThreadCount()),
+    cancelled(false)
+{
+    if (this->maxProcesses < 1) {
+        this->maxProcesses = 1;
+    }
+}
+
+experimentSweep::~experimentSweep()
+{
+    for (int i = 0; i < this->jobs.size(); ++i) {
+        if (this->jobs[i].process != NULL) {
+            this->jobs[i].process->disconnect(this);
+            this->jobs[i].process->kill();
+            this->jobs[i].process->waitForFinished(1000);
+            delete this->jobs[i].process;
+        }
+        delete this->jobs[i].progress;
+    }
+}
+
+void experimentSweep::addAxis(const sweepAxis &axis)
+{
+    this->axes.push_back(axis);
+}
+
+const QVector <sweepAxis> &experimentSweep::getAxes() const
+{
+    return this->axes;
+}
+
+void experimentSweep::setMaxProcesses(int n)
+{
+    this->maxProcesses = qMax(1, n);
+}
+
+bool experimentSweep::isRunning() const
+{
+    return this->running > 0;
+}
+
+int experimentSweep::jobCount() const
+{
+    return this->jobs.size();
+}
+
+const sweepJob &experimentSweep::job(int i) const
+{
+    return this->jobs[i];
+}
+
+int experimentSweep::findJob(const QVector <double> &point) const
+{
+    for (int i = 0; i < this->jobs.size(); ++i) {
+        if (this->jobs[i].point == point) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+QString experimentSweep::getDir() const
+{
+    return this->dir;
+}
+
+QString experimentSweep::indexPath() const
+{
+    return QDir(this->dir).absoluteFilePath("index.csv");
+}
+
+void experimentSweep::expand()
+{
+    // every combination of the axis values, with the last axis varying fastest
+    int n = 1;
+    for (int a = 0; a < this->axes.size(); ++a) {
+        n *= this->axes[a].values.size();
+    }
+
+    this->jobs.clear();
+    for (int i = 0; i < n; ++i) {
+        sweepJob j;
+        j.point.resize(this->axes.size());
+        int rest = i;
+        for (int a = this->axes.size() - 1; a >= 0; --a) {
+            int size = this->axes[a].values.size();
+            j.point[a] = this->axes[a].values[rest % size];
+            rest /= size;
+        }
+        j.state = sweepJob::Waiting;
+        j.exitCode = 0;
+        j.simTime = 0;
+        j.wallTime = 0;
+        j.process = NULL;
+        j.progress = NULL;
+        this->jobs.push_back(j);
+    }
+}
+
+bool experimentSweep::prepare(QString dir, QString &err, QString modelDir)
+{
+    for (int a = 0; a < this->axes.size(); ++a) {
+        const sweepAxis &axis = this->axes[a];
+        if (axis.values.isEmpty()) {
+            err = "No values were given for '" + axis.label + "'";
+            return false;
+        }
+        if (axis.type == sweepAxis::changedProperty) {
+            if (axis.index < 0 || axis.index >= this->expt->changes.size()) {
+                err = "The changed property '" + axis.label + "' is not in the experiment";
+                return false;
+            }
+            exptChangeProp * change = this->expt->changes[axis.index];
+            if (!change->set || change->edit || change->par == NULL) {
+                err = "The changed property '" + axis.label + "' has not been set up";
+                return false;
+            }
+        }
+    }
+
+    if (!this->command.load(this->expt->setup.simType, err)) {
+        return false;
+    }
+
+    this->dir = QDir(dir).absolutePath();
+    QDir sweepDir(this->dir);
+    if (!sweepDir.mkpath(".")) {
+        err = "Could not create the sweep directory '" + this->dir + "'";
+        return false;
+    }
+
+    // save the model once, and copy it for each job
+    QString baseDir = modelDir;
+    if (baseDir.isEmpty()) {
+        sweepDir.mkpath("model");
+        baseDir = sweepDir.absoluteFilePath("model");
+        QString previousFilePath = this->rootData->currProject->filePath;
+        exportCache::begin(baseDir);
+        bool saved = this->rootData->currProject->save_project(baseDir + QDir::separator() + "temp.proj", this->rootData);
+        exportCache::end();
+        this->rootData->currProject->filePath = previousFilePath;
+        if (!saved) {
+            err = "The model could not be saved into '" + baseDir + "'";
+            return false;
+        }
+    }
+
+    this->beginResetModel();
+    this->expand();
+    bool ok = true;
+    for (int i = 0; i < this->jobs.size() && ok; ++i) {
+        sweepJob &j = this->jobs[i];
+        j.dir = sweepDir.absoluteFilePath(QString("job%1").arg(i, 4, 10, QChar('0')));
+        j.modelDir = j.dir + QDir::separator() + "model";
+        j.outDir = j.dir + QDir::separator() + "out";
+        ok = this->writeJobModel(j, baseDir, err);
+    }
+    this->endResetModel();
+    if (!ok) {
+        return false;
+    }
+
+    this->writeIndex();
+    DBG() << "Prepared" << this->jobs.size() << "sweep jobs in" << this->dir;
+    return true;
+}
+
+bool experimentSweep::writeJobModel(sweepJob &j, QString baseDir, QString &err)
+{
+    QDir base(baseDir);
+    QDir jobDir(j.dir);
+    if (jobDir.exists("model")) {
+        // clear out a model left by an earlier sweep
+        QDir old(j.modelDir);
+        QStringList files = old.entryList(QDir::Files);
+        for (int i = 0; i < files.size(); ++i) {
+            old.remove(files[i]);
+        }
+    }
+    if (!jobDir.mkpath("model") || !jobDir.mkpath("out")) {
+        err = "Could not create the job directory '" + j.dir + "'";
+        return false;
+    }
+
+    QString exptFile = "experiment" + QString::number(this->exptNum) + ".xml";
+    QStringList files = base.entryList(QDir::Files);
+    for (int i = 0; i < files.size(); ++i) {
+        if (files[i] == exptFile) {
+            continue;
+        }
+        // the copies are hard links where possible, as the model isn't
+        // changed by the simulator
+        if (!exportCache::linkOrCopy(base.absoluteFilePath(files[i]), QDir(j.modelDir).absoluteFilePath(files[i]))) {
+            err = "Could not copy '" + files[i] + "' into '" + j.modelDir + "'";
+            return false;
+        }
+    }
+
+    // put the job's point into the experiment just long enough to write it
+    QVector <ParameterType> oldTypes(this->expt->changes.size());
+    QVector <QVector <double> > oldValues(this->expt->changes.size());
+    QVector <QVector <int> > oldIndices(this->expt->changes.size());
+    QVector <unsigned int> oldSeeds(this->expt->ins.size());
+    for (int i = 0; i < this->expt->changes.size(); ++i) {
+        ParameterInstance * par = this->expt->changes[i]->par;
+        if (par != NULL) {
+            oldTypes[i] = par->currType;
+            oldValues[i] = par->value;
+            oldIndices[i] = par->indices;
+        }
+    }
+    for (int i = 0; i < this->expt->ins.size(); ++i) {
+        oldSeeds[i] = this->expt->ins[i]->rateSeed;
+    }
+
+    this->setPoint(j.point);
+
+    QFile file(QDir(j.modelDir).absoluteFilePath(exptFile));
+    bool ok = file.open(QIODevice::WriteOnly);
+    if (ok) {
+        QXmlStreamWriter writer(&file);
+        this->expt->writeXML(&writer, this->rootData->currProject);
+        file.close();
+    } else {
+        err = "Could not write '" + file.fileName() + "'";
+    }
+
+    for (int i = 0; i < this->expt->changes.size(); ++i) {
+        ParameterInstance * par = this->expt->changes[i]->par;
+        if (par != NULL) {
+            par->currType = oldTypes[i];
+            par->value = oldValues[i];
+            par->indices = oldIndices[i];
+        }
+    }
+    for (int i = 0; i < this->expt->ins.size(); ++i) {
+        this->expt->ins[i]->rateSeed = oldSeeds[i];
+    }
+
+    return ok;
+}
+
+void experimentSweep::setPoint(const QVector <double> &point)
+{
+    for (int a = 0; a < this->axes.size(); ++a) {
+        const sweepAxis &axis = this->axes[a];
+        if (axis.type == sweepAxis::changedProperty) {
+            // a swept property takes the same value across the population
+            ParameterInstance * par = this->expt->changes[axis.index]->par;
+            par->currType = FixedValue;
+            par->value.clear();
+            par->value.push_back(point[a]);
+            par->indices.clear();
+        } else {
+            // offset the seed for each input so they don't all draw the
+            // same rate distribution
+            for (int i = 0; i < this->expt->ins.size(); ++i) {
+                this->expt->ins[i]->rateSeed = (unsigned int) point[a] + i;
+            }
+        }
+    }
+}
+
+bool experimentSweep::start(QString &err)
+{
+    if (this->jobs.isEmpty()) {
+        err = "There are no jobs to run - has the sweep been prepared?";
+        return false;
+    }
+    this->nextJob = 0;
+    this->running = 0;
+    this->cancelled = false;
+
+    DBG() << "Running" << this->jobs.size() << "simulations," << this->maxProcesses << "at a time";
+    this->startNext();
+    return true;
+}
+
+void experimentSweep::startNext()
+{
+    while (this->running < this->maxProcesses && this->nextJob < this->jobs.size() && !this->cancelled) {
+        int i = this->nextJob++;
+        sweepJob &j = this->jobs[i];
+
+        // stop.txt is how a run is cancelled, so one left from an earlier
+        // sweep would stop this one straight away
+        QFile::remove(j.outDir + QDir::separator() + "model" + QDir::separator() + "stop.txt");
+
+        j.progress = new simulationProgress(this->expt->setup.duration, this);
+        connect(j.progress, SIGNAL(progressed()), this, SLOT(jobProgressed()));
+        j.progress->start(j.outDir);
+
+        j.process = new QProcess();
+        j.process->setStandardOutputFile(j.dir + QDir::separator() + "stdout.txt");
+        j.process->setStandardErrorFile(j.dir + QDir::separator() + "stderr.txt");
+        connect(j.process, SIGNAL(finished(int,QProcess::ExitStatus)), this, SLOT(processFinished(int,QProcess::ExitStatus)));
+        connect(j.process, SIGNAL(error(QProcess::ProcessError)), this, SLOT(processError(QProcess::ProcessError)));
+        this->command.start(j.process, j.modelDir, j.outDir, this->exptNum, j.progress);
+        j.timer.start();
+        j.state = sweepJob::Running;
+        ++this->running;
+
+        emit dataChanged(this->index(i, 0), this->index(i, this->columnCount() - 1));
+        emit jobChanged(i);
+    }
+}
+
+int experimentSweep::findJob(QObject * object)
+{
+    for (int i = 0; i < this->jobs.size(); ++i) {
+        if (this->jobs[i].process == object || this->jobs[i].progress == object) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void experimentSweep::processFinished(int exitCode, QProcess::ExitStatus status)
+{
+    int i = this->findJob(sender());
+    if (i < 0 || this->jobs[i].state != sweepJob::Running) {
+        return;
+    }
+    sweepJob &j = this->jobs[i];
+    j.exitCode = exitCode;
+    if (this->cancelled) {
+        this->finish(i, sweepJob::Cancelled);
+    } else if (status != QProcess::NormalExit || exitCode != 0) {
+        QFile errFile(j.dir + QDir::separator() + "stderr.txt");
+        if (errFile.open(QIODevice::ReadOnly)) {
+            j.errors = QString::fromUtf8(errFile.readAll()).trimmed();
+        }
+        this->finish(i, sweepJob::Failed);
+    } else {
+        this->finish(i, sweepJob::Done);
+    }
+}
+
+void experimentSweep::processError(QProcess::ProcessError error)
+{
+    int i = this->findJob(sender());
+    if (i < 0 || this->jobs[i].state != sweepJob::Running) {
+        return;
+    }
+    // a crash is reported by finished() as well
+    if (error == QProcess::FailedToStart) {
+        this->jobs[i].errors = "The simulator '" + this->command.program + "' failed to start.";
+        this->jobs[i].exitCode = -1;
+        this->finish(i, sweepJob::Failed);
+    }
+}
+
+void experimentSweep::finish(int i, sweepJob::jobState state)
+{
+    sweepJob &j = this->jobs[i];
+    j.state = state;
+    j.wallTime = j.timer.elapsed();
+    j.process->deleteLater();
+    j.process = NULL;
+    j.progress->stop();
+    j.simTime = j.progress->getSimTime();
+    j.progress->deleteLater();
+    j.progress = NULL;
+    --this->running;
+
+    emit dataChanged(this->index(i, 0), this->index(i, this->columnCount() - 1));
+    emit jobChanged(i);
+
+    this->startNext();
+    // keep the index up to date, so a sweep that is killed can still be used
+    this->writeIndex();
+
+    if (this->running == 0) {
+        bool ok = !this->cancelled;
+        for (int k = 0; k < this->jobs.size(); ++k) {
+            if (this->jobs[k].state != sweepJob::Done) {
+                ok = false;
+            }
+        }
+        DBG() << "Sweep finished in" << this->dir << (ok ? "" : "with failures");
+        emit finished(ok);
+    }
+}
+
+void experimentSweep::cancel()
+{
+    // a sweep that has finished (or not started) has already said so
+    if (!this->isRunning()) {
+        return;
+    }
+    this->cancelled = true;
+    for (int i = this->nextJob; i < this->jobs.size(); ++i) {
+        this->jobs[i].state = sweepJob::Cancelled;
+    }
+    if (this->nextJob < this->jobs.size()) {
+        emit dataChanged(this->index(this->nextJob, 0), this->index(this->jobs.size() - 1, this->columnCount() - 1));
+    }
+    this->nextJob = this->jobs.size();
+
+    // ask the running simulators to stop, as viewELExptPanelHandler::cancelRun() does
+    for (int i = 0; i < this->jobs.size(); ++i) {
+        if (this->jobs[i].state == sweepJob::Running) {
+            QFile stop(this->jobs[i].outDir + QDir::separator() + "model" + QDir::separator() + "stop.txt");
+            stop.open(QFile::WriteOnly);
+            stop.close();
+        }
+    }
+    // finished() is emitted as the last of them exits
+}
+
+void experimentSweep::jobProgressed()
+{
+    int i = this->findJob(sender());
+    if (i < 0 || this->jobs[i].state != sweepJob::Running) {
+        return;
+    }
+    this->jobs[i].simTime = this->jobs[i].progress->getSimTime();
+    emit dataChanged(this->index(i, this->axes.size() + 2), this->index(i, this->axes.size() + 2));
+}
+
+bool experimentSweep::writeIndex()
+{
+    QFile file(this->indexPath());
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        DBG() << "Could not write the sweep index" << file.fileName();
+        return false;
+    }
+    QTextStream out(&file);
+
+    out << "job";
+    for (int a = 0; a < this->axes.size(); ++a) {
+        QString label = this->axes[a].label;
+        out << ",\"" << label.replace("\"", "\"\"") << "\"";
+    }
+    out << ",status,exit_code,sim_time_ms,wall_time_s,output_dir\n";
+
+    for (int i = 0; i < this->jobs.size(); ++i) {
+        const sweepJob &j = this->jobs[i];
+        out << i;
+        for (int a = 0; a < j.point.size(); ++a) {
+            out << "," << QString::number(j.point[a], 'g', 12);
+        }
+        out << "," << sweepJob::stateName(j.state) << "," << j.exitCode << "," << j.simTime
+            << "," << j.wallTime / 1000.0
+            << ",\"" << QDir(this->dir).relativeFilePath(j.outDir) << "\"\n";
+    }
+    return true;
+}
+
+int experimentSweep::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) {
+        return 0;
+    }
+    return this->jobs.size();
+}
+
+int experimentSweep::columnCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) {
+        return 0;
+    }
+    // job, the axes, status, progress, output
+    return this->axes.size() + 4;
+}
+
+QVariant experimentSweep::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= this->jobs.size()) {
+        return QVariant();
+    }
+    const sweepJob &j = this->jobs[index.row()];
+    int col = index.column();
+    int nAxes = this->axes.size();
+
+    if (role == Qt::DisplayRole) {
+        if (col == 0) {
+            return index.row();
+        }
+        if (col <= nAxes) {
+            return j.point[col - 1];
+        }
+        if (col == nAxes + 1) {
+            return sweepJob::stateName(j.state);
+        }
+        if (col == nAxes + 2) {
+            float duration = this->expt->setup.duration * 1000;
+            if (j.state == sweepJob::Done) {
+                return QString("100%");
+            }
+            if (j.state != sweepJob::Running || j.progress == NULL || duration <= 0) {
+                return QVariant();
+            }
+            return QString::number((int) (100 * j.progress->getFraction())) + "% ("
+                    + QString::number(j.progress->getThroughput(), 'f', 0) + " ms/s)";
+        }
+        if (col == nAxes + 3) {
+            return QDir(this->dir).relativeFilePath(j.outDir);
+        }
+    }
+    if (role == Qt::ToolTipRole && !j.errors.isEmpty()) {
+        return j.errors;
+    }
+    if (role == Qt::ForegroundRole && col == nAxes + 1 && j.state == sweepJob::Failed) {
+        return QBrush(QCOL_RED2);
+    }
+    return QVariant();
+}
+
+QVariant experimentSweep::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole || orientation != Qt::Horizontal) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+    int nAxes = this->axes.size();
+    if (section == 0) {
+        return QString("Job");
+    }
+    if (section <= nAxes) {
+        return this->axes[section - 1].label;
+    }
+    if (section == nAxes + 1) {
+        return QString("Status");
+    }
+    if (section == nAxes + 2) {
+        return QString("Progress");
+    }
+    return QString("Output");
+}
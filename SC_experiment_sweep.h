@@ -0,0 +1,218 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef EXPERIMENTSWEEP_H
+#define EXPERIMENTSWEEP_H
+
+#include "globalHeader.h"
+#include <QProcess>
+#include <QProcessEnvironment>
+#include <QAbstractTableModel>
+#include <QElapsedTimer>
+
+class simulationProgress;
+
+/*!
+ * \brief How to start a simulator, as set up in the simulators/<name>
+ * settings: the program, any script it runs, its environment and working
+ * directory.
+ */
+struct simulatorCommand
+{
+    simulatorCommand();
+
+    /*!
+     * Read the settings for the simulator simName. Returns false, with the
+     * reason in err, if the simulator isn't there or can't be run.
+     */
+    bool load(QString simName, QString &err);
+
+    /*!
+     * Start the simulator on the model in modelDir, writing into outDir. If
+     * progress is given, the simulator is told where to report to.
+     */
+    void start(QProcess * process, QString modelDir, QString outDir, int exptNum, simulationProgress * progress = NULL) const;
+
+    QString simName;
+    QString program;
+    QStringList scriptArgs;
+    QProcessEnvironment env;
+    QString workingDir;
+    bool rebuild;
+};
+
+/*!
+ * \brief One axis of a sweep: the values taken by a changed property of the
+ * experiment, or the seeds given to its inputs. A seed only changes the
+ * events drawn by inputs with a Poisson rate distribution.
+ */
+struct sweepAxis
+{
+    enum axisType {
+        changedProperty,
+        inputSeed
+    };
+
+    axisType type;
+    // the index into experiment::changes, for a changedProperty axis
+    int index;
+    QString label;
+    QVector <double> values;
+
+    /*!
+     * Parse a list of values, either separated by commas or spaces
+     * ("0.1, 0.2, 0.5"), or a range given as start:step:end ("0:0.5:3").
+     */
+    static bool parseValues(QString text, QVector <double> &values);
+};
+
+/*!
+ * \brief A single simulation within a sweep.
+ */
+struct sweepJob
+{
+    enum jobState {
+        Waiting,
+        Running,
+        Done,
+        Failed,
+        Cancelled
+    };
+
+    // one value for each axis of the sweep
+    QVector <double> point;
+    QString dir;
+    QString modelDir;
+    QString outDir;
+    jobState state;
+    int exitCode;
+    float simTime;
+    // how long the simulator ran for, in ms
+    qint64 wallTime;
+    QElapsedTimer timer;
+    QString errors;
+    QProcess * process;
+    // while the job runs
+    simulationProgress * progress;
+
+    static QString stateName(jobState state);
+};
+
+/*!
+ * \brief Runs an experiment many times: over the grid of values given to its
+ * changed properties (the Tuning procedure), over a list of input seeds (the
+ * RepeatRuns procedure), or both.
+ *
+ * The model is saved once into the sweep directory, and each job gets a copy
+ * of it in a directory of its own, with its own experiment file and output
+ * directory. Up to setMaxProcesses() simulators run at once. When the sweep
+ * finishes, index.csv in the sweep directory lists each parameter point with
+ * its status and output directory.
+ */
+class experimentSweep : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    experimentSweep(nl_rootdata * data, experiment * expt, int exptNum, QObject * parent = 0);
+    ~experimentSweep();
+
+    void addAxis(const sweepAxis &axis);
+    const QVector <sweepAxis> &getAxes() const;
+
+    /*!
+     * Set the most simulators to run at once. The default is the number of
+     * cores.
+     */
+    void setMaxProcesses(int n);
+
+    /*!
+     * Save the model, expand the axes into jobs, and write each job's model
+     * copy into dir. If modelDir is given, the model already saved there is
+     * copied instead. Returns false, with the reason in err, if anything
+     * could not be written.
+     */
+    bool prepare(QString dir, QString &err, QString modelDir = QString());
+
+    /*!
+     * Start the jobs. finished() is emitted once they have all stopped.
+     */
+    bool start(QString &err);
+
+    /*!
+     * Stop any running simulators, and drop the jobs which haven't started.
+     * Does nothing unless the sweep is running.
+     */
+    void cancel();
+
+    bool isRunning() const;
+    int jobCount() const;
+    const sweepJob &job(int i) const;
+
+    /*!
+     * The job run at the given parameter point, or -1 if there wasn't one.
+     */
+    int findJob(const QVector <double> &point) const;
+
+    QString getDir() const;
+    QString indexPath() const;
+
+    // QAbstractTableModel - one row for each job
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+
+signals:
+    void jobChanged(int job);
+    void finished(bool ok);
+
+private slots:
+    void processFinished(int exitCode, QProcess::ExitStatus status);
+    void processError(QProcess::ProcessError error);
+    void jobProgressed();
+
+private:
+    void expand();
+    bool writeJobModel(sweepJob &j, QString baseDir, QString &err);
+    void setPoint(const QVector <double> &point);
+    void startNext();
+    void finish(int i, sweepJob::jobState state);
+    bool writeIndex();
+    // the job with the given process or progress
+    int findJob(QObject * object);
+
+    nl_rootdata * rootData;
+    experiment * expt;
+    int exptNum;
+    QVector <sweepAxis> axes;
+    QVector <sweepJob> jobs;
+    simulatorCommand command;
+    QString dir;
+    int nextJob;
+    int running;
+    int maxProcesses;
+    bool cancelled;
+};
+
+#endif // EXPERIMENTSWEEP_H
@@ -0,0 +1,259 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "SC_experiment_sweep_dialog.h"
+#include "SC_experiment_sweep.h"
+#include "SC_network_layer_rootdata.h"
+#include "SC_projectobject.h"
+#include "EL_experiment.h"
+#include "SC_viewELexptpanelhandler.h"
+
+experimentSweepDialog::experimentSweepDialog(nl_rootdata * data, experiment * expt, int exptNum, QWidget * parent) :
+    QDialog(parent),
+    data(data),
+    expt(expt),
+    exptNum(exptNum),
+    sweep(NULL)
+{
+    this->setWindowTitle("Sweep '" + expt->name + "'");
+    this->setAttribute(Qt::WA_DeleteOnClose);
+
+    QVBoxLayout * layout = new QVBoxLayout;
+    this->setLayout(layout);
+
+    QLabel * help = new QLabel("Give a list of values (0.1, 0.2, 0.5) or a range (start:step:end) for each "
+                               "changed property and for the input seeds. Every combination is run; "
+                               "leave a row empty to keep the experiment's value.");
+    help->setWordWrap(true);
+    layout->addWidget(help);
+
+    QFormLayout * form = new QFormLayout;
+    layout->addLayout(form);
+
+    // only properties which have been set up are written into the experiment
+    for (int i = 0; i < expt->changes.size(); ++i) {
+        exptChangeProp * change = expt->changes[i];
+        if (!change->set || change->edit || change->par == NULL) {
+            this->changeValues.push_back(NULL);
+            continue;
+        }
+        QLineEdit * values = new QLineEdit;
+        if (expt->setup.exptProcedure == Tuning && change->par->currType == FixedValue && !change->par->value.isEmpty()) {
+            values->setText(QString::number(change->par->value[0]));
+        }
+        this->changeValues.push_back(values);
+        form->addRow(change->component->getXMLName() + " " + change->par->name + ":", values);
+    }
+
+    // the seeds only change the spikes drawn for Poisson rate inputs; any
+    // other randomness in the model is the same in every run
+    bool seeded = false;
+    for (int i = 0; i < expt->ins.size(); ++i) {
+        if (!expt->ins[i]->portIsAnalog && expt->ins[i]->rateDistribution == Poisson) {
+            seeded = true;
+        }
+    }
+    this->seeds = new QLineEdit;
+    if (seeded && expt->setup.exptProcedure == RepeatRuns) {
+        this->seeds->setText("1:1:10");
+    }
+    if (!seeded) {
+        this->seeds->setPlaceholderText("No input has a Poisson rate distribution");
+    }
+    this->seeds->setEnabled(seeded);
+    form->addRow("Input seeds:", this->seeds);
+    if (!seeded && expt->setup.exptProcedure == RepeatRuns) {
+        QLabel * warning = new QLabel("None of this experiment's inputs has a Poisson rate distribution, so there "
+                                      "is no seed to vary: repeated runs would all give the same result.");
+        warning->setWordWrap(true);
+        warning->setStyleSheet("QLabel { color: red; }");
+        form->addRow(warning);
+    }
+
+    this->maxProcesses = new QSpinBox;
+    this->maxProcesses->setMinimum(1);
+    this->maxProcesses->setMaximum(256);
+    this->maxProcesses->setValue(viewELExptPanelHandler::maxConcurrentRuns());
+    this->maxProcesses->setToolTip("The most of this sweep's simulations run at once. Single runs from the experiment panel are not counted.");
+    form->addRow("Simulations at once:", this->maxProcesses);
+
+    // alongside the output of single runs, which are written to
+    // <working_dir>/temp/<project>_e<N>/run-<time>
+    QSettings settings;
+    QString wk_dir = settings.value("simulators/" + expt->setup.simType + "/working_dir").toString();
+    QHBoxLayout * dirLayout = new QHBoxLayout;
+    this->outDir = new QLineEdit(QDir::toNativeSeparators(wk_dir + "/temp/" + data->currProject->getFilenameFriendlyName()
+                                                          + "_e" + QString::number(exptNum) + "_sweep"));
+    dirLayout->addWidget(this->outDir);
+    QPushButton * browseButton = new QPushButton("Browse...");
+    connect(browseButton, SIGNAL(clicked()), this, SLOT(browse()));
+    dirLayout->addWidget(browseButton);
+    form->addRow("Output directory:", dirLayout);
+
+    this->table = new QTableView;
+    this->table->verticalHeader()->hide();
+    this->table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    layout->addWidget(this->table);
+
+    this->status = new QLabel;
+    layout->addWidget(this->status);
+
+    QDialogButtonBox * buttons = new QDialogButtonBox;
+    this->runButton = buttons->addButton("Run", QDialogButtonBox::ActionRole);
+    this->cancelButton = buttons->addButton("Stop", QDialogButtonBox::ActionRole);
+    this->cancelButton->setEnabled(false);
+    buttons->addButton(QDialogButtonBox::Close);
+    connect(this->runButton, SIGNAL(clicked()), this, SLOT(runSweep()));
+    connect(this->cancelButton, SIGNAL(clicked()), this, SLOT(cancelSweep()));
+    connect(buttons, SIGNAL(rejected()), this, SLOT(reject()));
+    layout->addWidget(buttons);
+
+    this->resize(700, 500);
+}
+
+experimentSweepDialog::~experimentSweepDialog()
+{
+    delete this->sweep;
+}
+
+void experimentSweepDialog::browse()
+{
+    QString dir = QFileDialog::getExistingDirectory(this, "Choose the directory to write the sweep into", this->outDir->text());
+    if (!dir.isEmpty()) {
+        this->outDir->setText(QDir::toNativeSeparators(dir));
+    }
+}
+
+void experimentSweepDialog::runSweep()
+{
+    if (this->sweep != NULL && this->sweep->isRunning()) {
+        return;
+    }
+
+    this->table->setModel(NULL);
+    delete this->sweep;
+    this->sweep = new experimentSweep(this->data, this->expt, this->exptNum);
+    this->sweep->setMaxProcesses(this->maxProcesses->value());
+
+    for (int i = 0; i < this->changeValues.size(); ++i) {
+        if (this->changeValues[i] == NULL || this->changeValues[i]->text().trimmed().isEmpty()) {
+            continue;
+        }
+        exptChangeProp * change = this->expt->changes[i];
+        sweepAxis axis;
+        axis.type = sweepAxis::changedProperty;
+        axis.index = i;
+        axis.label = change->component->getXMLName() + " " + change->par->name;
+        if (!sweepAxis::parseValues(this->changeValues[i]->text(), axis.values)) {
+            QMessageBox::warning(this, "Sweep", "The values for '" + axis.label + "' could not be read.");
+            return;
+        }
+        this->sweep->addAxis(axis);
+    }
+    if (this->seeds->isEnabled() && !this->seeds->text().trimmed().isEmpty()) {
+        sweepAxis axis;
+        axis.type = sweepAxis::inputSeed;
+        axis.index = -1;
+        axis.label = "seed";
+        if (!sweepAxis::parseValues(this->seeds->text(), axis.values)) {
+            QMessageBox::warning(this, "Sweep", "The input seeds could not be read.");
+            return;
+        }
+        this->sweep->addAxis(axis);
+    }
+
+    connect(this->sweep, SIGNAL(jobChanged(int)), this, SLOT(jobChanged()));
+    connect(this->sweep, SIGNAL(finished(bool)), this, SLOT(sweepFinished(bool)));
+
+    QString err;
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    bool ok = this->sweep->prepare(QDir::fromNativeSeparators(this->outDir->text()), err);
+    QApplication::restoreOverrideCursor();
+    if (ok) {
+        this->table->setModel(this->sweep);
+        this->table->resizeColumnsToContents();
+        ok = this->sweep->start(err);
+    }
+    if (!ok) {
+        QMessageBox::critical(this, "Sweep", err);
+        return;
+    }
+
+    this->runButton->setEnabled(!this->sweep->isRunning());
+    this->cancelButton->setEnabled(this->sweep->isRunning());
+    this->updateStatus();
+}
+
+void experimentSweepDialog::cancelSweep()
+{
+    if (this->sweep != NULL && this->sweep->isRunning()) {
+        this->cancelButton->setEnabled(false);
+        this->status->setText("Stopping...");
+        this->sweep->cancel();
+    }
+}
+
+void experimentSweepDialog::jobChanged()
+{
+    this->updateStatus();
+}
+
+void experimentSweepDialog::sweepFinished(bool)
+{
+    this->runButton->setEnabled(true);
+    this->cancelButton->setEnabled(false);
+    this->updateStatus();
+}
+
+void experimentSweepDialog::updateStatus()
+{
+    int counts[5] = {0, 0, 0, 0, 0};
+    for (int i = 0; i < this->sweep->jobCount(); ++i) {
+        ++counts[this->sweep->job(i).state];
+    }
+    QString text = QString("%1 running, %2 waiting, %3 done, %4 failed")
+            .arg(counts[sweepJob::Running]).arg(counts[sweepJob::Waiting])
+            .arg(counts[sweepJob::Done]).arg(counts[sweepJob::Failed]);
+    if (counts[sweepJob::Cancelled] > 0) {
+        text += QString(", %1 cancelled").arg(counts[sweepJob::Cancelled]);
+    }
+    if (!this->sweep->isRunning()) {
+        text += " - results are indexed in " + QDir::toNativeSeparators(this->sweep->indexPath());
+    }
+    this->status->setText(text);
+}
+
+void experimentSweepDialog::reject()
+{
+    if (this->sweep != NULL && this->sweep->isRunning()) {
+        QMessageBox::StandardButton b = QMessageBox::question(this, "Sweep",
+                                                              "The sweep is still running. Stop it and close?",
+                                                              QMessageBox::Yes | QMessageBox::No);
+        if (b != QMessageBox::Yes) {
+            return;
+        }
+        this->sweep->cancel();
+    }
+    QDialog::reject();
+}
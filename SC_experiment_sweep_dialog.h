@@ -0,0 +1,77 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef EXPERIMENTSWEEPDIALOG_H
+#define EXPERIMENTSWEEPDIALOG_H
+
+#include "globalHeader.h"
+#include <QDialog>
+
+class experimentSweep;
+
+/*!
+ * \brief Sets up and runs a sweep of an experiment, showing the status of
+ * each job in a table.
+ *
+ * Each changed property of the experiment can be given a list of values, and
+ * the inputs a list of seeds; every combination is run. Used for the
+ * RepeatRuns and Tuning experiment procedures.
+ */
+class experimentSweepDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    experimentSweepDialog(nl_rootdata * data, experiment * expt, int exptNum, QWidget * parent = 0);
+    ~experimentSweepDialog();
+
+public slots:
+    void reject();
+
+private slots:
+    void runSweep();
+    void cancelSweep();
+    void browse();
+    void jobChanged();
+    void sweepFinished(bool ok);
+
+private:
+    void updateStatus();
+
+    nl_rootdata * data;
+    experiment * expt;
+    int exptNum;
+    experimentSweep * sweep;
+
+    // one for each changed property, NULL if it can't be swept
+    QVector <QLineEdit *> changeValues;
+    QLineEdit * seeds;
+    QSpinBox * maxProcesses;
+    QLineEdit * outDir;
+    QTableView * table;
+    QLabel * status;
+    QPushButton * runButton;
+    QPushButton * cancelButton;
+};
+
+#endif // EXPERIMENTSWEEPDIALOG_H
@@ -0,0 +1,283 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "SC_export_cache.h"
+#include <QCryptographicHash>
+#include <QSaveFile>
+
+#ifdef Q_OS_WIN
+  #include <windows.h>
+#else
+  #include <unistd.h>
+#endif
+
+#define EXPORT_MANIFEST ".spinecreator_export"
+#define EXPORT_CHUNK (1 << 20)
+
+exportCache * exportCache::cache = NULL;
+QMap <QString, exportCache::entry> exportCache::sourceHashes;
+
+exportCache::exportCache(QString dir) :
+    dir(dir),
+    written(0),
+    reused(0)
+{
+}
+
+void exportCache::begin(QString dir)
+{
+    exportCache::end();
+    cache = new exportCache(QDir(dir).absolutePath());
+    cache->load();
+}
+
+void exportCache::end()
+{
+    if (cache == NULL) {
+        return;
+    }
+    cache->save();
+    DBG() << "Exported to" << cache->dir.absolutePath() << ":" << cache->written << "files written," << cache->reused << "unchanged";
+    delete cache;
+    cache = NULL;
+}
+
+exportCache * exportCache::forDir(QDir dir)
+{
+    if (cache != NULL && cache->dir.absolutePath() == dir.absolutePath()) {
+        return cache;
+    }
+    return NULL;
+}
+
+exportCache * exportCache::forPath(QString path)
+{
+    return exportCache::forDir(QFileInfo(path).absoluteDir());
+}
+
+void exportCache::load()
+{
+    QFile file(this->dir.absoluteFilePath(EXPORT_MANIFEST));
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return;
+    }
+    // hash size modified name, one file to a line
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        QStringList parts = in.readLine().split(" ");
+        if (parts.size() < 4) {
+            continue;
+        }
+        entry e;
+        e.hash = QByteArray::fromHex(parts[0].toLatin1());
+        e.size = parts[1].toLongLong();
+        e.modified = parts[2].toLongLong();
+        this->manifest[QStringList(parts.mid(3)).join(" ")] = e;
+    }
+}
+
+void exportCache::save()
+{
+    QFile file(this->dir.absoluteFilePath(EXPORT_MANIFEST));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        DBG() << "Could not write the export manifest" << file.fileName();
+        return;
+    }
+    QTextStream out(&file);
+    QMap <QString, entry>::const_iterator i;
+    for (i = this->manifest.constBegin(); i != this->manifest.constEnd(); ++i) {
+        // forget files which have gone
+        if (!this->dir.exists(i.key())) {
+            continue;
+        }
+        out << i.value().hash.toHex() << " " << i.value().size << " " << i.value().modified << " " << i.key() << "\n";
+    }
+}
+
+bool exportCache::upToDate(QString fileName, const QByteArray &hash)
+{
+    if (!this->manifest.contains(fileName)) {
+        return false;
+    }
+    const entry &e = this->manifest[fileName];
+    QFileInfo info(this->dir.absoluteFilePath(fileName));
+    // a file changed behind our back is written again
+    return e.hash == hash && info.exists() && info.size() == e.size
+            && info.lastModified().toMSecsSinceEpoch() == e.modified;
+}
+
+void exportCache::record(QString fileName, const QByteArray &hash)
+{
+    QFileInfo info(this->dir.absoluteFilePath(fileName));
+    entry e;
+    e.hash = hash;
+    e.size = info.size();
+    e.modified = info.lastModified().toMSecsSinceEpoch();
+    this->manifest[fileName] = e;
+    this->exported.insert(fileName);
+    ++this->written;
+}
+
+bool exportCache::writeFile(QString path, const QByteArray &data)
+{
+    exportCache * c = exportCache::forPath(path);
+    QString fileName = QFileInfo(path).fileName();
+    QByteArray hash;
+    if (c != NULL) {
+        hash = QCryptographicHash::hash(data, QCryptographicHash::Md5);
+        if (c->upToDate(fileName, hash)) {
+            c->exported.insert(fileName);
+            ++c->reused;
+            return true;
+        }
+    }
+
+    if (c == NULL) {
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+            return false;
+        }
+        file.close();
+        return true;
+    }
+
+    // replace rather than overwrite the file, as it may be linked into a
+    // run directory, and keep the old one if the write fails
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        return false;
+    }
+    c->record(fileName, hash);
+    return true;
+}
+
+bool exportCache::copyFile(QString src, QString dst, qint64 size)
+{
+    exportCache * c = exportCache::forPath(dst);
+    QString fileName = QFileInfo(dst).fileName();
+    QByteArray hash;
+    if (c != NULL) {
+        QFileInfo srcInfo(src);
+        QString key = srcInfo.absoluteFilePath();
+        qint64 srcModified = srcInfo.lastModified().toMSecsSinceEpoch();
+        if (sourceHashes.contains(key) && sourceHashes[key].size == srcInfo.size()
+                && sourceHashes[key].modified == srcModified && sourceHashes[key].copied == size) {
+            hash = sourceHashes[key].hash;
+        } else {
+            QFile in(src);
+            if (!in.open(QIODevice::ReadOnly)) {
+                return false;
+            }
+            QCryptographicHash h(QCryptographicHash::Md5);
+            qint64 left = size;
+            while (left > 0) {
+                QByteArray chunk = in.read(qMin(left, (qint64) EXPORT_CHUNK));
+                if (chunk.isEmpty()) {
+                    break;
+                }
+                h.addData(chunk);
+                left -= chunk.size();
+            }
+            // the padding, if src is short
+            if (left > 0) {
+                h.addData(QByteArray(QString::number(left).toLatin1()));
+            }
+            hash = h.result();
+            // one entry to a source, replaced when it changes
+            entry e;
+            e.hash = hash;
+            e.size = srcInfo.size();
+            e.modified = srcModified;
+            e.copied = size;
+            sourceHashes[key] = e;
+        }
+        if (c->upToDate(fileName, hash)) {
+            c->exported.insert(fileName);
+            ++c->reused;
+            return true;
+        }
+    }
+
+    QFile in(src);
+    if (!in.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    // as in writeFile(), only a file in the cache's directory is replaced
+    QSaveFile saveFile(dst);
+    QFile plainFile(dst);
+    QFileDevice &out = c != NULL ? (QFileDevice &) saveFile : (QFileDevice &) plainFile;
+    if (!out.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    // src may hold more or fewer bytes than wanted
+    qint64 left = size;
+    while (left > 0) {
+        QByteArray chunk = in.read(qMin(left, (qint64) EXPORT_CHUNK));
+        if (chunk.isEmpty()) {
+            chunk = QByteArray((int) qMin(left, (qint64) EXPORT_CHUNK), '\0');
+        }
+        if (out.write(chunk) != chunk.size()) {
+            return false;
+        }
+        left -= chunk.size();
+    }
+
+    if (c == NULL) {
+        plainFile.close();
+        return plainFile.error() == QFileDevice::NoError;
+    }
+    if (!saveFile.commit()) {
+        return false;
+    }
+    c->record(fileName, hash);
+    return true;
+}
+
+bool exportCache::linkOrCopy(QString src, QString dst)
+{
+    QFile::remove(dst);
+#ifdef Q_OS_WIN
+    if (CreateHardLinkW((LPCWSTR) QDir::toNativeSeparators(dst).utf16(),
+                        (LPCWSTR) QDir::toNativeSeparators(src).utf16(), NULL)) {
+        return true;
+    }
+#else
+    if (::link(QFile::encodeName(src).constData(), QFile::encodeName(dst).constData()) == 0) {
+        return true;
+    }
+#endif
+    // across file systems, or where links aren't supported
+    return QFile::copy(src, dst);
+}
+
+void exportCache::removeUnexported()
+{
+    QStringList files = this->dir.entryList(QDir::Files | QDir::Hidden);
+    for (int i = 0; i < files.size(); ++i) {
+        if (files[i] != EXPORT_MANIFEST && !this->exported.contains(files[i])) {
+            this->dir.remove(files[i]);
+            this->manifest.remove(files[i]);
+        }
+    }
+}
@@ -0,0 +1,119 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef EXPORTCACHE_H
+#define EXPORTCACHE_H
+
+#include "globalHeader.h"
+
+/*!
+ * \brief Keeps a model directory which is exported to again and again - the
+ * directory a simulation is run from - up to date by writing only the files
+ * whose content has changed.
+ *
+ * While a cache is open on a directory, writeFile() and copyFile() hash what
+ * would be written, and leave the file alone if the manifest says it already
+ * holds that content (and it hasn't been touched since). Unchanged component
+ * files then also keep their timestamps, so the simulator doesn't rebuild
+ * them. The manifest is kept in the directory, in .spinecreator_export.
+ *
+ * Files written anywhere else, or with no cache open, are always written, in
+ * place. In the cache's directory a changed file is replaced instead, so
+ * that the copies hard linked into earlier runs are left as they were.
+ */
+class exportCache
+{
+public:
+    /*!
+     * Open a cache on dir until end() is called. Only one cache is open at
+     * a time.
+     */
+    static void begin(QString dir);
+
+    /*!
+     * Save the manifest and close the cache.
+     */
+    static void end();
+
+    /*!
+     * The open cache if it is on dir, otherwise NULL.
+     */
+    static exportCache * forDir(QDir dir);
+
+    /*!
+     * Write data to path, unless it already holds exactly that. Returns
+     * false if the file could not be written.
+     */
+    static bool writeFile(QString path, const QByteArray &data);
+
+    /*!
+     * Copy the first size bytes of src to dst, padding with zeros if src is
+     * shorter, unless dst already holds exactly that. The hash of src is
+     * remembered for as long as its size and modification time stay the
+     * same, so an unchanged source isn't read again. Returns false if dst
+     * could not be written.
+     */
+    static bool copyFile(QString src, QString dst, qint64 size);
+
+    /*!
+     * Make dst a hard link to src where the file system allows, otherwise a
+     * copy. Anything already at dst is replaced.
+     */
+    static bool linkOrCopy(QString src, QString dst);
+
+    /*!
+     * Remove the files in the directory which were not written, or found up
+     * to date, since the cache was opened.
+     */
+    void removeUnexported();
+
+private:
+    struct entry {
+        QByteArray hash;
+        qint64 size;
+        qint64 modified;
+        // the length copied, for a copyFile() source
+        qint64 copied;
+    };
+
+    exportCache(QString dir);
+    void load();
+    void save();
+    bool upToDate(QString fileName, const QByteArray &hash);
+    void record(QString fileName, const QByteArray &hash);
+    static exportCache * forPath(QString path);
+
+    QDir dir;
+    QMap <QString, entry> manifest;
+    QSet <QString> exported;
+    int written;
+    int reused;
+
+    static exportCache * cache;
+    // the hashes of copyFile() sources, keyed on path; an entry holds for
+    // as long as the size, modification time and length copied match
+    static QMap <QString, entry> sourceHashes;
+};
+
+#endif // EXPORTCACHE_H
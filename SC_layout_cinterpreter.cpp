@@ -287,7 +287,7 @@ float * getVarPtr(QString in, vector <lookup> &varList) {
 
 }
 
-float doFunction(float val1, float val2, float opf) {
+float doFunction(float val1, float val2, float opf, layoutRandom& rng) {
 
     int op = int(opf);
 
@@ -315,7 +315,7 @@ float doFunction(float val1, float val2, float opf) {
     if (op == 16) return atan2(val1, val2);
     if (op == 17) return ceil(val1);
     if (op == 18) return floor(val1);
-    if (op == 19) return float(rand())/RAND_MAX;
+    if (op == 19) return rng.next();
     if (op == 20) return fmod(val1, val2);
 
     return 0;
@@ -753,7 +753,7 @@ QString doBoolBrackets(int startInd, int endInd, vector <valop> opstackIn, float
 
 }
 */
-float interpretMaths(vector <valop> stack) {
+float interpretMaths(vector <valop> stack, layoutRandom& rng) {
 
     // evaluate the stack:
     vector <valop> tempStack;
@@ -798,7 +798,7 @@ float interpretMaths(vector <valop> stack) {
                     val1 = INFINITY;
                 }
 
-                float result = doFunction(val2, val1, stack[i].val);
+                float result = doFunction(val2, val1, stack[i].val, rng);
                 /*qDebug() << "function " << "isUnary(" << float(stack[i].isUnary) << ") " <<  stack[i].val << " " << val2 << " " << val1 << "\n";
                 qDebug() << "result = " << result;*/
                 // push back result onto stack
@@ -1131,3 +1131,213 @@ QString createStack(QString equation, vector <lookup> &varList, vector <valop> *
     return "";
 }
 
+
+// Constant registers which every program has, after the variables
+#define LAYOUT_CONST_ZERO 0
+#define LAYOUT_CONST_INF 1
+
+// the splitmix64 finaliser
+static quint64 layoutMix(quint64 z)
+{
+    z = (z ^ (z >> 30)) * Q_UINT64_C(0xbf58476d1ce4e5b9);
+    z = (z ^ (z >> 27)) * Q_UINT64_C(0x94d049bb133111eb);
+    return z ^ (z >> 31);
+}
+
+layoutRandom::layoutRandom(quint32 seed, quint32 stream)
+{
+    this->key = layoutMix(((quint64) seed << 32) | stream);
+    this->draws = 0;
+}
+
+float layoutRandom::next (void)
+{
+    quint64 z = layoutMix(this->key + (quint64) this->draws * Q_UINT64_C(0x9e3779b97f4a7c15));
+    ++this->draws;
+    // the top 24 bits, which a float holds exactly
+    return float(z >> 40) * (1.0f / 16777216.0f);
+}
+
+layoutProgram::layoutProgram()
+{
+    this->numVars = 0;
+    this->numTemps = 0;
+    this->result = 0;
+}
+
+QString layoutProgram::compile (QString equation, vector <lookup> &varList)
+{
+    this->code.clear();
+    this->consts.clear();
+    this->numVars = varList.size();
+    this->numTemps = 0;
+
+    vector <valop> stack;
+    QString err = createStack(equation, varList, &stack);
+    if (err != "") {
+        return err;
+    }
+
+    // Constants first, so that the temporaries can follow them
+    this->consts.push_back(0.0);
+    this->consts.push_back(INFINITY);
+    vector <int> constReg(stack.size(), -1);
+    for (uint i = 0; i < stack.size(); ++i) {
+        if (stack[i].op == VAL && stack[i].ptr == NULL) {
+            constReg[i] = this->numVars + this->consts.size();
+            this->consts.push_back(stack[i].val);
+        }
+    }
+    int zero = this->numVars + LAYOUT_CONST_ZERO;
+    int inf = this->numVars + LAYOUT_CONST_INF;
+    int tempBase = this->numVars + this->consts.size();
+
+    // Run the stack symbolically, tracking which register holds each
+    // entry. Missing operands get the values interpretMaths() gives them.
+    vector <int> sim;
+    for (uint i = 0; i < stack.size(); ++i) {
+
+        switch (stack[i].op) {
+        case VAL:
+            if (stack[i].ptr == NULL) {
+                sim.push_back(constReg[i]);
+            } else {
+                int slot = -1;
+                for (uint v = 0; v < varList.size(); ++v) {
+                    if (&(varList[v].value) == stack[i].ptr) {
+                        slot = v;
+                        break;
+                    }
+                }
+                if (slot == -1) {
+                    return doError(2);
+                }
+                sim.push_back(slot);
+            }
+            break;
+        case OP:
+        case FUNC:
+        {
+            bool isFunc = stack[i].op == FUNC;
+            layoutInstr in;
+            // the top of the stack
+            int top = isFunc ? inf : zero;
+            if (sim.size()) {
+                top = sim.back();
+                sim.pop_back();
+            }
+            // and the operand below it, for binary operations
+            int below = zero;
+            if (!stack[i].isUnary && sim.size()) {
+                below = sim.back();
+                sim.pop_back();
+            }
+            if (isFunc) {
+                in.op = layoutOpCode(LOP_POW + int(stack[i].val));
+                if (stack[i].isUnary) {
+                    in.a = top;
+                    in.b = inf;
+                } else {
+                    in.a = below;
+                    in.b = top;
+                }
+            } else {
+                switch (int(stack[i].val)) {
+                case ADD:  in.op = LOP_ADD; break;
+                case SUB:  in.op = LOP_SUB; break;
+                case MULT: in.op = LOP_MULT; break;
+                default:   in.op = LOP_DIV; break;
+                }
+                // (a unary operator applies to zero)
+                in.a = below;
+                in.b = top;
+            }
+            in.dst = tempBase + sim.size();
+            if ((int) sim.size() + 1 > this->numTemps) {
+                this->numTemps = sim.size() + 1;
+            }
+            this->code.push_back(in);
+            sim.push_back(in.dst);
+            break;
+        }
+        default:
+            // other symbols are not left in an RPN stack
+            break;
+        }
+    }
+
+    this->result = sim.size() ? sim.back() : zero;
+
+    return "";
+}
+
+int layoutProgram::numRegs (void) const
+{
+    return this->numVars + this->consts.size() + this->numTemps;
+}
+
+void layoutProgram::initRegs (float* r) const
+{
+    for (uint c = 0; c < this->consts.size(); ++c) {
+        r[this->numVars + c] = this->consts[c];
+    }
+}
+
+bool layoutProgram::readsVar (int slot) const
+{
+    if (this->result == slot) {
+        return true;
+    }
+    for (uint i = 0; i < this->code.size(); ++i) {
+        if (this->code[i].a == slot || this->code[i].b == slot) {
+            return true;
+        }
+    }
+    return false;
+}
+
+float layoutProgram::eval (const float* vars, float* r, layoutRandom& rng) const
+{
+    for (int v = 0; v < this->numVars; ++v) {
+        r[v] = vars[v];
+    }
+
+    for (uint i = 0; i < this->code.size(); ++i) {
+        const layoutInstr& in = this->code[i];
+        float a = r[in.a];
+        float b = r[in.b];
+        float v;
+        // as doFunction(), binary functions of INFINITY are INFINITY
+        switch (in.op) {
+        case LOP_ADD:   v = a + b; break;
+        case LOP_SUB:   v = a - b; break;
+        case LOP_MULT:  v = a * b; break;
+        case LOP_DIV:   v = a / b; break;
+        case LOP_POW:   v = (b == INFINITY) ? INFINITY : pow(a, b); break;
+        case LOP_EXP:   v = exp(a); break;
+        case LOP_SIN:   v = sin(a); break;
+        case LOP_COS:   v = cos(a); break;
+        case LOP_LOG:   v = log(a); break;
+        case LOP_LOG10: v = log10(a); break;
+        case LOP_SINH:  v = sinh(a); break;
+        case LOP_COSH:  v = cosh(a); break;
+        case LOP_TANH:  v = tanh(a); break;
+        case LOP_SQRT:  v = sqrt(a); break;
+        case LOP_ATAN:  v = atan(a); break;
+        case LOP_ASIN:  v = asin(a); break;
+        case LOP_ACOS:  v = acos(a); break;
+        case LOP_ASINH: v = asinh(a); break;
+        case LOP_ACOSH: v = acosh(a); break;
+        case LOP_ATANH: v = atanh(a); break;
+        case LOP_ATAN2: v = (b == INFINITY) ? INFINITY : atan2(a, b); break;
+        case LOP_CEIL:  v = ceil(a); break;
+        case LOP_FLOOR: v = floor(a); break;
+        case LOP_RAND:  v = rng.next(); break;
+        case LOP_MOD:   v = (b == INFINITY) ? INFINITY : fmod(a, b); break;
+        default:        v = 0; break;
+        }
+        r[in.dst] = v;
+    }
+
+    return r[this->result];
+}
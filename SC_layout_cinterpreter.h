@@ -77,6 +77,28 @@ struct valop {
 };
 
 
+/*!
+ * \brief Counter based random numbers for layout generation.
+ *
+ * Each draw is a hash of (seed, stream, draw number), so the numbers for
+ * one neuron (the stream) do not depend on how many were drawn for any
+ * other, or in what order the neurons were generated. The same seed gives
+ * the same numbers on any machine and with any number of threads.
+ */
+class layoutRandom {
+public:
+    layoutRandom(quint32 seed, quint32 stream);
+
+    //! The next number, uniform in [0,1)
+    float next (void);
+
+    //! The number of draws made so far on this stream
+    quint32 draws;
+
+private:
+    quint64 key;
+};
+
 bool isOperation(QString in);
 
 opType getOpVal(QString in);
@@ -89,7 +111,7 @@ float getVarVal(QString in, vector <lookup> varList);
 
 float * getVarPtr(QString in, vector <lookup> &varList);
 
-float doFunction(float val1, float val2, float opf);
+float doFunction(float val1, float val2, float opf, layoutRandom& rng);
 
 bool isVar(QString in);
 
@@ -117,8 +139,89 @@ QString doBoolean(int startInd, int endInd, vector <valop> opstackIn, float * ou
 
 QString doBoolBrackets(int startInd, int endInd, vector <valop> opstackIn, float * outVal);
 */
-float interpretMaths(vector <valop>);
+float interpretMaths(vector <valop>, layoutRandom& rng);
 
 QString createStack(QString equation, vector <lookup> &varList, vector <valop> * returnStack);
 
+/*!
+ * Instructions of a layoutProgram. The functions follow the order of
+ * getFuncVal(), so that LOP_POW + getFuncVal(name) is the function's opcode.
+ */
+enum layoutOpCode {
+    LOP_ADD,
+    LOP_SUB,
+    LOP_MULT,
+    LOP_DIV,
+    LOP_POW,
+    LOP_EXP,
+    LOP_SIN,
+    LOP_COS,
+    LOP_LOG,
+    LOP_LOG10,
+    LOP_SINH,
+    LOP_COSH,
+    LOP_TANH,
+    LOP_SQRT,
+    LOP_ATAN,
+    LOP_ASIN,
+    LOP_ACOS,
+    LOP_ASINH,
+    LOP_ACOSH,
+    LOP_ATANH,
+    LOP_ATAN2,
+    LOP_CEIL,
+    LOP_FLOOR,
+    LOP_RAND,
+    LOP_MOD
+};
+
+struct layoutInstr {
+    layoutOpCode op;
+    int dst;
+    int a;
+    int b;
+};
+
+/*!
+ * \brief A layout equation compiled once into register based bytecode.
+ *
+ * compile() parses the equation with createStack() and turns the RPN stack
+ * into three address instructions over a register file which holds the
+ * variables (one slot per varList entry, in order), then the constants, then
+ * the temporaries. Evaluation then needs no allocation, stack or name lookup,
+ * and gives the same result as interpretMaths() on the same stack.
+ */
+class layoutProgram {
+public:
+    layoutProgram();
+
+    /*!
+     * Compile equation, with variables from varList. Returns an error
+     * message, or an empty string on success.
+     */
+    QString compile (QString equation, vector <lookup> &varList);
+
+    /*!
+     * Evaluate, with the variable values in vars (in varList order), using
+     * the caller's register file regs, which must have numRegs() entries and
+     * have been set up by initRegs(). rand() draws from rng. For use from
+     * several threads at once, each with its own regs and rng.
+     */
+    float eval (const float* vars, float* regs, layoutRandom& rng) const;
+
+    //! True if the program reads variable slot
+    bool readsVar (int slot) const;
+
+    int numRegs (void) const;
+    void initRegs (float* regs) const;
+
+private:
+    vector <layoutInstr> code;
+    vector <float> consts;
+    int numVars;
+    int numTemps;
+    //! The register holding the result
+    int result;
+};
+
 #endif // CINTERPRETER_H
@@ -26,19 +26,194 @@
 // qcustomplot widget
 
 #include "SC_logged_data.h"
+#include "SC_logged_data_summary.h"
+#include "SC_logged_data_events.h"
+#include "SC_logged_data_text.h"
 #include <QXmlStreamReader>
 
 logData::logData(QObject *parent) :
     QObject(parent)
 {
     this->timeStep = 0.1;
+    this->mappedData = (uchar*)0;
+    this->mappedSize = 0;
+    this->dataOffset = 0;
+    this->binaryDataStride = 0;
+    this->summary = new logSummaryIndex();
+    this->events = new logEventIndex();
+    this->following = false;
+    this->watcher = (QFileSystemWatcher*)0;
+    this->followTimer.setSingleShot(true);
+    connect(&this->followTimer, SIGNAL(timeout()), this, SLOT(readNewRows()));
+}
+
+logData::~logData()
+{
+    this->unmapLogFile();
+    delete this->summary;
+    delete this->events;
 }
 
 void logData::deleteLogFile (void)
 {
+    this->unmapLogFile();
     QDir dir;
+    dir.remove(this->summaryFileName());
     dir.remove(this->logFileXMLname);
     dir.remove(this->logFile.fileName());
+    if (!this->textLogFileName.isEmpty()) {
+        dir.remove(this->textLogFileName);
+    }
+}
+
+bool logData::mapLogFile()
+{
+    this->unmapLogFile();
+
+    if (this->dataFormat != BINARY) {
+        return false;
+    }
+    if (!this->logFile.isOpen()) {
+        return false;
+    }
+    if (!this->calculateBinaryDataStride()) {
+        return false;
+    }
+
+    qint64 sz = this->logFile.size();
+    if (sz == 0) {
+        // Nothing to map (yet)
+        return false;
+    }
+
+    this->mappedData = this->logFile.map (0, sz);
+    if (this->mappedData == (uchar*)0) {
+        qDebug() << "Couldn't memory map log file" << this->logFile.fileName() << ":" << this->logFile.errorString();
+        return false;
+    }
+    this->mappedSize = sz;
+    return true;
+}
+
+void logData::unmapLogFile()
+{
+    if (this->mappedData != (uchar*)0) {
+        this->logFile.unmap (this->mappedData);
+    }
+    this->mappedData = (uchar*)0;
+    this->mappedSize = 0;
+}
+
+QString logData::summaryFileName()
+{
+    return this->logFileXMLname + ".summary";
+}
+
+bool logData::setupSummary()
+{
+    if (this->dataClass != ANALOGDATA || this->mappedData == (uchar*)0) {
+        return false;
+    }
+
+    QFileInfo fi(this->logFile);
+    qint64 mtime = fi.lastModified().toMSecsSinceEpoch();
+    if (this->summary->load (this->summaryFileName(), this->mappedSize, mtime,
+                             this->binaryDataStride, this->columns.size())) {
+        return true;
+    }
+
+    // Not on disk, or out of date; build it in one pass and save for next time
+    QVector < logColumnView > cols;
+    for (int c = 0; c < this->columns.size(); ++c) {
+        logColumnView col = this->getColumn(c);
+        if (col.isNull()) {
+            return false;
+        }
+        cols.push_back(col);
+    }
+    this->summary->build (cols);
+    if (!this->summary->save (this->summaryFileName(), this->mappedSize, mtime, this->binaryDataStride)) {
+        DBG() << "Couldn't save summary for" << this->logFileXMLname << "- will rebuild next time";
+    }
+    return this->summary->isValid();
+}
+
+bool logData::setupTextLog()
+{
+    if (this->columns.size() == 0) {
+        return false;
+    }
+    this->textLogFileName = this->logFile.fileName();
+    QFileInfo fi(this->logFile);
+    qint64 textSize = fi.size();
+    qint64 textMTime = fi.lastModified().toMSecsSinceEpoch();
+
+    // The cache lives next to the log, or in the temp dir if that is read
+    // only; look in the same places, in the same order, as it is written
+    QString cacheName = this->textLogFileName + ".cache";
+    QString tempCacheName = QDir::temp().absoluteFilePath (QString::number(qHash(this->textLogFileName)) + "_" + fi.fileName() + ".cache");
+    if (logTextLoader::cacheIsCurrent (cacheName, textSize, textMTime, this->columns.size())) {
+        // use the cache next to the log
+    } else if (logTextLoader::cacheIsCurrent (tempCacheName, textSize, textMTime, this->columns.size())) {
+        cacheName = tempCacheName;
+    } else {
+        QVector < QVector < double > > cols;
+        QString err;
+        if (!logTextLoader::parse (this->logFile, this->dataFormat, this->columns.size(), cols, err)) {
+            qDebug() << err;
+            return false;
+        }
+        if (!logTextLoader::writeCache (cacheName, textSize, textMTime, cols)) {
+            cacheName = tempCacheName;
+            if (!logTextLoader::writeCache (cacheName, textSize, textMTime, cols)) {
+                qDebug() << "Couldn't write cache for text log" << this->textLogFileName;
+                return false;
+            }
+        }
+    }
+
+    // From here on, the log is read as a binary log of doubles
+    this->logFile.close();
+    this->logFile.setFileName (cacheName);
+    if (!this->logFile.open (QIODevice::ReadOnly)) {
+        qDebug() << "Couldn't open cache for text log" << this->textLogFileName;
+        return false;
+    }
+    for (int i = 0; i < this->columns.size(); ++i) {
+        this->columns[i].type = TYPE_DOUBLE;
+    }
+    this->dataFormat = BINARY;
+    this->dataOffset = logTextLoader::cacheHeaderSize;
+    return true;
+}
+
+bool logData::getWindowStats(int colNum, qint64 row0, qint64 row1, double& mn, double& mx, double& mean)
+{
+    if (!this->summary->isValid()) {
+        return false;
+    }
+    return this->summary->getWindow (colNum, row0, row1, this->getColumn(colNum), mn, mx, mean);
+}
+
+qint64 logData::rowCount()
+{
+    if (this->mappedData == (uchar*)0 || this->binaryDataStride <= 0) {
+        return 0;
+    }
+    return (this->mappedSize - this->dataOffset) / this->binaryDataStride;
+}
+
+logColumnView logData::getColumn(int colNum)
+{
+    if (this->mappedData == (uchar*)0 || colNum < 0 || colNum >= (int) this->columns.size()) {
+        return logColumnView();
+    }
+    int offset = this->calculateBinaryDataOffset(colNum);
+    if (offset == -1) {
+        return logColumnView();
+    }
+    return logColumnView (this->mappedData + this->dataOffset + offset, this->binaryDataStride,
+                          this->rowCount(), this->columns[colNum].type);
 }
 
 double logData::getMax()
@@ -47,20 +222,21 @@ double logData::getMax()
         return max;
     }
 
-    // no max, must calculate
+    if (this->summary->isValid()) {
+        max = this->summary->getMax();
+        return max;
+    }
+
+    // no max, must calculate. Walk each column of the mapping in turn.
     double tempMax = -Q_INFINITY;
-    QVector < double > rowData;
-    rowData.push_back(-Q_INFINITY);
-    int i = 0;
-    while (rowData.size() > 0) {
-        for (int j = 0; j < rowData.size(); ++j) {
-            if (rowData[j] > tempMax && rowData[j] < Q_INFINITY) {
-                tempMax = rowData[j];
+    for (int c = 0; c < columns.size(); ++c) {
+        logColumnView col = this->getColumn(c);
+        for (qint64 r = 0; r < col.size(); ++r) {
+            double v = col.at(r);
+            if (v > tempMax && v < Q_INFINITY) {
+                tempMax = v;
             }
         }
-        //qDebug() << rowData[0] << rowData[1]<< rowData[2]<< rowData[3]<< rowData[4]<< rowData[5]<< rowData[6]<< rowData[7]<< rowData[8]<< rowData[9];}
-        rowData = getRow(i);
-        ++i;
     }
     max = tempMax;
     return max;
@@ -72,19 +248,21 @@ double logData::getMin()
         return min;
     }
 
+    if (this->summary->isValid()) {
+        min = this->summary->getMin();
+        return min;
+    }
+
     // no min, must calculate
     double tempMin = Q_INFINITY;
-    QVector < double > rowData;
-    rowData.push_back(Q_INFINITY);
-    int i = 0;
-    while (rowData.size() > 0) {
-        for (int j = 0; j < rowData.size(); ++j) {
-            if (rowData[j] < tempMin) {
-                tempMin = rowData[j];
+    for (int c = 0; c < columns.size(); ++c) {
+        logColumnView col = this->getColumn(c);
+        for (qint64 r = 0; r < col.size(); ++r) {
+            double v = col.at(r);
+            if (v < tempMin) {
+                tempMin = v;
             }
         }
-        rowData = getRow(i);
-        ++i;
     }
     min = tempMin;
     return min;
@@ -93,165 +271,78 @@ double logData::getMin()
 QVector < double > logData::getRow(int rowNum)
 {
     QVector < double > rowData;
+    this->getRow (rowNum, rowData);
+    return rowData;
+}
 
-    // is not analog return empty
-    //if (this->dataClass != ANALOGDATA)
-    //    return rowData;
+bool logData::getRow(int rowNum, QVector < double >& rowData)
+{
+    // For event logs, a row is the list of neurons which spiked in a timestep
+    if (this->dataClass == EVENTDATA) {
+        rowData.clear();
+        if (!this->setupEventIndex()) {
+            return false;
+        }
+        double desiredTimeMin = this->timeStep*rowNum-1.0-this->timeStep/2.0;
+        double desiredTimeMax = this->timeStep*rowNum+this->timeStep/2.0;
+        this->events->neuronsInWindow (desiredTimeMin, desiredTimeMax, rowData);
+        return rowData.size() > 0;
+    }
 
     // get data
     switch (dataFormat) {
     case BINARY:
     {
-        if (!calculateBinaryDataStride()) {
-            return rowData;
-        }
-
-        // stream data from file
-        QDataStream data(&logFile);
-        data.device()->seek(0);
-        // offset into file
-        data.skipRawData(binaryDataStride*rowNum);
-
-        // if we skip to the end of the file
-        if (data.atEnd()) {
-            return rowData;
+        if (this->mappedData == (uchar*)0 || rowNum < 0 || rowNum >= this->rowCount()) {
+            rowData.clear();
+            return false;
         }
 
-        // check that all are same type
-        dataType mainType;
-        mainType = columns[0].type;
+        // Strings can't be returned as doubles
         for (int i = 0; i < columns.size(); ++i) {
-            if (columns[i].type != mainType) {
-                return rowData;
+            if (columns[i].type == TYPE_STRING) {
+                rowData.clear();
+                return false;
             }
         }
 
-        switch (columns[0].type) {
-        case TYPE_DOUBLE:
-        {
-            if (allLogged) {
-                rowData.resize(columns.size());
-                data.readRawData((char *) &rowData[0], sizeof(double)*rowData.size());
-            } else {
-                QVector < double > tempDbl;
-                tempDbl.resize(columns.size());
-                data.readRawData((char *) &tempDbl[0], sizeof(double)*tempDbl.size());
-                // a good first guess
-                vector <double> temp = rowData.toStdVector();
-                temp.resize(columns.back().index+1, Q_INFINITY);
-                rowData = QVector <double>::fromStdVector(temp);
-                for (int i = 0; i < columns.size(); ++i) {
-                    if (static_cast<int>(columns[i].index) > rowData.size()) {
-                        vector <double> temp = rowData.toStdVector();
-                        temp.resize(columns[i].index+1, Q_INFINITY);
-                        rowData = QVector <double>::fromStdVector(temp);
-                    }
-                    rowData[columns[i].index] = tempDbl[i];
-                }
+        // Rows are indexed by neuron index, with Q_INFINITY for the indices
+        // which were not logged. Only resize if we must.
+        int rowLen = allLogged ? columns.size() : columns.back().index+1;
+        for (int i = 0; i < columns.size(); ++i) {
+            if (columns[i].index+1 > rowLen) {
+                rowLen = columns[i].index+1;
             }
-            return rowData;
         }
-        break;
-        case TYPE_FLOAT:
-        {
-            QVector < float > tempFloat;
-            tempFloat.resize(columns.size());
-            data.setFloatingPointPrecision(QDataStream::SinglePrecision);
-            data.readRawData((char *) &tempFloat[0], sizeof(float)*tempFloat.size());
-            // a good first guess
-            vector <double> temp = rowData.toStdVector();
-            temp.resize(columns.back().index+1, Q_INFINITY);
-            rowData = QVector <double>::fromStdVector(temp);
-            for (int i = 0; i < columns.size(); ++i) {
-                if (static_cast<int>(columns[i].index) > rowData.size()) {
-                    vector <double> temp = rowData.toStdVector();
-                    temp.resize(columns[i].index+1, Q_INFINITY);
-                    rowData = QVector <double>::fromStdVector(temp);
-                }
-                rowData[columns[i].index] = tempFloat[i];
-            }
-            return rowData;
+        if (rowData.size() != rowLen) {
+            rowData.resize(rowLen);
         }
-        break;
-        case TYPE_INT64:
-        {
-            // not supported currently
-            return rowData;
-
+        if (!allLogged) {
+            rowData.fill(Q_INFINITY);
         }
-        break;
-        case TYPE_INT32:
-        {
-            QVector < int > tempInt;
-            tempInt.resize(columns.size());
-            data.readRawData((char *) &tempInt[0], sizeof(int)*tempInt.size());
-            // a good first guess
-            vector <double> temp = rowData.toStdVector();
-            temp.resize(columns.back().index+1, Q_INFINITY);
-            rowData = QVector <double>::fromStdVector(temp);
-            for (int i = 0; i < columns.size(); ++i) {
-                if (static_cast<int>(columns[i].index) > rowData.size()) {
-                    vector <double> temp = rowData.toStdVector();
-                    temp.resize(columns[i].index+1, Q_INFINITY);
-                    rowData = QVector <double>::fromStdVector(temp);
-                }
-                rowData[columns[i].index] = tempInt[i];
-            }
-            return rowData;
-        }
-        break;
-        case TYPE_STRING:
-            return rowData;
-        } // end switch (columns[0].type)
-        break;
-    }
-    case CSVFormat:
-    case SSVFormat:
-    {
-        // read line by line
-        QTextStream data(&logFile);
-        data.device()->seek(0);
-
-        float desiredTimeMin = this->timeStep*rowNum-1.0-this->timeStep/2.0;
-        float desiredTimeMax = this->timeStep*rowNum+this->timeStep/2.0;
 
-        // read a line
-        while (!data.atEnd()) {
-
-            // get line
-            QString line = data.readLine();
-
-            // divide up
-            QStringList cols;
-            if (dataFormat == CSVFormat) {
-                line.remove(" ");
-                cols = line.split(",");
-            }
-            else if (dataFormat == SSVFormat) {
-                line = line.simplified();
-                cols = line.split(" ");
-            }
-
-            // parse
-            if (cols.size() != (int) columns.size()) {
-                qDebug() << "Col size incorrect on import";
-                rowData.clear();
-                return rowData;
-            }
-
-            // for each entry with the desired timerange, add the index to the list
-            if (cols[0].toDouble() > desiredTimeMin && cols[0].toDouble() < desiredTimeMax) {
-                rowData.push_back(cols[1].toInt());
+        // read straight from the mapping
+        const uchar* row = this->mappedData + this->dataOffset + (qint64)this->binaryDataStride * rowNum;
+        double* out = rowData.data();
+        for (int i = 0; i < columns.size(); ++i) {
+            int idx = allLogged ? i : columns[i].index;
+            switch (columns[i].type) {
+            case TYPE_DOUBLE: { double v; memcpy (&v, row, sizeof(v)); out[idx] = v; row += sizeof(v); break; }
+            case TYPE_FLOAT:  { float v;  memcpy (&v, row, sizeof(v)); out[idx] = v; row += sizeof(v); break; }
+            case TYPE_INT32:  { qint32 v; memcpy (&v, row, sizeof(v)); out[idx] = v; row += sizeof(v); break; }
+            case TYPE_INT64:  { qint64 v; memcpy (&v, row, sizeof(v)); out[idx] = v; row += sizeof(v); break; }
+            case TYPE_STRING: break;
             }
-
         }
-     }
+        return true;
+    }
     default:
-        // do nothing in these cases.
+        // text logs are read through their binary cache, so are BINARY here
         break;
     } // end switch (dataFormat)
 
-    return rowData;
+    rowData.clear();
+    return false;
 }
 
 bool logData::plotLine(QCustomPlot *plot, QMdiSubWindow* msw, int colNum, int update) {
@@ -273,100 +364,32 @@ bool logData::plotLine(QCustomPlot *plot, QMdiSubWindow* msw, int colNum, int up
 
     // clear existing data;
     colData[colNum].clear();
+    QVector < double > times;
 
     // get data
     switch (dataFormat) {
     case BINARY:
     {
-        if (!calculateBinaryDataStride()) {
-            return false;
-        }
-        int offset = calculateBinaryDataOffset(colNum);
-        if (offset == -1) {
+        if (this->getColumn(colNum).isNull()) {
             return false;
         }
 
-        // stream data from file
-        QDataStream data(&logFile);
-        data.device()->seek(0);
-        // offset into file
-        data.skipRawData(offset);
-        switch (columns[colNum].type) {
-        case TYPE_DOUBLE:
-        {
-            double tempDbl;
-            while (data.readRawData((char *) &tempDbl, sizeof(tempDbl)) != -1) {
-                // add to data
-                colData[colNum].push_back(tempDbl);
-                // skip to next row
-                data.skipRawData(binaryDataStride-sizeof(double));
-                if (data.atEnd())
-                    break;
-            }
-            break;
-        }
-        case TYPE_FLOAT:
-        {
-            float tempFloat;
-            data.setFloatingPointPrecision(QDataStream::SinglePrecision);
-            while (data.readRawData((char *) &tempFloat, sizeof(tempFloat)) != -1) {
-                // add to data
-                colData[colNum].push_back((double) tempFloat);
-                // skip to next row
-                data.skipRawData(binaryDataStride-sizeof(float));
-                if (data.atEnd())
-                    break;
-            }
-            break;
-        }
-        case TYPE_INT64:
-        {
-            // not supported currently
-                return false;
-            int tempInt;
-            while (data.readRawData((char *) &tempInt, sizeof(tempInt)) != -1) {
-                // add to data
-                colData[colNum].push_back((double) tempInt);
-                // skip to next row
-                data.skipRawData(binaryDataStride-sizeof(long int));
-                if (data.atEnd())
-                    break;
-            }
-            break;
-        }
-        case TYPE_INT32:
-        {
-            int tempInt;
-            while (data.readRawData((char *) &tempInt, sizeof(tempInt)) != -1) {
-                // add to data
-                colData[colNum].push_back((double) tempInt);
-                // skip to next row
-                data.skipRawData(binaryDataStride-sizeof(int));
-                if (data.atEnd())
-                    break;
-            }
-            break;
-        }
-        case TYPE_STRING:
-            return false;
-            break;
+        // Request about two points per horizontal pixel, over the whole log
+        // for a new graph or over the current view for an update.
+        int buckets = plot->axisRect()->width() > 0 ? plot->axisRect()->width() : 1000;
+        if (update == -1) {
+            this->decimateColumn (colNum, 0.0, this->rowCount()*timeStep, buckets, colData[colNum], times);
+        } else {
+            QCPRange r = plot->xAxis->range();
+            this->decimateColumn (colNum, r.lower-r.size(), r.upper+r.size(), 3*buckets, colData[colNum], times);
         }
-        // what about default:?
-    } // end case BINARY
-    case CSVFormat:
-    case SSVFormat:
         break;
+    } // end case BINARY
     default:
         // oops, bad dataType
         return false;
     }
 
-    //
-    QVector < double > times;
-    for (int i = 0; i < colData[colNum].size(); ++i) {
-        times.push_back(((double) i)*timeStep);
-    }
-
     if (update == -1) {
         // add graph and setup data and name
         DBG() << "plot->addGraph called";
@@ -397,6 +420,9 @@ bool logData::plotLine(QCustomPlot *plot, QMdiSubWindow* msw, int colNum, int up
         plot->graph(update)->setData(times, colData[colNum]);
     }
 
+    // Refine the decimated data whenever the time axis is zoomed or dragged
+    connect(plot->xAxis, SIGNAL(rangeChanged(QCPRange)), this, SLOT(xRangeChanged(QCPRange)), Qt::UniqueConnection);
+
     plot->legend->setVisible(false); // fixme, make this an option
 
     // title
@@ -435,149 +461,387 @@ bool logData::plotLine(QCustomPlot *plot, QMdiSubWindow* msw, int colNum, int up
     // redraw
     plot->replot();
 
-    // Ensure that when destroyed, the relevant plot will be removed. (no longer required)
-    //connect(plot, SIGNAL(destroyed()), this, SLOT(onPlotDestroyed()));
+    // Ensure that when destroyed, the relevant plot will be removed, as
+    // following the log appends to the plots in this->plots.
+    connect(plot, SIGNAL(destroyed()), this, SLOT(onPlotDestroyed()), Qt::UniqueConnection);
 
     return true;
 }
 
-bool logData::plotRaster(QCustomPlot * plot, QMdiSubWindow* msw, QList < QVariant > indices, int update) {
+void logData::decimateColumn(int colNum, double t0, double t1, int buckets,
+                             QVector < double >& values, QVector < double >& times)
+{
+    values.clear();
+    times.clear();
 
-    // if no plot give up
-    if (plot == NULL) {
-        return false;
+    logColumnView col = this->getColumn(colNum);
+    if (col.isNull() || buckets < 1 || this->timeStep <= 0.0) {
+        return;
     }
 
-    this->plots.insert (plot, msw);
+    qint64 r0 = qMax ((qint64)0, (qint64)floor(t0/this->timeStep));
+    qint64 r1 = qMin (col.size(), (qint64)ceil(t1/this->timeStep)+1);
+    if (r0 >= r1) {
+        return;
+    }
+    qint64 span = r1 - r0;
+
+    // Few enough rows to plot them all
+    if (span <= 2*(qint64)buckets) {
+        values.resize(span);
+        times.resize(span);
+        for (qint64 r = r0; r < r1; ++r) {
+            values[r-r0] = col.at(r);
+            times[r-r0] = r*this->timeStep;
+        }
+        return;
+    }
 
-    // clear existing data;
-    colData[0].clear();
-    colData[1].clear();
+    double rowsPerBucket = (double)span / (double)buckets;
+    values.reserve(2*buckets+2);
+    times.reserve(2*buckets+2);
 
-    // get data
-    for (int colNum = 0; colNum < 2; ++colNum) {
-        switch (dataFormat) {
-        case BINARY:
-        {
-            if (!calculateBinaryDataStride())
-                return false;
-            int offset = calculateBinaryDataOffset(colNum);
-            if (offset == -1)
-                return false;
-            // stream data from file
-            QDataStream data(&logFile);
-            data.device()->seek(0);
-            // offset into file
-            data.skipRawData(offset);
-            switch (columns[colNum].type) {
-            case TYPE_DOUBLE:
-            {
-                double tempDbl;
-                while (data.readRawData((char *) &tempDbl, sizeof(tempDbl)) != -1) {
-                    // add to data
-                    colData[colNum].push_back(tempDbl);
-                    // skip to next row
-                    data.skipRawData(binaryDataStride-sizeof(double));
-                    if (data.atEnd())
-                        break;
-                }
-            }
-                break;
-            case TYPE_FLOAT:
-            {
-                float tempFloat;
-                data.setFloatingPointPrecision(QDataStream::SinglePrecision);
-                while (data.readRawData((char *) &tempFloat, sizeof(tempFloat)) != -1) {
-                    // add to data
-                    colData[colNum].push_back((double) tempFloat);
-                    // skip to next row
-                    data.skipRawData(binaryDataStride-sizeof(float));
-                    if (data.atEnd())
-                        break;
-                }
-            }
-                break;
-            case TYPE_INT64:
-            {
-                // not supported currently
-                    return false;
-                int tempInt;
-                while (data.readRawData((char *) &tempInt, sizeof(tempInt)) != -1) {
-                    // add to data
-                    colData[colNum].push_back((double) tempInt);
-                    // skip to next row
-                    data.skipRawData(binaryDataStride-sizeof(long int));
-                    if (data.atEnd())
-                        break;
-                }
+    if (this->summary->isValid() && rowsPerBucket >= this->summary->levelRows(0)) {
+
+        // Coarse view; take min/max from the highest pyramid level whose
+        // nodes are no wider than one bucket.
+        int lvl = 0;
+        while (lvl+1 < this->summary->numLevels() && this->summary->levelRows(lvl+1) <= rowsPerBucket) {
+            ++lvl;
+        }
+        qint64 nodeRows = this->summary->levelRows(lvl);
+        qint64 n0 = r0 / nodeRows;
+        qint64 n1 = qMin (this->summary->levelSize(lvl), (r1 + nodeRows - 1) / nodeRows);
+        qint64 perBucket = qMax ((qint64)1, (qint64)(rowsPerBucket / nodeRows));
+
+        for (qint64 b = n0; b < n1; b += perBucket) {
+            float mn = Q_INFINITY;
+            float mx = -Q_INFINITY;
+            qint64 bEnd = qMin (b+perBucket, n1);
+            for (qint64 n = b; n < bEnd; ++n) {
+                mn = qMin (mn, this->summary->nodeMinAt(lvl, colNum, n));
+                mx = qMax (mx, this->summary->nodeMaxAt(lvl, colNum, n));
             }
-                break;
-            case TYPE_INT32:
-            {
-                int tempInt;
-                while (data.readRawData((char *) &tempInt, sizeof(tempInt)) != -1) {
-                    // add to data
-                    colData[colNum].push_back((double) tempInt);
-                    // skip to next row
-                    data.skipRawData(binaryDataStride-sizeof(int));
-                    if (data.atEnd())
-                        break;
-                }
+            if (mn > mx) {
+                // nothing finite in this bucket
+                continue;
             }
-                break;
-            case TYPE_STRING:
-                return false;
+            // Two distinct keys per bucket, so QCPDataMap keeps both points
+            double tStart = b*nodeRows*this->timeStep;
+            double tMid = (b*nodeRows + (bEnd-b)*nodeRows/2)*this->timeStep;
+            values.push_back(mn);
+            times.push_back(tStart);
+            values.push_back(mx);
+            times.push_back(tMid);
+        }
+        return;
+    }
+
+    // Fine view; scan the rows from the mapping, keeping the min and max of
+    // each bucket in the order they occurred so spikes keep their shape.
+    for (int b = 0; b < buckets; ++b) {
+        qint64 bStart = r0 + (qint64)(b*rowsPerBucket);
+        qint64 bEnd = qMin (r1, r0 + (qint64)((b+1)*rowsPerBucket));
+        qint64 rMin = -1, rMax = -1;
+        double mn = Q_INFINITY, mx = -Q_INFINITY;
+        for (qint64 r = bStart; r < bEnd; ++r) {
+            double v = col.at(r);
+            if (!qIsFinite(v)) {
+                continue;
             }
+            if (v < mn) { mn = v; rMin = r; }
+            if (v > mx) { mx = v; rMax = r; }
         }
-            break;
-        case CSVFormat:
-        case SSVFormat:
-        {
-            // read line by line
-            QTextStream data(&logFile);
-            data.device()->seek(0);
-
-            // read a line
-            while (!data.atEnd()) {
-
-                // get line
-                QString line = data.readLine();
-
-                // divide up
-                QStringList cols;
-                if (dataFormat == CSVFormat) {
-                    line.remove(" ");
-                    cols = line.split(",");
-                }
-                else if (dataFormat == SSVFormat) {
-                    line = line.simplified();
-                    cols = line.split(" ");
-                }
+        if (rMin == -1) {
+            continue;
+        }
+        qint64 first = qMin (rMin, rMax);
+        qint64 second = qMax (rMin, rMax);
+        values.push_back(col.at(first));
+        times.push_back(first*this->timeStep);
+        if (second != first) {
+            values.push_back(col.at(second));
+            times.push_back(second*this->timeStep);
+        }
+    }
+}
 
-                // parse
-                if (cols.size() != (int) columns.size()) {
-                    qDebug() << "Col size incorrect on import";
-                    return false;
-                }
+void logData::xRangeChanged(const QCPRange& range)
+{
+    QCPAxis* axis = qobject_cast<QCPAxis*>(sender());
+    if (axis == (QCPAxis*)0) {
+        return;
+    }
+    QCustomPlot* plot = axis->parentPlot();
+    if (plot == (QCustomPlot*)0) {
+        return;
+    }
 
+    // Re-decimate this log's line plots for the new range, plus a range's
+    // width either side so that dragging doesn't reveal empty plot.
+    int buckets = plot->axisRect()->width() > 0 ? plot->axisRect()->width() : 1000;
+    QVector < double > values;
+    QVector < double > times;
+    for (int j = 0; j < plot->graphCount(); ++j) {
+        QCPGraph* g = plot->graph(j);
+        if (g->property("source").toString() != this->logFileXMLname
+            || g->property("type").toString() != "linePlot") {
+            continue;
+        }
+        this->decimateColumn (g->property("index").toInt(),
+                              range.lower-range.size(), range.upper+range.size(),
+                              3*buckets, values, times);
+        g->setData(times, values);
+    }
+    // QCustomPlot replots after the drag/zoom which emitted rangeChanged
+}
+
+bool logData::setupEventIndex()
+{
+    if (this->events->isValid()) {
+        return true;
+    }
+    if (this->dataClass != EVENTDATA || this->columns.size() < 2) {
+        return false;
+    }
+
+    // One pass over the log, collecting the time and neuron index columns
+    QVector < double > t;
+    QVector < int > n;
+
+    switch (dataFormat) {
+    case BINARY:
+    {
+        logColumnView tCol = this->getColumn(0);
+        logColumnView nCol = this->getColumn(1);
+        if (tCol.isNull() || nCol.isNull()) {
+            return false;
+        }
+        t.resize(tCol.size());
+        n.resize(nCol.size());
+        for (qint64 i = 0; i < tCol.size(); ++i) {
+            t[i] = tCol.at(i);
+            n[i] = (int)nCol.at(i);
+        }
+        break;
+    }
+    default:
+        qDebug() << "Bad dataType";
+        return false;
+    }
+
+    this->events->build (t, n);
+    return this->events->isValid();
+}
+
+void logData::setFollowing(bool follow)
+{
+    if (follow == this->following) {
+        return;
+    }
+    this->following = follow;
+
+    if (follow) {
+        if (this->watcher == (QFileSystemWatcher*)0) {
+            this->watcher = new QFileSystemWatcher(this);
+            connect(this->watcher, SIGNAL(fileChanged(QString)), this, SLOT(logFileChanged(QString)));
+        }
+        this->watcher->addPath(this->logFile.fileName());
+        this->readNewRows();
+    } else {
+        if (this->watcher != (QFileSystemWatcher*)0) {
+            this->watcher->removePath(this->logFile.fileName());
+        }
+        this->followTimer.stop();
+        // pick up whatever was written since the last update
+        if (!this->textLogFileName.isEmpty()) {
+            // a text log's cache doesn't grow with it; re-parse if it changed
+            this->setupFromXML();
+        } else {
+            this->readNewRows();
+        }
+        // The log is complete, so save the summary for the next open
+        if (this->dataClass == ANALOGDATA && this->summary->isValid()) {
+            QFileInfo fi(this->logFile);
+            this->summary->save (this->summaryFileName(), this->mappedSize,
+                                 fi.lastModified().toMSecsSinceEpoch(), this->binaryDataStride);
+        }
+    }
+}
+
+void logData::logFileChanged(const QString&)
+{
+    // A simulator writes often; coalesce the writes into one update
+    if (!this->followTimer.isActive()) {
+        this->followTimer.start(LOG_FOLLOW_INTERVAL_MS);
+    }
+}
+
+bool logData::readNewRows()
+{
+    if (this->dataFormat != BINARY || !this->logFile.isOpen()) {
+        return false;
+    }
+
+    qint64 sz = this->logFile.size();
+    if (sz == this->mappedSize) {
+        return false;
+    }
+    if (sz < this->mappedSize) {
+        // The file has been rewritten (a new run); start again
+        bool ok = this->setupFromXML();
+        if (ok && this->watcher != (QFileSystemWatcher*)0 && !this->watcher->files().contains(this->logFile.fileName())) {
+            this->watcher->addPath(this->logFile.fileName());
+        }
+        return ok;
+    }
+
+    // Remapping costs nothing per byte; only the new rows are read below
+    qint64 oldRows = this->rowCount();
+    if (!this->mapLogFile()) {
+        return false;
+    }
+    qint64 newRows = this->rowCount();
+    if (newRows <= oldRows) {
+        // only a partial row so far
+        return false;
+    }
+
+    if (this->dataClass == ANALOGDATA) {
+        QVector < logColumnView > cols;
+        for (int c = 0; c < this->columns.size(); ++c) {
+            cols.push_back(this->getColumn(c));
+        }
+        this->summary->extend (cols);
+        // re-read the (cached) extrema from the summary
+        this->min = Q_INFINITY;
+        this->max = Q_INFINITY;
+    } else if (this->events->isValid()) {
+        logColumnView tCol = this->getColumn(0);
+        logColumnView nCol = this->getColumn(1);
+        QVector < double > t(newRows-oldRows);
+        QVector < int > n(newRows-oldRows);
+        for (qint64 r = oldRows; r < newRows; ++r) {
+            t[r-oldRows] = tCol.at(r);
+            n[r-oldRows] = (int)nCol.at(r);
+        }
+        this->events->append (t, n);
+    }
+
+    this->appendToPlots (oldRows, newRows);
+
+    emit rowsAppended (oldRows, newRows);
+    return true;
+}
+
+void logData::appendToPlots(qint64 oldRows, qint64 newRows)
+{
+    double oldEnd = oldRows*this->timeStep;
+    double newEnd = newRows*this->timeStep;
+    // times of the last row before, and after, the update
+    double oldLast = (oldRows-1)*this->timeStep;
+    double newLast = (newRows-1)*this->timeStep;
+
+    QList < QCustomPlot* > plotList = this->plots.keys();
+    for (int p = 0; p < plotList.size(); ++p) {
+
+        QCustomPlot* plot = plotList[p];
+        QCPRange r = plot->xAxis->range();
+        bool changed = false;
+        bool tail = false;
+
+        for (int j = 0; j < plot->graphCount(); ++j) {
+            QCPGraph* g = plot->graph(j);
+            if (g->property("source").toString() != this->logFileXMLname) {
+                continue;
+            }
+            QString type = g->property("type").toString();
+
+            if (type == "linePlot") {
+                if (r.upper >= oldLast - this->timeStep/2.0 && r.upper < newLast) {
+                    // the view is on the end of the log; scroll it below
+                    tail = true;
+                    continue;
+                }
+                // decimate the new rows to the density of the current view
+                int width = plot->axisRect()->width() > 0 ? plot->axisRect()->width() : 1000;
+                double rowsPerPixel = qMax (1.0, (r.size()/this->timeStep) / width);
+                int buckets = qMax (1, (int)((newRows-oldRows)/rowsPerPixel));
+                QVector < double > values;
+                QVector < double > times;
+                this->decimateColumn (g->property("index").toInt(), oldEnd, newEnd-this->timeStep, buckets, values, times);
+                g->addData(times, values);
+                changed = true;
+
+            } else if (type == "rasterPlot") {
+                // add only the new events of the plotted neurons
+                QList < QVariant > indices = g->property("indices").toList();
+                QSet < int > wanted;
                 for (int i = 0; i < indices.size(); ++i) {
-                    if (cols[1].toInt() == indices[i].toInt()) {
-                        colData[0].push_back(cols[0].toDouble());
-                        colData[1].push_back(cols[1].toDouble());
+                    wanted.insert(indices[i].toInt());
+                }
+                logColumnView tCol = this->getColumn(0);
+                logColumnView nCol = this->getColumn(1);
+                QVector < double > t;
+                QVector < double > n;
+                for (qint64 e = oldRows; e < newRows; ++e) {
+                    int nrn = (int)nCol.at(e);
+                    if (wanted.contains(nrn)) {
+                        t.push_back(tCol.at(e));
+                        n.push_back((double)nrn);
                     }
                 }
-
+                g->addData(t, n);
+                changed = true;
             }
         }
 
-            break;
-        default:
-            // oops, bad dataType
-            qDebug() << "Bad dataType";
-            return false;
+        if (tail) {
+            // Scroll with the log; xRangeChanged re-decimates the lines for the
+            // new view, from the summary, so the cost doesn't grow with the log
+            plot->xAxis->setRange(newLast - r.size(), newLast);
+            changed = true;
+        }
+        if (changed) {
+            plot->replot();
+        }
+    }
+}
 
+void logData::onPlotDestroyed()
+{
+    QObject* s = sender();
+    QList < QCustomPlot* > plotList = this->plots.keys();
+    for (int p = 0; p < plotList.size(); ++p) {
+        if ((QObject*)plotList[p] == s) {
+            this->plots.remove(plotList[p]);
         }
     }
+}
+
+bool logData::plotRaster(QCustomPlot * plot, QMdiSubWindow* msw, QList < QVariant > indices, int update) {
+
+    // if no plot give up
+    if (plot == NULL) {
+        return false;
+    }
+
+    this->plots.insert (plot, msw);
+
+    // clear existing data;
+    colData[0].clear();
+    colData[1].clear();
+
+    // get data, from the event index
+    if (!this->setupEventIndex()) {
+        return false;
+    }
+    QVector < int > nrns;
+    nrns.reserve(indices.size());
+    for (int i = 0; i < indices.size(); ++i) {
+        nrns.push_back(indices[i].toInt());
+    }
+    this->events->eventsForNeurons (nrns, colData[0], colData[1]);
 
     if (colData.size() != 2 && colData.size() != 3) {
         qDebug() << "Not 2 cols (spike log) or 3 cols (impulse log)";
@@ -630,7 +894,7 @@ bool logData::plotRaster(QCustomPlot * plot, QMdiSubWindow* msw, QList < QVarian
     // redraw
     plot->replot();
 
-    connect(plot, SIGNAL(destroyed()), this, SLOT(onPlotDestroyed()));
+    connect(plot, SIGNAL(destroyed()), this, SLOT(onPlotDestroyed()), Qt::UniqueConnection);
 
     return true;
 }
@@ -648,7 +912,7 @@ bool logData::calculateBinaryDataStride()
             binaryDataStride += sizeof(float);
             break;
         case TYPE_INT64:
-            binaryDataStride += sizeof(long int);
+            binaryDataStride += sizeof(qint64);
             break;
         case TYPE_INT32:
             binaryDataStride += sizeof(int);
@@ -674,7 +938,7 @@ int logData::calculateBinaryDataOffset(int colNum) {
             tempInt += sizeof(float);
             break;
         case TYPE_INT64:
-            tempInt += sizeof(long int);
+            tempInt += sizeof(qint64);
             break;
         case TYPE_INT32:
             tempInt += sizeof(int);
@@ -1080,13 +1344,36 @@ bool logData::setupFromXML() {
 #endif
     QDir localDir(dirPath);
 
-    if (!logFile.isOpen()) {
-        logFile.setFileName(localDir.absoluteFilePath(logFileName));
-        if( !logFile.open( QIODevice::ReadOnly ) ) {
-            // could not open
-            qDebug() << "Couldn't open log file " << localDir.absoluteFilePath(logFileName);
+    // Always re-open; the simulator may have replaced the file since we last
+    // mapped it, and an old mapping of a truncated file is not safe to read.
+    this->unmapLogFile();
+    *this->summary = logSummaryIndex();
+    this->events->clear();
+    this->dataOffset = 0;
+    this->textLogFileName.clear();
+    if (logFile.isOpen()) {
+        logFile.close();
+    }
+    logFile.setFileName(localDir.absoluteFilePath(logFileName));
+    if( !logFile.open( QIODevice::ReadOnly ) ) {
+        // could not open
+        qDebug() << "Couldn't open log file " << localDir.absoluteFilePath(logFileName);
+        delete reader;
+        return false;}
+
+    if (dataFormat == CSVFormat || dataFormat == SSVFormat) {
+        if (!this->setupTextLog()) {
             delete reader;
-            return false;}
+            return false;
+        }
+    }
+
+    if (dataFormat == BINARY) {
+        if (!this->mapLogFile()) {
+            DBG() << "Binary log" << logFile.fileName() << "could not be mapped (empty?)";
+        } else {
+            this->setupSummary();
+        }
     }
 
     // resize data carriers
@@ -27,9 +27,17 @@
 
 #include <QObject>
 #include <QMdiArea>
+#include <QFileSystemWatcher>
+#include <cstring>
 #include "qcustomplot.h"
 #include "globalHeader.h"
 
+/*!
+ * How long to wait after the log file changes before reading the new rows,
+ * when following a log. Writes which arrive in the meantime are coalesced.
+ */
+#define LOG_FOLLOW_INTERVAL_MS 200
+
 enum fileFormat
 {
     BINARY,
@@ -60,6 +68,73 @@ struct column
     dataType type;
 };
 
+/*!
+ * \brief A typed, strided view onto one column of a memory mapped binary log.
+ *
+ * The view does not own the data; it points straight into the mapping held by
+ * the logData which created it, so it is only valid until that logData is
+ * remapped (setupFromXML) or destroyed. No copies are made - at() reads the
+ * value for a row directly from the mapped file.
+ */
+template <typename T>
+class logStridedView
+{
+public:
+    logStridedView() : base(0), stride(0), rows(0) {}
+    logStridedView(const uchar* b, int s, qint64 r) : base(b), stride(s), rows(r) {}
+
+    inline T at (qint64 row) const {
+        T val;
+        // memcpy, as the data are packed and may not be aligned for T
+        memcpy (&val, base + row*stride, sizeof(T));
+        return val;
+    }
+    inline T operator[] (qint64 row) const { return this->at(row); }
+    inline qint64 size (void) const { return this->rows; }
+    inline bool isNull (void) const { return this->base == 0; }
+
+private:
+    const uchar* base;
+    int stride;
+    qint64 rows;
+};
+
+/*!
+ * \brief A column view which hides the stored type of the column, returning
+ * every value as a double. Used by the plotting code, which works in doubles.
+ */
+class logColumnView
+{
+public:
+    logColumnView() : base(0), stride(0), rows(0), type(TYPE_STRING) {}
+    logColumnView(const uchar* b, int s, qint64 r, dataType t) : base(b), stride(s), rows(r), type(t) {}
+
+    inline double at (qint64 row) const {
+        const uchar* p = base + row*stride;
+        switch (type) {
+        case TYPE_DOUBLE: { double v; memcpy (&v, p, sizeof(v)); return v; }
+        case TYPE_FLOAT:  { float v;  memcpy (&v, p, sizeof(v)); return (double)v; }
+        case TYPE_INT32:  { qint32 v; memcpy (&v, p, sizeof(v)); return (double)v; }
+        case TYPE_INT64:  { qint64 v; memcpy (&v, p, sizeof(v)); return (double)v; }
+        default: return Q_INFINITY;
+        }
+    }
+    inline double operator[] (qint64 row) const { return this->at(row); }
+    inline qint64 size (void) const { return this->rows; }
+    inline bool isNull (void) const { return this->base == 0; }
+
+    template <typename T> logStridedView<T> typed (void) const { return logStridedView<T>(base, stride, rows); }
+
+private:
+    const uchar* base;
+    int stride;
+    qint64 rows;
+    dataType type;
+};
+
+class logSummaryIndex;
+class logEventIndex;
+
 /*!
  * \brief The logData class provides an interface to logged data from simulations stored on disk
  */
@@ -68,6 +143,7 @@ class logData : public QObject
     Q_OBJECT
 public:
     explicit logData(QObject *parent = 0);
+    ~logData();
 
     /*!
      * A map of the plots associated with this logData object, and the QMdiSubWindows as well.
@@ -104,6 +180,45 @@ public: // but really private 2.
     bool allLogged;
     double min;
     double max;
+    /*!
+     * The binary log file, memory mapped by mapLogFile(). Null when the log is
+     * not binary, or the mapping failed.
+     */
+    uchar* mappedData;
+    qint64 mappedSize;
+    /*!
+     * Offset of the first row in the mapped file; non-zero for the binary
+     * cache of a text log, which starts with a header.
+     */
+    qint64 dataOffset;
+    /*!
+     * For a CSV or SSV log, the text log itself. logFile is then its binary
+     * cache (see logTextLoader) and dataFormat is BINARY.
+     */
+    QString textLogFileName;
+    /*!
+     * A re-usable row buffer to pass to getRow(int, QVector&), so that callers
+     * reading row after row (the 3D visualiser) don't allocate per call.
+     * getRow(int) still returns a new vector.
+     */
+    QVector < double > rowBuffer;
+    /*!
+     * Per column and per chunk min/max/mean of an analog binary log. Loaded
+     * from, or built and saved to, summaryFileName().
+     */
+    logSummaryIndex* summary;
+    /*!
+     * Time and neuron ordered index of the events in an event log. Built on
+     * first use by setupEventIndex().
+     */
+    logEventIndex* events;
+    /*!
+     * Follow mode; when true, watch the log file as the simulator writes it,
+     * and append new rows to the plots as they arrive.
+     */
+    bool following;
+    QFileSystemWatcher* watcher;
+    QTimer followTimer;
 
 public:
     /*!
@@ -113,13 +228,98 @@ public:
     bool setupFromXML();
     double getMax();
     double getMin();
+    /*!
+     * Find the extrema and mean of column colNum over rows [row0, row1), using
+     * the summary index. Returns false if there is no summary, or the window is
+     * empty.
+     */
+    bool getWindowStats(int colNum, qint64 row0, qint64 row1, double& mn, double& mx, double& mean);
+    /*!
+     * The summary index file, which lives next to the log's XML file.
+     */
+    QString summaryFileName();
+    /*!
+     * For analog logs, get the values of each index at timestep rowNum. For
+     * event logs, get the indices which spiked at that timestep.
+     */
     QVector < double > getRow(int rowNum);
+    /*!
+     * Fill rowData with row rowNum. rowData is only reallocated if it is the
+     * wrong size, so callers may keep one vector and pass it in repeatedly.
+     * Returns false (and clears rowData) if there is no such row.
+     */
+    bool getRow(int rowNum, QVector < double >& rowData);
+    /*!
+     * The number of complete rows in a binary log.
+     */
+    qint64 rowCount();
+    /*!
+     * Get a zero-copy view onto column colNum of a binary log. Returns a null
+     * view if the log is not binary, or colNum is out of range.
+     */
+    logColumnView getColumn(int colNum);
     bool plotLine(QCustomPlot* plot, QMdiSubWindow* msw, int colNum, int update = -1);
+    /*!
+     * Decimate column colNum over the times [t0, t1] to at most two points
+     * (the min and the max) per bucket, for plotting. Coarse views come from
+     * the summary index pyramid, fine views from the mapped log, so the cost
+     * scales with buckets rather than with the length of the log.
+     */
+    void decimateColumn(int colNum, double t0, double t1, int buckets,
+                        QVector < double >& values, QVector < double >& times);
     bool plotRaster(QCustomPlot* plot, QMdiSubWindow* msw, QList < QVariant > indices, int update = -1);
     bool calculateBinaryDataStride();
     int calculateBinaryDataOffset(int);
+    /*!
+     * Turn follow mode on or off. Turning it off reads any remaining rows and
+     * saves the summary index, as the log is then complete.
+     */
+    void setFollowing(bool follow);
+    bool isFollowing (void) { return this->following; }
+    /*!
+     * (Re)map the binary log file into memory. Called from setupFromXML.
+     */
+    bool mapLogFile();
+    void unmapLogFile();
+    /*!
+     * Load the summary index for the mapped log, or build and save it if there
+     * isn't an up to date one on disk.
+     */
+    bool setupSummary();
+    /*!
+     * Parse a CSV or SSV log into its binary cache (or find an up to date
+     * cache), and switch logFile over to the cache. Called from setupFromXML.
+     */
+    bool setupTextLog();
+    /*!
+     * Build the event index, if it isn't already built.
+     */
+    bool setupEventIndex();
+    /*!
+     * Add rows [oldRows, newRows) to the plots of this log.
+     */
+    void appendToPlots(qint64 oldRows, qint64 newRows);
 
 public slots:
+    /*!
+     * Connected to the x axis of each plot holding a line from this log, to
+     * refine the decimated data on zoom and drag.
+     */
+    void xRangeChanged(const QCPRange& range);
+    /*!
+     * In follow mode, map any rows written since the last call, extend the
+     * summary and event indices with them, and append them to the plots.
+     * Returns true if there were new rows.
+     */
+    bool readNewRows();
+    void logFileChanged(const QString&);
+    void onPlotDestroyed();
+
+signals:
+    /*!
+     * Emitted in follow mode, when rows [firstRow, endRow) have been added.
+     */
+    void rowsAppended(qint64 firstRow, qint64 endRow);
 };
 
 #endif // LOGDATA_H
@@ -0,0 +1,167 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "SC_logged_data_events.h"
+#include <algorithm>
+
+// Orders indices into a vector of event times
+struct eventTimeOrder
+{
+    eventTimeOrder(const QVector<double>& t) : t(t) {}
+    bool operator() (int a, int b) const { return t[a] < t[b]; }
+    const QVector<double>& t;
+};
+
+logEventIndex::logEventIndex()
+{
+    this->valid = false;
+    this->nrnStale = false;
+}
+
+void logEventIndex::clear (void)
+{
+    this->valid = false;
+    this->times.clear();
+    this->neurons.clear();
+    this->nrnStart.clear();
+    this->nrnTimes.clear();
+    this->nrnStale = false;
+}
+
+void logEventIndex::build (const QVector<double>& t, const QVector<int>& n)
+{
+    this->clear();
+    if (t.size() != n.size()) {
+        return;
+    }
+
+    // Simulators write events in time order, so usually there's nothing to
+    // sort. Check, and only sort (stably) if we must.
+    bool sorted = true;
+    for (int i = 1; i < t.size() && sorted; ++i) {
+        if (t[i] < t[i-1]) {
+            sorted = false;
+        }
+    }
+
+    if (sorted) {
+        this->times = t;
+        this->neurons = n;
+    } else {
+        QVector < int > order(t.size());
+        for (int i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+        std::stable_sort (order.begin(), order.end(), eventTimeOrder(t));
+        this->times.resize(t.size());
+        this->neurons.resize(t.size());
+        for (int i = 0; i < order.size(); ++i) {
+            this->times[i] = t[order[i]];
+            this->neurons[i] = n[order[i]];
+        }
+    }
+
+    this->buildNeuronTable();
+    this->valid = true;
+}
+
+void logEventIndex::buildNeuronTable (void)
+{
+    // Counting sort into per-neuron groups; keeps time order within each neuron
+    int maxNrn = -1;
+    for (int i = 0; i < this->neurons.size(); ++i) {
+        if (this->neurons[i] > maxNrn) {
+            maxNrn = this->neurons[i];
+        }
+    }
+    this->nrnStart.fill (0, maxNrn+2);
+    for (int i = 0; i < this->neurons.size(); ++i) {
+        if (this->neurons[i] >= 0) {
+            ++this->nrnStart[this->neurons[i]+1];
+        }
+    }
+    for (int i = 1; i < this->nrnStart.size(); ++i) {
+        this->nrnStart[i] += this->nrnStart[i-1];
+    }
+    this->nrnTimes.resize(this->nrnStart.size() > 0 ? this->nrnStart.back() : 0);
+    QVector < int > fill = this->nrnStart;
+    for (int i = 0; i < this->neurons.size(); ++i) {
+        if (this->neurons[i] >= 0) {
+            this->nrnTimes[fill[this->neurons[i]]++] = this->times[i];
+        }
+    }
+
+    this->nrnStale = false;
+}
+
+void logEventIndex::append (const QVector<double>& t, const QVector<int>& n)
+{
+    if (!this->valid || t.size() != n.size() || t.size() == 0) {
+        return;
+    }
+    bool sorted = this->times.size() == 0 || t[0] >= this->times.back();
+    for (int i = 1; i < t.size() && sorted; ++i) {
+        if (t[i] < t[i-1]) {
+            sorted = false;
+        }
+    }
+    if (!sorted) {
+        // out of order; rebuild the lot
+        QVector < double > allT = this->times + t;
+        QVector < int > allN = this->neurons + n;
+        this->build (allT, allN);
+        return;
+    }
+    this->times += t;
+    this->neurons += n;
+    this->nrnStale = true;
+}
+
+void logEventIndex::eventsForNeurons (const QVector<int>& nrns, QVector<double>& t, QVector<double>& n)
+{
+    if (this->nrnStale) {
+        this->buildNeuronTable();
+    }
+    int numNeurons = this->nrnStart.size() > 0 ? this->nrnStart.size()-1 : 0;
+    for (int i = 0; i < nrns.size(); ++i) {
+        int nrn = nrns[i];
+        if (nrn < 0 || nrn >= numNeurons) {
+            continue;
+        }
+        for (int e = this->nrnStart[nrn]; e < this->nrnStart[nrn+1]; ++e) {
+            t.push_back(this->nrnTimes[e]);
+            n.push_back((double)nrn);
+        }
+    }
+}
+
+void logEventIndex::neuronsInWindow (double t0, double t1, QVector<double>& nrns) const
+{
+    // open interval (t0, t1), as the original getRow search used
+    QVector<double>::const_iterator first = std::upper_bound (this->times.begin(), this->times.end(), t0);
+    QVector<double>::const_iterator last = std::lower_bound (first, this->times.end(), t1);
+    for (QVector<double>::const_iterator it = first; it != last; ++it) {
+        nrns.push_back((double)this->neurons[it - this->times.begin()]);
+    }
+}
@@ -0,0 +1,88 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef LOGEVENTINDEX_H
+#define LOGEVENTINDEX_H
+
+#include "SC_logged_data.h"
+
+/*!
+ * \brief An in-memory index over the events in a spike (event) log.
+ *
+ * Built in one pass over the log. Holds every event sorted by time, and the
+ * same events grouped by neuron (compressed row form: the events of neuron n
+ * are nrnTimes[nrnStart[n]] to nrnTimes[nrnStart[n+1]-1], in time order).
+ * Queries then cost O(log n) plus the size of their output.
+ */
+class logEventIndex
+{
+public:
+    logEventIndex();
+
+    /*!
+     * Build from parallel arrays of event times and neuron indices, in the
+     * order they appear in the log.
+     */
+    void build (const QVector<double>& times, const QVector<int>& neurons);
+    void clear (void);
+
+    /*!
+     * Add events which were written to the log after the index was built
+     * (follow mode). The time ordered arrays are appended to; the per-neuron
+     * table is rebuilt the next time it is needed.
+     */
+    void append (const QVector<double>& times, const QVector<int>& neurons);
+
+    bool isValid (void) const { return this->valid; }
+    qint64 numEvents (void) const { return this->times.size(); }
+
+    /*!
+     * Append the events of each neuron in nrns to t (times) and n (neuron
+     * indices, as doubles, ready for QCustomPlot).
+     */
+    void eventsForNeurons (const QVector<int>& nrns, QVector<double>& t, QVector<double>& n);
+
+    /*!
+     * Append the index of each neuron which spiked in the window (t0, t1) to
+     * nrns. A neuron which spiked more than once appears more than once.
+     */
+    void neuronsInWindow (double t0, double t1, QVector<double>& nrns) const;
+
+private:
+    bool valid;
+
+    // all events, sorted by time
+    QVector < double > times;
+    QVector < int > neurons;
+
+    // events grouped by neuron
+    QVector < int > nrnStart;
+    QVector < double > nrnTimes;
+    // true when events have been appended since nrnStart/nrnTimes were built
+    bool nrnStale;
+
+    void buildNeuronTable (void);
+};
+
+#endif // LOGEVENTINDEX_H
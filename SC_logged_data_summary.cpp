@@ -0,0 +1,384 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "SC_logged_data_summary.h"
+
+// Identifies a summary file, and its layout version
+#define SUMMARY_MAGIC   0x53434c53 // "SCLS"
+#define SUMMARY_VERSION 2
+
+const qint64 logSummaryIndex::chunkRows;
+
+logSummaryIndex::logSummaryIndex()
+{
+    this->valid = false;
+    this->rows = 0;
+}
+
+qint64 logSummaryIndex::levelSize (int lvl) const
+{
+    qint64 span = this->levelRows(lvl);
+    return (this->rows + span - 1) / span;
+}
+
+double logSummaryIndex::getMin (void) const
+{
+    double m = Q_INFINITY;
+    for (int c = 0; c < this->colMin.size(); ++c) {
+        if (this->colMin[c] < m) {
+            m = this->colMin[c];
+        }
+    }
+    return m;
+}
+
+double logSummaryIndex::getMax (void) const
+{
+    double m = -Q_INFINITY;
+    for (int c = 0; c < this->colMax.size(); ++c) {
+        if (this->colMax[c] > m) {
+            m = this->colMax[c];
+        }
+    }
+    return m;
+}
+
+void logSummaryIndex::reset (int nc)
+{
+    this->valid = false;
+    this->rows = 0;
+    this->nodeMin.clear();
+    this->nodeMax.clear();
+    this->nodeMean.clear();
+    this->colMin.fill (Q_INFINITY, nc);
+    this->colMax.fill (-Q_INFINITY, nc);
+    this->colMean.fill (qQNaN(), nc);
+    this->colSum.fill (0.0, nc);
+    this->colCount.fill (0, nc);
+}
+
+void logSummaryIndex::build (const QVector<logColumnView>& cols)
+{
+    this->reset (cols.size());
+    this->extend (cols);
+}
+
+void logSummaryIndex::extend (const QVector<logColumnView>& cols)
+{
+    int nc = cols.size();
+    if (nc == 0) {
+        return;
+    }
+    if (nc != this->numCols()) {
+        this->reset (nc);
+    }
+
+    qint64 oldRows = this->rows;
+    qint64 newRows = cols[0].size();
+    if (newRows <= oldRows) {
+        this->valid = newRows > 0;
+        return;
+    }
+
+    // Global statistics; new rows only
+    for (qint64 r = oldRows; r < newRows; ++r) {
+        for (int c = 0; c < nc; ++c) {
+            double v = cols[c].at(r);
+            if (!qIsFinite(v)) {
+                continue;
+            }
+            if (v < this->colMin[c]) { this->colMin[c] = v; }
+            if (v > this->colMax[c]) { this->colMax[c] = v; }
+            this->colSum[c] += v;
+            ++this->colCount[c];
+        }
+    }
+    for (int c = 0; c < nc; ++c) {
+        this->colMean[c] = this->colCount[c] > 0 ? this->colSum[c]/this->colCount[c] : qQNaN();
+    }
+
+    this->rows = newRows;
+
+    // Level 0; recompute from the chunk which held the old last row, as it
+    // may have been partial, to the end.
+    qint64 firstChunk = oldRows / chunkRows;
+    qint64 nChunks = this->levelSize(0);
+    if (this->nodeMin.size() == 0) {
+        this->nodeMin.resize(1);
+        this->nodeMax.resize(1);
+        this->nodeMean.resize(1);
+    }
+    this->nodeMin[0].resize(nc*nChunks);
+    this->nodeMax[0].resize(nc*nChunks);
+    this->nodeMean[0].resize(nc*nChunks);
+
+    // accumulators for the current chunk
+    QVector < double > cMin(nc), cMax(nc), cSum(nc);
+    QVector < qint64 > cCount(nc);
+
+    // Row by row, so that we walk the mapped file in order
+    for (qint64 ch = firstChunk; ch < nChunks; ++ch) {
+        cMin.fill (Q_INFINITY);
+        cMax.fill (-Q_INFINITY);
+        cSum.fill (0.0);
+        cCount.fill (0);
+
+        qint64 rEnd = qMin ((ch+1)*chunkRows, this->rows);
+        for (qint64 r = ch*chunkRows; r < rEnd; ++r) {
+            for (int c = 0; c < nc; ++c) {
+                double v = cols[c].at(r);
+                if (!qIsFinite(v)) {
+                    continue;
+                }
+                if (v < cMin[c]) { cMin[c] = v; }
+                if (v > cMax[c]) { cMax[c] = v; }
+                cSum[c] += v;
+                ++cCount[c];
+            }
+        }
+
+        for (int c = 0; c < nc; ++c) {
+            qint64 i = ch*nc+c;
+            this->nodeMin[0][i] = (float)cMin[c];
+            this->nodeMax[0][i] = (float)cMax[c];
+            this->nodeMean[0][i] = cCount[c] > 0 ? (float)(cSum[c]/cCount[c]) : (float)qQNaN();
+        }
+    }
+
+    // Higher levels; only the parents of changed nodes are recomputed
+    qint64 first = firstChunk;
+    int lvl = 0;
+    while (this->levelSize(lvl) > 1) {
+        qint64 lsz = this->levelSize(lvl);
+        qint64 psz = this->levelSize(lvl+1);
+        if (this->nodeMin.size() < lvl+2) {
+            this->nodeMin.resize(lvl+2);
+            this->nodeMax.resize(lvl+2);
+            this->nodeMean.resize(lvl+2);
+        }
+        QVector < float >& cMinL = this->nodeMin[lvl];
+        QVector < float >& cMaxL = this->nodeMax[lvl];
+        QVector < float >& cMeanL = this->nodeMean[lvl];
+        QVector < float >& pMin = this->nodeMin[lvl+1];
+        QVector < float >& pMax = this->nodeMax[lvl+1];
+        QVector < float >& pMean = this->nodeMean[lvl+1];
+        pMin.resize(nc*psz);
+        pMax.resize(nc*psz);
+        pMean.resize(nc*psz);
+
+        for (qint64 p = first/2; p < psz; ++p) {
+            for (int c = 0; c < nc; ++c) {
+                qint64 a = (2*p)*nc + c;
+                float mn = cMinL[a];
+                float mx = cMaxL[a];
+                float mean = cMeanL[a];
+                if (2*p+1 < lsz) {
+                    // Weight the means by the rows each child covers; only the
+                    // last node of a level can be short.
+                    qint64 b = a + nc;
+                    qint64 wa = this->levelRows(lvl);
+                    qint64 wb = qMin (this->levelRows(lvl), this->rows - (2*p+1)*this->levelRows(lvl));
+                    float mb = cMeanL[b];
+                    mn = qMin (mn, cMinL[b]);
+                    mx = qMax (mx, cMaxL[b]);
+                    if (qIsNaN(mean)) {
+                        mean = mb;
+                    } else if (!qIsNaN(mb)) {
+                        mean = (float)((mean*(double)wa + mb*(double)wb) / (double)(wa+wb));
+                    }
+                }
+                pMin[p*nc+c] = mn;
+                pMax[p*nc+c] = mx;
+                pMean[p*nc+c] = mean;
+            }
+        }
+        first /= 2;
+        ++lvl;
+    }
+
+    this->valid = true;
+}
+
+bool logSummaryIndex::getWindow (int col, qint64 row0, qint64 row1, const logColumnView& raw,
+                                 double& mn, double& mx, double& mean) const
+{
+    if (!this->valid || col < 0 || col >= this->numCols()) {
+        return false;
+    }
+    row0 = qMax (row0, (qint64)0);
+    row1 = qMin (row1, this->rows);
+    if (row0 >= row1) {
+        return false;
+    }
+
+    mn = Q_INFINITY;
+    mx = -Q_INFINITY;
+    double sum = 0.0;
+    double weight = 0.0;
+
+    // first whole chunk, and one past the last whole chunk
+    qint64 c0 = (row0 + chunkRows - 1) / chunkRows;
+    qint64 c1 = row1 / chunkRows;
+    if (row1 == this->rows) {
+        // the last chunk may be short, but it is whole
+        c1 = this->levelSize(0);
+    }
+
+    // Ragged ends, read straight from the log. At most 2*chunkRows values.
+    qint64 headEnd = c0 < c1 ? qMin (c0*chunkRows, row1) : row1;
+    qint64 tailStart = c0 < c1 ? qMax (c1*chunkRows, headEnd) : row1;
+    for (qint64 r = row0; r < headEnd; ++r) {
+        double v = raw.at(r);
+        if (!qIsFinite(v)) { continue; }
+        mn = qMin (mn, v); mx = qMax (mx, v); sum += v; weight += 1.0;
+    }
+    for (qint64 r = tailStart; r < row1; ++r) {
+        double v = raw.at(r);
+        if (!qIsFinite(v)) { continue; }
+        mn = qMin (mn, v); mx = qMax (mx, v); sum += v; weight += 1.0;
+    }
+
+    // Whole chunks, bottom up through the levels
+    int lvl = 0;
+    while (c0 < c1 && lvl < this->numLevels()) {
+        if (c0 & 1) {
+            qint64 w = qMin (this->levelRows(lvl), this->rows - c0*this->levelRows(lvl));
+            float m = this->nodeMeanAt(lvl, col, c0);
+            mn = qMin (mn, (double)this->nodeMinAt(lvl, col, c0));
+            mx = qMax (mx, (double)this->nodeMaxAt(lvl, col, c0));
+            if (!qIsNaN(m)) { sum += m*(double)w; weight += (double)w; }
+            ++c0;
+        }
+        if (c1 & 1) {
+            --c1;
+            qint64 w = qMin (this->levelRows(lvl), this->rows - c1*this->levelRows(lvl));
+            float m = this->nodeMeanAt(lvl, col, c1);
+            mn = qMin (mn, (double)this->nodeMinAt(lvl, col, c1));
+            mx = qMax (mx, (double)this->nodeMaxAt(lvl, col, c1));
+            if (!qIsNaN(m)) { sum += m*(double)w; weight += (double)w; }
+        }
+        c0 >>= 1;
+        c1 >>= 1;
+        ++lvl;
+    }
+
+    mean = weight > 0.0 ? sum/weight : qQNaN();
+    return true;
+}
+
+bool logSummaryIndex::save (const QString& fileName, qint64 logSize, qint64 logMTime, int stride)
+{
+    if (!this->valid) {
+        return false;
+    }
+
+    QFile f(fileName);
+    if (!f.open (QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "Couldn't write log summary" << fileName;
+        return false;
+    }
+
+    // native byte order; the summary is a cache, never shared between machines
+    quint32 header[4] = { SUMMARY_MAGIC, SUMMARY_VERSION, (quint32)stride, (quint32)this->colMin.size() };
+    qint64 header64[4] = { logSize, logMTime, this->rows, (qint64)this->nodeMin.size() };
+    f.write ((const char*)header, sizeof(header));
+    f.write ((const char*)header64, sizeof(header64));
+
+    f.write ((const char*)this->colMin.constData(), this->colMin.size()*sizeof(double));
+    f.write ((const char*)this->colMax.constData(), this->colMax.size()*sizeof(double));
+    f.write ((const char*)this->colMean.constData(), this->colMean.size()*sizeof(double));
+    f.write ((const char*)this->colSum.constData(), this->colSum.size()*sizeof(double));
+    f.write ((const char*)this->colCount.constData(), this->colCount.size()*sizeof(qint64));
+    for (int l = 0; l < this->nodeMin.size(); ++l) {
+        f.write ((const char*)this->nodeMin[l].constData(), this->nodeMin[l].size()*sizeof(float));
+        f.write ((const char*)this->nodeMax[l].constData(), this->nodeMax[l].size()*sizeof(float));
+        f.write ((const char*)this->nodeMean[l].constData(), this->nodeMean[l].size()*sizeof(float));
+    }
+
+    f.close();
+    return f.error() == QFile::NoError;
+}
+
+bool logSummaryIndex::load (const QString& fileName, qint64 logSize, qint64 logMTime, int stride, int numCols)
+{
+    this->valid = false;
+
+    QFile f(fileName);
+    if (!f.open (QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    quint32 header[4];
+    qint64 header64[4];
+    if (f.read ((char*)header, sizeof(header)) != sizeof(header)
+        || f.read ((char*)header64, sizeof(header64)) != sizeof(header64)) {
+        return false;
+    }
+    if (header[0] != SUMMARY_MAGIC || header[1] != SUMMARY_VERSION
+        || header[2] != (quint32)stride || header[3] != (quint32)numCols
+        || header64[0] != logSize || header64[1] != logMTime) {
+        // stale, or not ours
+        return false;
+    }
+
+    this->rows = header64[2];
+    int nLevels = (int)header64[3];
+
+    this->colMin.resize(numCols);
+    this->colMax.resize(numCols);
+    this->colMean.resize(numCols);
+    this->colSum.resize(numCols);
+    this->colCount.resize(numCols);
+    qint64 colBytes = numCols*sizeof(double);
+    qint64 countBytes = numCols*sizeof(qint64);
+    if (f.read ((char*)this->colMin.data(), colBytes) != colBytes
+        || f.read ((char*)this->colMax.data(), colBytes) != colBytes
+        || f.read ((char*)this->colMean.data(), colBytes) != colBytes
+        || f.read ((char*)this->colSum.data(), colBytes) != colBytes
+        || f.read ((char*)this->colCount.data(), countBytes) != countBytes) {
+        return false;
+    }
+
+    this->nodeMin.resize(nLevels);
+    this->nodeMax.resize(nLevels);
+    this->nodeMean.resize(nLevels);
+    for (int l = 0; l < nLevels; ++l) {
+        qint64 n = numCols*this->levelSize(l);
+        qint64 bytes = n*sizeof(float);
+        this->nodeMin[l].resize(n);
+        this->nodeMax[l].resize(n);
+        this->nodeMean[l].resize(n);
+        if (f.read ((char*)this->nodeMin[l].data(), bytes) != bytes
+            || f.read ((char*)this->nodeMax[l].data(), bytes) != bytes
+            || f.read ((char*)this->nodeMean[l].data(), bytes) != bytes) {
+            this->nodeMin.clear();
+            this->nodeMax.clear();
+            this->nodeMean.clear();
+            return false;
+        }
+    }
+
+    this->valid = true;
+    return true;
+}
@@ -0,0 +1,134 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef LOGSUMMARYINDEX_H
+#define LOGSUMMARYINDEX_H
+
+#include "SC_logged_data.h"
+
+/*!
+ * \brief A min/max/mean summary of an analog binary log.
+ *
+ * The log's rows are divided into chunks of chunkRows rows. Level 0 of the
+ * index holds the min, max and mean of each column over each chunk; each
+ * higher level holds the same statistics over pairs of nodes from the level
+ * below, so that the extrema over any window of rows can be found by visiting
+ * O(log n) nodes. Global per-column statistics are held separately.
+ *
+ * The index is built in a single streaming pass over the mapped log, and saved
+ * next to the log's XML file so that later opens of the same log skip the pass.
+ * Non-finite values (the Q_INFINITY padding for unlogged indices) are ignored.
+ */
+class logSummaryIndex
+{
+public:
+    logSummaryIndex();
+
+    /*!
+     * Number of rows summarised by each node at level 0.
+     */
+    static const qint64 chunkRows = 256;
+
+    /*!
+     * Build the index from the columns of a mapped log. cols must all be views
+     * onto the same mapping, and all must have the same number of rows.
+     */
+    void build (const QVector<logColumnView>& cols);
+
+    /*!
+     * Bring the index up to date with a log which has grown since the index
+     * was built. Only the new rows (and the old, partial, last chunk) are read,
+     * and only the nodes above them are recomputed.
+     */
+    void extend (const QVector<logColumnView>& cols);
+
+    /*!
+     * Load a previously saved index. Returns false if the file is missing or
+     * was built from a log of a different size, age or shape.
+     */
+    bool load (const QString& fileName, qint64 logSize, qint64 logMTime, int stride, int numCols);
+    bool save (const QString& fileName, qint64 logSize, qint64 logMTime, int stride);
+
+    bool isValid (void) const { return this->valid; }
+    int numCols (void) const { return this->colMin.size(); }
+    qint64 numRows (void) const { return this->rows; }
+    int numLevels (void) const { return this->nodeMin.size(); }
+    /*!
+     * The number of nodes at level lvl.
+     */
+    qint64 levelSize (int lvl) const;
+    /*!
+     * The number of log rows summarised by one node at level lvl.
+     */
+    qint64 levelRows (int lvl) const { return chunkRows << lvl; }
+
+    //! Global statistics for one column
+    //@{
+    double getMin (int col) const { return this->colMin[col]; }
+    double getMax (int col) const { return this->colMax[col]; }
+    double getMean (int col) const { return this->colMean[col]; }
+    //@}
+
+    //! Global statistics over all columns
+    //@{
+    double getMin (void) const;
+    double getMax (void) const;
+    //@}
+
+    //! The statistics of one node
+    //@{
+    float nodeMinAt (int lvl, int col, qint64 i) const { return this->nodeMin[lvl][i*this->numCols()+col]; }
+    float nodeMaxAt (int lvl, int col, qint64 i) const { return this->nodeMax[lvl][i*this->numCols()+col]; }
+    float nodeMeanAt (int lvl, int col, qint64 i) const { return this->nodeMean[lvl][i*this->numCols()+col]; }
+    //@}
+
+    /*!
+     * Find the min, max and mean of column col over rows [row0, row1). Whole
+     * chunks come from the index; the partial chunks at either end of the
+     * window are read from raw, which must be a view onto the same column.
+     * Returns false for an empty or out of range window.
+     */
+    bool getWindow (int col, qint64 row0, qint64 row1, const logColumnView& raw,
+                    double& mn, double& mx, double& mean) const;
+
+private:
+    bool valid;
+    qint64 rows;
+
+    QVector < double > colMin;
+    QVector < double > colMax;
+    QVector < double > colMean;
+    // running sums, so that extend() can update the means
+    QVector < double > colSum;
+    QVector < qint64 > colCount;
+
+    // [level][node*numCols() + col], so that growing the log appends to each level
+    QVector < QVector < float > > nodeMin;
+    QVector < QVector < float > > nodeMax;
+    QVector < QVector < float > > nodeMean;
+
+    void reset (int nc);
+};
+
+#endif // LOGSUMMARYINDEX_H
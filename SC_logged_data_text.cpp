@@ -0,0 +1,238 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "SC_logged_data_text.h"
+#include "SC_utilities.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Identifies a text log cache file, and its layout version
+#define TEXTCACHE_MAGIC   0x53434c43 // "SCLC"
+#define TEXTCACHE_VERSION 1
+
+// Text logs smaller than this are parsed on one thread
+#define TEXTLOG_PARALLEL_MIN_BYTES (1<<20)
+
+const qint64 logTextLoader::cacheHeaderSize;
+
+static inline bool isBlank (char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+bool logTextLoader::parseChunk (const char* p, const char* end, fileFormat format, int numCols,
+                                QVector < QVector < double > >& cols, const char*& badLine)
+{
+    cols.resize(numCols);
+
+    while (p < end) {
+        const char* eol = (const char*)memchr (p, '\n', end-p);
+        if (eol == (const char*)0) {
+            eol = end;
+        }
+
+        const char* q = p;
+        while (q < eol && isBlank(*q)) { ++q; }
+        if (q == eol) {
+            // blank line
+            p = eol+1;
+            continue;
+        }
+
+        int col = 0;
+        while (true) {
+            double v;
+            const char* r = (col < numCols) ? SCUtilities::parseNumber (q, eol, v) : (const char*)0;
+            if (r == (const char*)0) {
+                badLine = p;
+                return false;
+            }
+            cols[col++].push_back(v);
+
+            q = r;
+            while (q < eol && isBlank(*q)) { ++q; }
+            if (q == eol) {
+                break;
+            }
+            if (format == CSVFormat) {
+                if (*q != ',') {
+                    badLine = p;
+                    return false;
+                }
+                ++q;
+                while (q < eol && isBlank(*q)) { ++q; }
+            } else if (q == r) {
+                // SSV fields must be separated by white space
+                badLine = p;
+                return false;
+            }
+        }
+
+        if (col != numCols) {
+            badLine = p;
+            return false;
+        }
+        p = eol+1;
+    }
+    return true;
+}
+
+bool logTextLoader::parse (QFile& file, fileFormat format, int numCols,
+                           QVector < QVector < double > >& cols, QString& err)
+{
+    cols.clear();
+    cols.resize(numCols);
+
+    qint64 size = file.size();
+    if (size == 0) {
+        return true;
+    }
+    uchar* mapped = file.map (0, size);
+    if (mapped == (uchar*)0) {
+        err = "Couldn't map " + file.fileName() + ": " + file.errorString();
+        return false;
+    }
+    const char* text = (const char*)mapped;
+    const char* textEnd = text + size;
+
+    // Divide into chunks which each start at the beginning of a line
+    int nChunks = 1;
+#ifdef _OPENMP
+    if (size >= TEXTLOG_PARALLEL_MIN_BYTES) {
+        nChunks = omp_get_max_threads();
+    }
+#endif
+    QVector < const char* > starts(nChunks+1);
+    starts[0] = text;
+    starts[nChunks] = textEnd;
+    for (int c = 1; c < nChunks; ++c) {
+        const char* s = text + (size*c)/nChunks;
+        if (s < starts[c-1]) {
+            s = starts[c-1];
+        }
+        const char* nl = (const char*)memchr (s, '\n', textEnd-s);
+        starts[c] = nl ? nl+1 : textEnd;
+    }
+
+    QVector < QVector < QVector < double > > > parts(nChunks);
+    QVector < const char* > bad(nChunks, (const char*)0);
+
+#pragma omp parallel for schedule(dynamic,1)
+    for (int c = 0; c < nChunks; ++c) {
+        const char* b = (const char*)0;
+        if (!parseChunk (starts[c], starts[c+1], format, numCols, parts[c], b)) {
+            bad[c] = b;
+        }
+    }
+
+    for (int c = 0; c < nChunks; ++c) {
+        if (bad[c] != (const char*)0) {
+            // Only now count the lines, to report where the problem is
+            qint64 lineNum = 1;
+            for (const char* p = text; p < bad[c]; ++p) {
+                if (*p == '\n') { ++lineNum; }
+            }
+            const char* eol = (const char*)memchr (bad[c], '\n', textEnd-bad[c]);
+            QString line = QString::fromLatin1 (bad[c], (int)qMin ((qint64)80, (qint64)((eol ? eol : textEnd) - bad[c])));
+            err = QString("Malformed line %1 in %2 (expected %3 columns): %4")
+                    .arg(lineNum).arg(file.fileName()).arg(numCols).arg(line);
+            file.unmap (mapped);
+            return false;
+        }
+    }
+
+    // Join the chunks' columns
+    for (int col = 0; col < numCols; ++col) {
+        int total = 0;
+        for (int c = 0; c < nChunks; ++c) {
+            total += parts[c][col].size();
+        }
+        cols[col].reserve(total);
+        for (int c = 0; c < nChunks; ++c) {
+            cols[col] += parts[c][col];
+            parts[c][col].clear();
+        }
+    }
+
+    file.unmap (mapped);
+    return true;
+}
+
+bool logTextLoader::writeCache (const QString& cacheName, qint64 textSize, qint64 textMTime,
+                                const QVector < QVector < double > >& cols)
+{
+    QFile f(cacheName);
+    if (!f.open (QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    // native byte order; this is a cache, never shared between machines
+    quint32 header[4] = { TEXTCACHE_MAGIC, TEXTCACHE_VERSION, (quint32)cols.size(), 0 };
+    qint64 header64[2] = { textSize, textMTime };
+    f.write ((const char*)header, sizeof(header));
+    f.write ((const char*)header64, sizeof(header64));
+
+    int nc = cols.size();
+    int rows = nc > 0 ? cols[0].size() : 0;
+
+    // Interleave the columns into rows, a block at a time
+    const int blockRows = 1 << 14;
+    QVector < double > block;
+    for (int r0 = 0; r0 < rows; r0 += blockRows) {
+        int r1 = qMin (rows, r0 + blockRows);
+        block.resize((r1-r0)*nc);
+        for (int r = r0; r < r1; ++r) {
+            for (int c = 0; c < nc; ++c) {
+                block[(r-r0)*nc + c] = cols[c][r];
+            }
+        }
+        if (f.write ((const char*)block.constData(), block.size()*sizeof(double)) != (qint64)(block.size()*sizeof(double))) {
+            f.close();
+            f.remove();
+            return false;
+        }
+    }
+
+    f.close();
+    return true;
+}
+
+bool logTextLoader::cacheIsCurrent (const QString& cacheName, qint64 textSize, qint64 textMTime, int numCols)
+{
+    QFile f(cacheName);
+    if (!f.open (QIODevice::ReadOnly)) {
+        return false;
+    }
+    quint32 header[4];
+    qint64 header64[2];
+    if (f.read ((char*)header, sizeof(header)) != sizeof(header)
+        || f.read ((char*)header64, sizeof(header64)) != sizeof(header64)) {
+        return false;
+    }
+    return header[0] == TEXTCACHE_MAGIC && header[1] == TEXTCACHE_VERSION
+        && header[2] == (quint32)numCols
+        && header64[0] == textSize && header64[1] == textMTime
+        && (f.size() - cacheHeaderSize) % (qint64)(numCols*sizeof(double)) == 0;
+}
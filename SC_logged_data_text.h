@@ -0,0 +1,76 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef LOGTEXTLOADER_H
+#define LOGTEXTLOADER_H
+
+#include "SC_logged_data.h"
+
+/*!
+ * \brief Loads CSV and SSV (space separated) logs.
+ *
+ * The text is memory mapped and divided into newline aligned chunks which are
+ * parsed in parallel (with OpenMP, where it is enabled) into columns of
+ * doubles, with SCUtilities::parseNumber, which works in place on the mapped
+ * text.
+ *
+ * The parsed log is then written out once as a binary cache file, with the
+ * same row layout as a binary log, so that logData can map it and treat it
+ * like any binary log. Later opens of an unchanged text log find the cache
+ * and skip parsing altogether.
+ */
+class logTextLoader
+{
+public:
+    /*!
+     * Size of the cache file header; the rows start at this offset.
+     */
+    static const qint64 cacheHeaderSize = 32;
+
+    /*!
+     * Parse the whole of file (which must be open) into numCols columns.
+     * On a malformed line, returns false and describes it in err.
+     */
+    static bool parse (QFile& file, fileFormat format, int numCols,
+                       QVector < QVector < double > >& cols, QString& err);
+
+    /*!
+     * Write cols out as rows of doubles, after a header which records the size
+     * and modification time of the text log they came from.
+     */
+    static bool writeCache (const QString& cacheName, qint64 textSize, qint64 textMTime,
+                            const QVector < QVector < double > >& cols);
+
+    /*!
+     * True if cacheName was written from a text log of this size and
+     * modification time, with numCols columns.
+     */
+    static bool cacheIsCurrent (const QString& cacheName, qint64 textSize, qint64 textMTime, int numCols);
+
+private:
+    static bool parseChunk (const char* p, const char* end, fileFormat format, int numCols,
+                            QVector < QVector < double > >& cols, const char*& badLine);
+};
+
+#endif // LOGTEXTLOADER_H
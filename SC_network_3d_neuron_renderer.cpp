@@ -0,0 +1,310 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "SC_network_3d_neuron_renderer.h"
+
+// Attribute locations, bound before linking. The mesh vertex takes location
+// 0, as it must be an array which is not instanced.
+#define NR_ATTR_VERTEX 0
+#define NR_ATTR_POSITION 1
+#define NR_ATTR_COLOUR 2
+
+// GLSL 1.20, for the widest support (including Mesa's llvmpipe). The lighting
+// follows the fixed function GL_LIGHT0 and GL_COLOR_MATERIAL setup which the
+// visualiser uses for everything else.
+static const char * nrVertexShader =
+        "#version 120\n"
+        "attribute vec3 vertex;\n"
+        "attribute vec3 position;\n"
+        "attribute vec4 colour;\n"
+        "uniform vec3 offset;\n"
+        "uniform float radius;\n"
+        "varying vec4 litColour;\n"
+        "void main() {\n"
+        "    gl_Position = gl_ModelViewProjectionMatrix * vec4(vertex*radius + position + offset, 1.0);\n"
+        "    vec3 n = normalize(gl_NormalMatrix * vertex);\n"
+        "    float d = max(dot(n, normalize(gl_LightSource[0].position.xyz)), 0.0);\n"
+        "    vec3 light = gl_LightModel.ambient.rgb + gl_LightSource[0].ambient.rgb + d*gl_LightSource[0].diffuse.rgb;\n"
+        "    litColour = vec4(min(colour.rgb*light, 1.0), colour.a);\n"
+        "}\n";
+
+static const char * nrFragmentShader =
+        "#version 120\n"
+        "varying vec4 litColour;\n"
+        "void main() {\n"
+        "    gl_FragColor = litColour;\n"
+        "}\n";
+
+neuronRenderer::neuronRenderer()
+{
+    this->meshVerts = 0;
+    this->detail = 0;
+    this->program = NULL;
+    this->instanced = false;
+    this->initialized = false;
+    this->vertexAttribDivisor = NULL;
+    this->drawArraysInstanced = NULL;
+}
+
+neuronRenderer::~neuronRenderer()
+{
+    this->trimBatches(0);
+    delete this->program;
+}
+
+void neuronRenderer::initialize (void)
+{
+    if (this->initialized) {
+        return;
+    }
+    this->initialized = true;
+
+    const QGLContext * ctx = QGLContext::currentContext();
+    if (ctx == NULL) {
+        DBG() << "no current GL context";
+        return;
+    }
+
+    // Instancing is core in GL 3.3, and otherwise needs the ARB extensions
+    this->vertexAttribDivisor = (vertexAttribDivisorFn) ctx->getProcAddress("glVertexAttribDivisor");
+    if (this->vertexAttribDivisor == NULL) {
+        this->vertexAttribDivisor = (vertexAttribDivisorFn) ctx->getProcAddress("glVertexAttribDivisorARB");
+    }
+    this->drawArraysInstanced = (drawArraysInstancedFn) ctx->getProcAddress("glDrawArraysInstanced");
+    if (this->drawArraysInstanced == NULL) {
+        this->drawArraysInstanced = (drawArraysInstancedFn) ctx->getProcAddress("glDrawArraysInstancedARB");
+    }
+    if (this->vertexAttribDivisor == NULL || this->drawArraysInstanced == NULL
+            || !QGLShaderProgram::hasOpenGLShaderPrograms()) {
+        DBG() << "GL instancing is not available; drawing neurons as points";
+        return;
+    }
+
+    this->program = new QGLShaderProgram;
+    this->program->addShaderFromSourceCode(QGLShader::Vertex, nrVertexShader);
+    this->program->addShaderFromSourceCode(QGLShader::Fragment, nrFragmentShader);
+    this->program->bindAttributeLocation("vertex", NR_ATTR_VERTEX);
+    this->program->bindAttributeLocation("position", NR_ATTR_POSITION);
+    this->program->bindAttributeLocation("colour", NR_ATTR_COLOUR);
+    if (!this->program->link()) {
+        DBG() << "neuron shader failed; drawing neurons as points:" << this->program->log();
+        delete this->program;
+        this->program = NULL;
+        return;
+    }
+
+    this->instanced = true;
+}
+
+bool neuronRenderer::isInstanced (void) const
+{
+    return this->instanced;
+}
+
+void neuronRenderer::setDetail (int lod)
+{
+    if (lod == this->detail) {
+        return;
+    }
+    this->detail = lod;
+    if (this->instanced) {
+        this->buildMesh();
+    }
+}
+
+void neuronRenderer::buildMesh (void)
+{
+    // A unit sphere as a list of triangles, so that each vertex is also its
+    // normal; the shader scales it by the radius.
+    QVector <float> v;
+    int rings = this->detail;
+    int segments = this->detail;
+    v.reserve(rings * segments * 6 * 3);
+    for (int i = 0; i < rings; ++i) {
+        double lat0 = M_PI * (-0.5 + (double) i / rings);
+        double lat1 = M_PI * (-0.5 + (double) (i+1) / rings);
+        for (int j = 0; j < segments; ++j) {
+            double lon0 = 2 * M_PI * (double) j / segments;
+            double lon1 = 2 * M_PI * (double) (j+1) / segments;
+            // the corners of this patch of the sphere
+            float p[4][3] = {
+                {float(cos(lon0)*cos(lat0)), float(sin(lon0)*cos(lat0)), float(sin(lat0))},
+                {float(cos(lon1)*cos(lat0)), float(sin(lon1)*cos(lat0)), float(sin(lat0))},
+                {float(cos(lon1)*cos(lat1)), float(sin(lon1)*cos(lat1)), float(sin(lat1))},
+                {float(cos(lon0)*cos(lat1)), float(sin(lon0)*cos(lat1)), float(sin(lat1))}
+            };
+            const int tri[6] = {0, 1, 2, 0, 2, 3};
+            for (int k = 0; k < 6; ++k) {
+                v.push_back(p[tri[k]][0]);
+                v.push_back(p[tri[k]][1]);
+                v.push_back(p[tri[k]][2]);
+            }
+        }
+    }
+    this->meshVerts = v.size() / 3;
+
+    if (!this->mesh.isCreated()) {
+        this->mesh = QGLBuffer(QGLBuffer::VertexBuffer);
+        this->mesh.setUsagePattern(QGLBuffer::StaticDraw);
+        this->mesh.create();
+    }
+    this->mesh.bind();
+    this->mesh.allocate(v.constData(), v.size() * sizeof(float));
+    this->mesh.release();
+}
+
+void neuronRenderer::upload (QGLBuffer& buf, const void * data, int bytes)
+{
+    if (!buf.isCreated()) {
+        buf = QGLBuffer(QGLBuffer::VertexBuffer);
+        buf.setUsagePattern(QGLBuffer::DynamicDraw);
+        buf.create();
+    }
+    buf.bind();
+    buf.allocate(data, bytes);
+    buf.release();
+}
+
+void neuronRenderer::drawBatch (int batch, int version, int colourVersion,
+                                const QVector <loc>& locs, const QVector <QColor>& cols, QColor col,
+                                float x, float y, float z, float r)
+{
+    if (locs.size() == 0) {
+        return;
+    }
+    if (!this->initialized) {
+        this->initialize();
+    }
+    while (this->batches.size() <= batch) {
+        neuronBatch * b = new neuronBatch;
+        b->built = false;
+        this->batches.push_back(b);
+    }
+    neuronBatch * b = this->batches[batch];
+
+    // Pack and upload the locations only when they may have changed, and the
+    // colours when either may have (a batch can change population)
+    bool perNeuron = cols.size() == locs.size();
+    bool newLocs = !b->built || b->key.version != version || b->key.numLocs != locs.size();
+    bool newCols = newLocs || b->key.colourVersion != colourVersion || b->key.numCols != cols.size();
+    b->key.version = version;
+    b->key.colourVersion = colourVersion;
+    b->key.numLocs = locs.size();
+    b->key.numCols = cols.size();
+    b->built = true;
+
+    if (newLocs) {
+        this->packPos.resize(locs.size() * 3);
+        for (int i = 0; i < locs.size(); ++i) {
+            this->packPos[3*i] = locs[i].x;
+            this->packPos[3*i+1] = locs[i].y;
+            this->packPos[3*i+2] = locs[i].z;
+        }
+        upload(b->positions, this->packPos.constData(), this->packPos.size() * sizeof(float));
+    }
+
+    if (perNeuron && newCols) {
+        this->packCol.resize(cols.size() * 4);
+        for (int i = 0; i < cols.size(); ++i) {
+            this->packCol[4*i] = cols[i].red();
+            this->packCol[4*i+1] = cols[i].green();
+            this->packCol[4*i+2] = cols[i].blue();
+            this->packCol[4*i+3] = cols[i].alpha();
+        }
+        upload(b->colours, this->packCol.constData(), this->packCol.size());
+    }
+
+    if (this->instanced) {
+
+        this->program->bind();
+        this->program->setUniformValue("offset", x, y, z);
+        this->program->setUniformValue("radius", r);
+
+        this->mesh.bind();
+        this->program->enableAttributeArray(NR_ATTR_VERTEX);
+        this->program->setAttributeBuffer(NR_ATTR_VERTEX, GL_FLOAT, 0, 3);
+
+        b->positions.bind();
+        this->program->enableAttributeArray(NR_ATTR_POSITION);
+        this->program->setAttributeBuffer(NR_ATTR_POSITION, GL_FLOAT, 0, 3);
+        this->vertexAttribDivisor(NR_ATTR_POSITION, 1);
+
+        if (perNeuron) {
+            b->colours.bind();
+            this->program->enableAttributeArray(NR_ATTR_COLOUR);
+            this->program->setAttributeBuffer(NR_ATTR_COLOUR, GL_UNSIGNED_BYTE, 0, 4);
+            this->vertexAttribDivisor(NR_ATTR_COLOUR, 1);
+        } else {
+            this->program->setAttributeValue(NR_ATTR_COLOUR, col.redF(), col.greenF(), col.blueF(), col.alphaF());
+        }
+
+        this->drawArraysInstanced(GL_TRIANGLES, 0, this->meshVerts, locs.size());
+
+        // leave the attribute state as the fixed function drawing expects it
+        this->vertexAttribDivisor(NR_ATTR_POSITION, 0);
+        this->vertexAttribDivisor(NR_ATTR_COLOUR, 0);
+        this->program->disableAttributeArray(NR_ATTR_VERTEX);
+        this->program->disableAttributeArray(NR_ATTR_POSITION);
+        this->program->disableAttributeArray(NR_ATTR_COLOUR);
+        this->program->release();
+
+    } else {
+
+        // points, sized to roughly match the spheres at the default zoom
+        glPushMatrix();
+        glTranslatef(x, y, z);
+        glPushAttrib(GL_ENABLE_BIT | GL_POINT_BIT);
+        glDisable(GL_LIGHTING);
+        glEnable(GL_POINT_SMOOTH);
+        glPointSize(r * 10.0f);
+
+        glEnableClientState(GL_VERTEX_ARRAY);
+        b->positions.bind();
+        glVertexPointer(3, GL_FLOAT, 0, 0);
+        if (perNeuron) {
+            glEnableClientState(GL_COLOR_ARRAY);
+            b->colours.bind();
+            glColorPointer(4, GL_UNSIGNED_BYTE, 0, 0);
+        } else {
+            glColor4f(col.redF(), col.greenF(), col.blueF(), col.alphaF());
+        }
+
+        glDrawArrays(GL_POINTS, 0, locs.size());
+
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glDisableClientState(GL_COLOR_ARRAY);
+        glPopAttrib();
+        glPopMatrix();
+    }
+
+    QGLBuffer::release(QGLBuffer::VertexBuffer);
+}
+
+void neuronRenderer::trimBatches (int numBatches)
+{
+    while (this->batches.size() > numBatches) {
+        delete this->batches.back();
+        this->batches.pop_back();
+    }
+}
@@ -0,0 +1,121 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef NEURONRENDERER_H
+#define NEURONRENDERER_H
+
+#include "globalHeader.h"
+#include <QGLBuffer>
+#include <QGLShaderProgram>
+
+// not all gl.h headers define this
+#ifndef APIENTRYP
+#define APIENTRYP APIENTRY *
+#endif
+
+/*!
+ * \brief Draws the neurons of the 3D visualiser from buffers held by GL.
+ *
+ * One sphere mesh is uploaded for the current level of detail. Each batch of
+ * neurons (a population, or a layout preview) has a buffer of positions and a
+ * buffer of colours, and is drawn with a single instanced call, in which a
+ * small shader places and lights a copy of the sphere for each neuron. A
+ * batch's buffers are only packed and uploaded again when the caller's
+ * version numbers, or the number of locations or colours, change, so
+ * rotating or zooming the view redraws from the buffers alone.
+ *
+ * Where shaders or instancing are not available, each neuron is drawn as a
+ * round point from the same buffers instead.
+ */
+class neuronRenderer
+{
+public:
+    neuronRenderer();
+    ~neuronRenderer();
+
+    /*!
+     * Set up the mesh, shader and instancing. The GL context to draw in must
+     * be current.
+     */
+    void initialize (void);
+
+    //! True if neurons are drawn as instanced spheres, rather than points.
+    bool isInstanced (void) const;
+
+    /*!
+     * Use spheres of lod rings and lod segments. The mesh is only rebuilt
+     * when this changes.
+     */
+    void setDetail (int lod);
+
+    /*!
+     * Draw batch number batch: spheres of radius r at locs, offset by
+     * (x,y,z). If cols has a colour for each location the neurons take
+     * those, otherwise they are all col. version must change whenever locs
+     * change in place, and colourVersion whenever cols do.
+     */
+    void drawBatch (int batch, int version, int colourVersion,
+                    const QVector <loc>& locs, const QVector <QColor>& cols, QColor col,
+                    float x, float y, float z, float r);
+
+    //! Free the buffers of batches numBatches and above.
+    void trimBatches (int numBatches);
+
+private:
+    //! Everything a batch's buffers depend on
+    struct neuronBatchKey {
+        int version;
+        int colourVersion;
+        int numLocs;
+        int numCols;
+    };
+
+    struct neuronBatch {
+        neuronBatchKey key;
+        bool built;
+        QGLBuffer positions;
+        QGLBuffer colours;
+    };
+
+    void buildMesh (void);
+    static void upload (QGLBuffer& buf, const void * data, int bytes);
+
+    QVector <neuronBatch*> batches;
+    QGLBuffer mesh;
+    int meshVerts;
+    int detail;
+    QGLShaderProgram * program;
+    bool instanced;
+    bool initialized;
+    //! Scratch space for packing a batch for upload
+    QVector <float> packPos;
+    QVector <uchar> packCol;
+
+    typedef void (APIENTRYP vertexAttribDivisorFn) (GLuint index, GLuint divisor);
+    typedef void (APIENTRYP drawArraysInstancedFn) (GLenum mode, GLint first, GLsizei count, GLsizei primcount);
+    vertexAttribDivisorFn vertexAttribDivisor;
+    drawArraysInstancedFn drawArraysInstanced;
+};
+
+#endif // NEURONRENDERER_H
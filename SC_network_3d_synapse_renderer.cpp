@@ -0,0 +1,186 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "SC_network_3d_synapse_renderer.h"
+
+static bool sameLoc(const loc& a, const loc& b)
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+bool synapseRenderer::synapseBatchKey::operator== (const synapseBatchKey& k) const
+{
+    return this->version == k.version
+            && this->numConns == k.numConns
+            && this->numSrc == k.numSrc
+            && this->numDst == k.numDst
+            && sameLoc(this->srcOffset, k.srcOffset)
+            && sameLoc(this->dstOffset, k.dstOffset)
+            && sameLoc(this->srcPopLoc, k.srcPopLoc)
+            && this->srcVisualised == k.srcVisualised
+            && this->dstVisualised == k.dstVisualised
+            && this->budget == k.budget;
+}
+
+synapseRenderer::synapseRenderer()
+{
+}
+
+synapseRenderer::~synapseRenderer()
+{
+    this->trimBatches(0);
+}
+
+void synapseRenderer::drawBatch (int batch, int version, const QVector <conn>& conns,
+                                 const QVector <loc>& srcLocs, const QVector <loc>& dstLocs,
+                                 const loc& srcOffset, const loc& dstOffset, const loc& srcPopLoc,
+                                 bool srcVisualised, bool dstVisualised, int budget)
+{
+    while (this->batches.size() <= batch) {
+        synapseBatch * b = new synapseBatch;
+        b->built = false;
+        b->numVerts = 0;
+        this->batches.push_back(b);
+    }
+    synapseBatch * b = this->batches[batch];
+
+    synapseBatchKey key;
+    key.version = version;
+    key.numConns = conns.size();
+    key.numSrc = srcLocs.size();
+    key.numDst = dstLocs.size();
+    key.srcOffset = srcOffset;
+    key.dstOffset = dstOffset;
+    key.srcPopLoc = srcPopLoc;
+    key.srcVisualised = srcVisualised;
+    key.dstVisualised = dstVisualised;
+    key.budget = budget;
+
+    if (!b->built || !(b->key == key)) {
+        b->key = key;
+        this->build(b, conns, srcLocs, dstLocs);
+        b->built = true;
+    }
+
+    if (b->numVerts == 0) {
+        return;
+    }
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    if (b->lines.isCreated()) {
+        b->lines.bind();
+        glVertexPointer(3, GL_FLOAT, 0, 0);
+    } else {
+        glVertexPointer(3, GL_FLOAT, 0, b->verts.constData());
+    }
+    glDrawArrays(GL_LINES, 0, b->numVerts);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    if (b->lines.isCreated()) {
+        b->lines.release();
+    }
+}
+
+// splitmix64, for choosing the subset of connections to draw
+static quint64 synapseRandom(quint64& state)
+{
+    quint64 z = (state += Q_UINT64_C(0x9e3779b97f4a7c15));
+    z = (z ^ (z >> 30)) * Q_UINT64_C(0xbf58476d1ce4e5b9);
+    z = (z ^ (z >> 27)) * Q_UINT64_C(0x94d049bb133111eb);
+    return z ^ (z >> 31);
+}
+
+void synapseRenderer::build (synapseBatch * b, const QVector <conn>& conns,
+                             const QVector <loc>& srcLocs, const QVector <loc>& dstLocs)
+{
+    const synapseBatchKey& k = b->key;
+    int n = conns.size();
+    int wanted = (k.budget > 0 && k.budget < n) ? k.budget : n;
+
+    b->verts.clear();
+    b->verts.reserve(wanted * 6);
+
+    // Selection sampling (Knuth's Algorithm S) picks exactly wanted of the n
+    // connections, in order, each with equal chance. The generator has a
+    // fixed seed, so the same subset is drawn each time the batch is built.
+    quint64 state = 0;
+    int chosen = 0;
+    for (int i = 0; i < n && chosen < wanted; ++i) {
+
+        if (wanted < n) {
+            double u = double(synapseRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+            if ((n - i) * u >= wanted - chosen) {
+                continue;
+            }
+        }
+        ++chosen;
+
+        const conn& c = conns[i];
+        if (c.src < 0 || c.dst < 0 || c.src >= srcLocs.size() || c.dst >= dstLocs.size()) {
+            // connection index out of range
+            continue;
+        }
+
+        loc s = {0,0,0};
+        loc d = {0,0,0};
+        if (k.srcVisualised && k.dstVisualised) {
+            s = srcLocs[c.src];
+            s.x += k.srcOffset.x; s.y += k.srcOffset.y; s.z += k.srcOffset.z;
+            d = dstLocs[c.dst];
+            d.x += k.dstOffset.x; d.y += k.dstOffset.y; d.z += k.dstOffset.z;
+        } else if (k.srcVisualised) {
+            s = srcLocs[c.src];
+            d = k.dstOffset;
+        } else if (k.dstVisualised) {
+            s = k.srcPopLoc;
+            d = dstLocs[c.dst];
+        } else {
+            continue;
+        }
+        b->verts.push_back(s.x); b->verts.push_back(s.y); b->verts.push_back(s.z);
+        b->verts.push_back(d.x); b->verts.push_back(d.y); b->verts.push_back(d.z);
+    }
+    b->numVerts = b->verts.size() / 3;
+
+    if (!b->lines.isCreated()) {
+        b->lines = QGLBuffer(QGLBuffer::VertexBuffer);
+        b->lines.setUsagePattern(QGLBuffer::StaticDraw);
+        if (!b->lines.create()) {
+            // draw from b->verts instead
+            return;
+        }
+    }
+    b->lines.bind();
+    b->lines.allocate(b->verts.constData(), b->verts.size() * sizeof(float));
+    b->lines.release();
+    // the buffer holds the vertices now
+    b->verts = QVector <float>();
+}
+
+void synapseRenderer::trimBatches (int numBatches)
+{
+    while (this->batches.size() > numBatches) {
+        delete this->batches.back();
+        this->batches.pop_back();
+    }
+}
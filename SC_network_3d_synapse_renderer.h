@@ -0,0 +1,97 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef SYNAPSERENDERER_H
+#define SYNAPSERENDERER_H
+
+#include "globalHeader.h"
+#include <QGLBuffer>
+
+/*!
+ * \brief Draws the connection lines of explicit (CSV and Python) connectivity
+ * in the 3D visualiser from vertex buffers.
+ *
+ * Each selected synapse or input is a batch, whose line vertices are packed
+ * and uploaded once. They are only rebuilt when the caller's version number,
+ * the populations' offsets or visibility, or the number of connections or
+ * neurons change, so rotating or zooming the view redraws from the buffers
+ * alone.
+ *
+ * If a batch has more connections than the line budget, a fixed random
+ * subset of exactly that many is drawn, so that the cost of a frame is
+ * bounded however large the projection.
+ */
+class synapseRenderer
+{
+public:
+    synapseRenderer();
+    ~synapseRenderer();
+
+    /*!
+     * Draw the lines of batch number batch, in the current colour and line
+     * width. version must change whenever conns, srcLocs or dstLocs change
+     * in place. The population offsets and visibility are as in
+     * glConnectionWidget::paintEvent(). budget is the most lines to draw, or
+     * 0 to draw them all.
+     */
+    void drawBatch (int batch, int version, const QVector <conn>& conns,
+                    const QVector <loc>& srcLocs, const QVector <loc>& dstLocs,
+                    const loc& srcOffset, const loc& dstOffset, const loc& srcPopLoc,
+                    bool srcVisualised, bool dstVisualised, int budget);
+
+    //! Free the buffers of batches numBatches and above.
+    void trimBatches (int numBatches);
+
+private:
+    //! Everything a batch's vertices depend on
+    struct synapseBatchKey {
+        int version;
+        int numConns;
+        int numSrc;
+        int numDst;
+        loc srcOffset;
+        loc dstOffset;
+        loc srcPopLoc;
+        bool srcVisualised;
+        bool dstVisualised;
+        int budget;
+        bool operator== (const synapseBatchKey& k) const;
+    };
+
+    struct synapseBatch {
+        synapseBatchKey key;
+        bool built;
+        QGLBuffer lines;
+        int numVerts;
+        //! Client side vertices, where buffers are not available
+        QVector <float> verts;
+    };
+
+    void build (synapseBatch * b, const QVector <conn>& conns,
+                const QVector <loc>& srcLocs, const QVector <loc>& dstLocs);
+
+    QVector <synapseBatch*> batches;
+};
+
+#endif // SYNAPSERENDERER_H
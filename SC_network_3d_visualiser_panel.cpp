@@ -35,6 +35,13 @@
 #if QT_VERSION > QT_VERSION_CHECK(5, 0, 0)
 #include <QOpenGLFramebufferObject>
 #endif
+#if QT_VERSION >= QT_VERSION_CHECK(5, 1, 0)
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#endif
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
 #if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
   #define RETINA_SUPPORT 1.0
 #else
@@ -47,6 +54,24 @@
 #include <limits>
 
 
+/*!
+ * The Python script connection which generates conn - conn itself, or the
+ * generator of an explicit list - or NULL
+ */
+static pythonscript_connection * pythonGenerator(connection * conn)
+{
+    if (conn == NULL) {
+        return NULL;
+    }
+    if (conn->type == Python) {
+        return (pythonscript_connection *) conn;
+    }
+    if (conn->type == CSV && ((csv_connection *) conn)->generator != NULL) {
+        return dynamic_cast <pythonscript_connection *> (((csv_connection *) conn)->generator);
+    }
+    return NULL;
+}
+
 glConnectionWidget::glConnectionWidget(nl_rootdata * data, QWidget *parent) : QGLWidget(QGLFormat(QGL::SampleBuffers), parent)
 {
     model = (QAbstractTableModel *)0;
@@ -68,11 +93,36 @@ glConnectionWidget::glConnectionWidget(nl_rootdata * data, QWidget *parent) : QG
 
     orthoView = false;
     repaintAllowed = true;
+    synapseGeometryVersion = 0;
+    popColoursVersion = 0;
+    offscreenMode = false;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 1, 0)
+    offSurface = NULL;
+    offContext = NULL;
+    offNeurons = NULL;
+    offSynapses = NULL;
+#endif
+}
+
+glConnectionWidget::~glConnectionWidget()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 1, 0)
+    // the offscreen renderers' buffers belong to the offscreen context
+    if (offContext != NULL) {
+        offContext->makeCurrent(offSurface);
+        delete offNeurons;
+        delete offSynapses;
+        offContext->doneCurrent();
+        delete offContext;
+        delete offSurface;
+    }
+#endif
 }
 
 void glConnectionWidget::initializeGL()
 {
     glEnable(GL_MULTISAMPLE);
+    neurons.initialize();
 }
 
 void glConnectionWidget::toggleOrthoView(bool toggle)
@@ -91,6 +141,7 @@ void glConnectionWidget::clear()
     selectedIndex = 0;
     selectedType = 1;
     model = (QAbstractTableModel *)0;
+    ++synapseGeometryVersion;
 }
 
 // This builds a list of possible logs from the populations in the network.
@@ -120,6 +171,62 @@ void glConnectionWidget::addLogs(QVector < logData * > * logs)
                 }
             }
         }
+
+        // no analog log, so fall back to showing spikes from an event log
+        if (this->popLogs[i] == NULL) {
+            for (int j = 0; j < pop->neuronType->component->EventPortList.size(); ++j) {
+
+                EventPort * port = pop->neuronType->component->EventPortList[j];
+                if (port->mode == EventSendPort) {
+
+                    QString possibleLogName = pop->name + "_" + port->name + "_log.bin";
+                    possibleLogName.replace(" ", "_");
+
+                    for (int k = 0; k < logs->size(); ++k) {
+                        if ((*logs)[k]->logName == possibleLogName) {
+                            this->popLogs[i] = (*logs)[k];
+                        }
+                    }
+                }
+            }
+        }
+
+        // recolour as a followed log grows
+        if (this->popLogs[i] != NULL) {
+            connect(this->popLogs[i], SIGNAL(rowsAppended(qint64,qint64)),
+                    this, SLOT(logRowsAppended(qint64,qint64)), Qt::UniqueConnection);
+        }
+    }
+}
+
+void glConnectionWidget::showModel(QVector < logData * > * logs)
+{
+    this->clear();
+    for (int i = 0; i < data->populations.size(); ++i) {
+
+        QSharedPointer <population> currPop = (QSharedPointer <population>) data->populations[i];
+
+        if (currPop->layoutType->locations.size() == 0) {
+            QString errs;
+            currPop->layoutType->generateLayout(currPop->numNeurons,&currPop->layoutType->locations,errs);
+            if (!errs.isEmpty()) {
+                DBG() << "Layout of" << currPop->name << ":" << errs;
+            }
+        }
+        selectedPops.push_back(currPop);
+        popLogs.push_back(NULL);
+        popColours.resize(popColours.size()+1);
+    }
+    this->addLogs(logs);
+}
+
+// A followed log has grown. If the new rows include the time on show, or
+// the log's range (and so the colour map) may have changed, recolour.
+void glConnectionWidget::logRowsAppended(qint64, qint64 endRow)
+{
+    if (currentLogTime < endRow) {
+        // force updateLogData to re-read the current row on its next tick
+        currentLogTime = -1;
     }
 }
 
@@ -135,6 +242,16 @@ void glConnectionWidget::updateLogData()
 
     currentLogTime = newLogTime;
 
+    this->fetchLogColours(currentLogTime);
+
+    // redraw!
+    this->repaint();
+}
+
+void glConnectionWidget::fetchLogColours(int time)
+{
+    ++popColoursVersion;
+
     // fetch data from logs
     for (int i = 0; i < popLogs.size(); ++i) {
 
@@ -142,8 +259,27 @@ void glConnectionWidget::updateLogData()
         if (popLogs[i] == NULL)
             continue;
 
-        // get a row
-        QVector < double > logValues = popLogs[i]->getRow(currentLogTime);
+        // Event logs; light up the neurons which spiked in this timestep. The
+        // log's event index makes this cost the number of spikes, not the
+        // length of the log.
+        if (popLogs[i]->dataClass == EVENTDATA) {
+            QVector < double >& spikes = popLogs[i]->rowBuffer;
+            popColours[i].resize(selectedPops[i]->numNeurons);
+            popColours[i].fill(QColor(0,0,0,255));
+            popLogs[i]->getRow(time, spikes);
+            for (int j = 0; j < spikes.size(); ++j) {
+                int nrn = (int) spikes[j];
+                if (nrn >= 0 && nrn < popColours[i].size()) {
+                    popColours[i][nrn] = QColor(255,255,0,255);
+                }
+            }
+            continue;
+        }
+
+        // get a row, straight from the mapped log into the log's own buffer
+        QVector < double >& logValues = popLogs[i]->rowBuffer;
+        if (!popLogs[i]->getRow(time, logValues))
+            continue;
 
         // data not usable
         if (logValues.size() == 0)
@@ -157,9 +293,11 @@ void glConnectionWidget::updateLogData()
         popColours[i].fill(col);
 
         // remap data
+        double logMin = popLogs[i]->getMin();
+        double logRange = popLogs[i]->getMax()-logMin;
         for (int j = 0; j < logValues.size(); ++j) {
-            if (logValues[j] < Q_INFINITY && (popLogs[i]->getMax()-popLogs[i]->getMin()) != 0) {
-                int val = ((logValues[j]-popLogs[i]->getMin())*255.0)/(popLogs[i]->getMax()-popLogs[i]->getMin());
+            if (logValues[j] < Q_INFINITY && logRange != 0) {
+                int val = ((logValues[j]-logMin)*255.0)/logRange;
                 val *= 3;
                 // complete the remap in just 4 ternarys
                 int val3 = val > 511 ? val-512 : 0;
@@ -171,9 +309,6 @@ void glConnectionWidget::updateLogData()
             }
         }
     }
-
-    // redraw!
-    this->repaint();
 }
 
 void glConnectionWidget::resizeGL(int, int)
@@ -192,6 +327,7 @@ void glConnectionWidget::redraw()
             CHECK_CAST(currPop)
             currPop->layoutType->locations.clear();
             currPop->layoutType->generateLayout(currPop->numNeurons,&currPop->layoutType->locations,errs);
+            ++synapseGeometryVersion;
         }
     }
     this->repaint();
@@ -241,6 +377,96 @@ void glConnectionWidget::paintEvent(QPaintEvent * /*event*/)
         return;
     }
 
+    this->makeCurrent();
+    this->drawScene(this->neurons, this->synapses);
+
+    // if previewing a layout there are no labels
+    if (locations.size() > 0) {
+        // need this as no painter!
+        swapBuffers();
+        return;
+    }
+
+    glPushMatrix();
+    glTranslatef(0,0,-5.0);
+
+    if (popIndicesShown) {
+        QPainter painter(this);
+        painter.setRenderHint(QPainter::Antialiasing);
+
+        QPen pen = painter.pen();
+        QPen oldPen = pen;
+        pen.setColor(QColor(0,0,0,255));
+        painter.setPen(pen);
+
+        float zoomVal = zoomFactor;
+        if (zoomVal < 0.3f)
+            zoomVal = 0.3f;
+
+        // draw text
+        for (int locNum = 0; locNum < selectedPops.size(); ++locNum) {
+            QSharedPointer <population> currPop = selectedPops[locNum];
+            for (int i = 0; i < currPop->layoutType->locations.size(); ++i) {
+                glPushMatrix();
+
+                glTranslatef(currPop->layoutType->locations[i].x, currPop->layoutType->locations[i].y, currPop->layoutType->locations[i].z);
+
+                // if currently selected
+                if (currPop == selectedObject) {
+                    // move to pop location denoted by the spinboxes for x, y, z
+                    glTranslatef(loc3Offset.x, loc3Offset.y,loc3Offset.z);
+                } else {
+                    glTranslatef(currPop->loc3.x, currPop->loc3.y,currPop->loc3.z);
+                }
+
+                // print up text:
+                GLdouble modelviewMatrix[16];
+                GLdouble projectionMatrix[16];
+                GLint viewPort[4];
+                GLdouble winX;
+                GLdouble winY;
+                GLdouble winZ;
+                glGetIntegerv(GL_VIEWPORT, viewPort);
+                glGetDoublev(GL_MODELVIEW_MATRIX, modelviewMatrix);
+                glGetDoublev(GL_PROJECTION_MATRIX, projectionMatrix);
+                gluProject(0, 0, 0, modelviewMatrix, projectionMatrix, viewPort, &winX, &winY, &winZ);
+
+                winX /= RETINA_SUPPORT;
+                winY /= RETINA_SUPPORT;
+
+                if (orthoView) {
+                    winX += this->width()/4.0;
+                    winY -= this->height()/4.0;
+                }
+
+                if (imageSaveMode) {
+                    //painter.drawText(QRect(winX-(1.0-winZ)*220-20,imageSaveHeight-winY-(1.0-winZ)*220-10,40,20),QString::number(float(i)));
+                } else {
+                    if (orthoView) {
+                        painter.drawText(QRect(winX-(1.0-winZ)*220-10.0/zoomVal-10,this->height()-winY-(1.0-winZ)*220-10.0/zoomVal-10,40,20),QString::number(float(i)));
+                    } else {
+                        painter.drawText(QRect(winX-(1.0-winZ)*300-10.0/zoomVal,this->height()-winY-(1.0-winZ)*300-10.0/zoomVal,40,20),QString::number(float(i)));
+                        //painter.drawText(QRect(winX-(1.0-winZ)*600,this->height()-winY-(1.0-winZ)*600,40,20),QString::number(float(i)));
+                        //painter.drawText(QRect((winX-(1.0-winZ)*220-20),this->height()-(winY-(1.0-winZ)*220+50),40,20),QString::number(float(i)));
+                    }
+                }
+                glPopMatrix();
+            }
+        }
+        painter.setPen(oldPen);
+        painter.end();
+    } else {
+        // if the painter isn't there this doesn't get called!
+        QPainter painter(this);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.end();
+    }
+
+    glPopMatrix();
+}
+
+void glConnectionWidget::drawScene(neuronRenderer& nrn, synapseRenderer& syn)
+{
     // get rid of old stuff
     if (imageSaveMode) {
         QColor qtCol = QColor::fromRgbF(1.0,1.0,1.0,0.0);
@@ -286,34 +512,29 @@ void glConnectionWidget::paintEvent(QPaintEvent * /*event*/)
     // fetch quality setting
     QSettings settings;
     int quality = settings.value("glOptions/detail", 5).toInt();
+    // and the most connection lines to draw per synapse, 0 for all
+    int connBudget = settings.value("glOptions/maxConnections", 100000).toInt();
 
     glPushMatrix();
     glTranslatef(0,0,-5.0);
 
     // if previewing a layout then override normal drawing
     if (locations.size() > 0) {
-        for (int i = 0; i < locations[0].size(); ++i) {
-            glPushMatrix();
-
-            glTranslatef(locations[0][i].x, locations[0][i].y, locations[0][i].z);
-
-            // draw with a level of detail dependant on the number on neurons we must draw
-            int LoD = round(250.0f/float(locations[0].size())*pow(2,float(quality)));
-            // put some bounds on
-            if (LoD < 4) {
-                LoD = 4;
-            }
-            if (LoD > 32) {
-                LoD = 32;
-            }
-            this->drawNeuron(0.5, LoD, LoD, QColor(100,100,100,255));
-
-            glPopMatrix();
+        // draw with a level of detail dependant on the number on neurons we must draw
+        int LoD = round(250.0f/float(locations[0].size())*pow(2,float(quality)));
+        // put some bounds on
+        if (LoD < 4) {
+            LoD = 4;
+        }
+        if (LoD > 32) {
+            LoD = 32;
         }
+        nrn.setDetail(LoD);
+        nrn.drawBatch(0, synapseGeometryVersion, popColoursVersion, locations[0], QVector <QColor>(),
+                      QColor(100,100,100,255), 0, 0, 0, 0.5);
+        nrn.trimBatches(1);
 
         glPopMatrix();
-        // need this as no painter!
-        swapBuffers();
         return;
     }
 
@@ -324,52 +545,45 @@ void glConnectionWidget::paintEvent(QPaintEvent * /*event*/)
         totalNeurons += selectedPops[locNum]->layoutType->locations.size();
     }
     int LoD = round(250.0f/float(totalNeurons)*pow(2,float(quality)));
+    // put some bounds on
+    if (LoD < 4) {
+        LoD = 4;
+    }
+    if (LoD > 32) {
+        LoD = 32;
+    }
+    // full detail for exported images, but not for offscreen frames, which
+    // may be rendered by the thousand
+    if (imageSaveMode && !offscreenMode) {
+        LoD = 64;
+    }
+    nrn.setDetail(LoD);
 
-    // normal drawing
+    // normal drawing; a batch of instances per population
     for (int locNum = 0; locNum < selectedPops.size(); ++locNum) {
         QSharedPointer <population> currPop = selectedPops[locNum];
-        for (int i = 0; i < currPop->layoutType->locations.size(); ++i) {
-            glPushMatrix();
 
-            glTranslatef(currPop->layoutType->locations[i].x, currPop->layoutType->locations[i].y, currPop->layoutType->locations[i].z);
-
-            // if currently selected
-            if (currPop == selectedObject) {
-                // move to pop location denoted by the spinboxes for x, y, z
-                glTranslatef(loc3Offset.x, loc3Offset.y,loc3Offset.z);
-            } else {
-                glTranslatef(currPop->loc3.x, currPop->loc3.y,currPop->loc3.z);
-            }
-
-            // draw with a level of detail dependant on the number on neurons we must draw
-            // put some bounds on
-            if (LoD < 4) {
-                LoD = 4;
-            }
-            if (LoD > 32) {
-                LoD = 32;
-            }
-            if (imageSaveMode) {
-                LoD = 64;
-            }
-
-            // check we haven't broken stuff
-            if (popColours[locNum].size() > currPop->layoutType->locations.size()) {
-                popColours[locNum].clear();
-                popLogs[locNum] = NULL;
-            }
-
-            if (popColours[locNum].size() > 0) {
-                this->drawNeuron(0.5, LoD, LoD, popColours[locNum][i]);
-            } else {
-                this->drawNeuron(0.5, LoD, LoD, QColor(100 + 0.5*currPop->colour.red(),
-                                                       100 + 0.5*currPop->colour.green(),
-                                                       100 + 0.5*currPop->colour.blue(),255));
-            }
+        // check we haven't broken stuff
+        if (popColours[locNum].size() > currPop->layoutType->locations.size()) {
+            popColours[locNum].clear();
+            popLogs[locNum] = NULL;
+            ++popColoursVersion;
+        }
 
-            glPopMatrix();
+        // if currently selected move to pop location denoted by the spinboxes for x, y, z
+        loc3f offset = {currPop->loc3.x, currPop->loc3.y, currPop->loc3.z};
+        if (currPop == selectedObject) {
+            offset = loc3Offset;
         }
+
+        nrn.drawBatch(locNum, synapseGeometryVersion, popColoursVersion,
+                          currPop->layoutType->locations, popColours[locNum],
+                          QColor(100 + 0.5*currPop->colour.red(),
+                                 100 + 0.5*currPop->colour.green(),
+                                 100 + 0.5*currPop->colour.blue(),255),
+                          offset.x, offset.y, offset.z, 0.5);
     }
+    nrn.trimBatches(selectedPops.size());
 
     // draw synapses
     for (int targNum = 0; targNum < this->selectedConns.size(); ++targNum) {
@@ -436,21 +650,8 @@ void glConnectionWidget::paintEvent(QPaintEvent * /*event*/)
             dstZ = dst->loc3.z;
         }
 
-        // check we have the current version of the connectivity
-        if (conn->type == CSV) {
-            csv_connection * csv_conn = dynamic_cast<csv_connection *> (conn);
-            CHECK_CAST(csv_conn)
-            if (csv_conn->generator) {
-                pythonscript_connection * pyConn = dynamic_cast<pythonscript_connection *> (csv_conn->generator);
-                CHECK_CAST(pyConn)
-                if (pyConn->changed()) {
-                    pyConn->regenerateConnections();
-                    // fetch connections back here:
-                    connections[targNum].clear();
-                    csv_conn->getAllData(connections[targNum]);
-                }
-            }
-        }
+        // the connections last generated are drawn; pythonConnectionsDone()
+        // fetches them again once a generator's job has finished
 
         if (conn->type == CSV || conn->type == Python) {
 
@@ -462,56 +663,17 @@ void glConnectionWidget::paintEvent(QPaintEvent * /*event*/)
 
             connGenerationMutex->lock();
 
-            // Only render a few thousand of the black connections lines max
-            int inc = 1;
-            int connectionsToSkip = 1000; // FIXME: Make this a UI parameter
-            if (connections[targNum].size() > connectionsToSkip) {
-                // Compute inc based on number of connections:
-                inc = (int) connections[targNum].size()/connectionsToSkip;
-            }
-            for (int i = 0; i < connections[targNum].size(); i+=inc) {
-
-                if (connections[targNum][i].src < src->layoutType->locations.size()
-                    && connections[targNum][i].dst < dst->layoutType->locations.size()) {
-
-                    glLineWidth(2.0*lineScaleFactor);
-                    glColor4f(0.0f, 0.0f, 0.0f, 0.3f);
-
-                    // draw in
-                    glBegin(GL_TRIANGLES);
-                    if (src->isVisualised && dst->isVisualised) {
-                        glVertex3f(src->layoutType->locations[connections[targNum][i].src].x+srcX,
-                                   src->layoutType->locations[connections[targNum][i].src].y+srcY,
-                                   src->layoutType->locations[connections[targNum][i].src].z+srcZ);
-                        glVertex3f(dst->layoutType->locations[connections[targNum][i].dst].x+dstX,
-                                   dst->layoutType->locations[connections[targNum][i].dst].y+dstY,
-                                   dst->layoutType->locations[connections[targNum][i].dst].z+dstZ);
-                        glVertex3f(dst->layoutType->locations[connections[targNum][i].dst].x+dstX,
-                                   dst->layoutType->locations[connections[targNum][i].dst].y+dstY,
-                                   dst->layoutType->locations[connections[targNum][i].dst].z+dstZ+0.05);
-                    }
-                    if (src->isVisualised && !dst->isVisualised) {
-                        glVertex3f(src->layoutType->locations[connections[targNum][i].src].x,
-                                   src->layoutType->locations[connections[targNum][i].src].y,
-                                   src->layoutType->locations[connections[targNum][i].src].z);
-                        glVertex3f(dstX, dstY, dstZ);
-                        glVertex3f(dstX, dstY, dstZ+0.01);
-                    }
-                    if (!src->isVisualised && dst->isVisualised) {
-                        glVertex3f(src->loc3.x, src->loc3.y, src->loc3.z);
-                        glVertex3f(dst->layoutType->locations[connections[targNum][i].dst].x,
-                                   dst->layoutType->locations[connections[targNum][i].dst].y,
-                                   dst->layoutType->locations[connections[targNum][i].dst].z);
-                        glVertex3f(dst->layoutType->locations[connections[targNum][i].dst].x,
-                                   dst->layoutType->locations[connections[targNum][i].dst].y,
-                                   dst->layoutType->locations[connections[targNum][i].dst].z+0.01);
-                    }
-                    glEnd();
-
-                } else {
-                    // ERR - CONNECTION INDEX OUT OF RANGE
-                }
-            }
+            // Draw the connection lines from a buffer, which is only rebuilt
+            // when the connections, layouts or offsets change. Above the
+            // budget, a fixed random subset of the lines is drawn.
+            loc srcOffset = {srcX, srcY, srcZ};
+            loc dstOffset = {dstX, dstY, dstZ};
+            glLineWidth(1.0*lineScaleFactor);
+            glColor4f(0.0f, 0.0f, 0.0f, 0.3f);
+            syn.drawBatch(targNum, synapseGeometryVersion, connections[targNum],
+                               src->layoutType->locations, dst->layoutType->locations,
+                               srcOffset, dstOffset, src->loc3,
+                               src->isVisualised, dst->isVisualised, connBudget);
 
             // draw selected connections on top
             glDisable(GL_DEPTH_TEST);
@@ -863,6 +1025,7 @@ void glConnectionWidget::paintEvent(QPaintEvent * /*event*/)
         glEnable(GL_DEPTH_TEST);
         glEnable(GL_LIGHTING);
     }
+    syn.trimBatches(selectedConns.size());
 
     glDisable(GL_BLEND);
     glDisable(GL_POLYGON_SMOOTH);
@@ -875,78 +1038,6 @@ void glConnectionWidget::paintEvent(QPaintEvent * /*event*/)
 
     glMatrixMode(GL_MODELVIEW);
 
-    if (popIndicesShown) {
-        QPainter painter(this);
-        painter.setRenderHint(QPainter::Antialiasing);
-
-        QPen pen = painter.pen();
-        QPen oldPen = pen;
-        pen.setColor(QColor(0,0,0,255));
-        painter.setPen(pen);
-
-        float zoomVal = zoomFactor;
-        if (zoomVal < 0.3f)
-            zoomVal = 0.3f;
-
-        // draw text
-        for (int locNum = 0; locNum < selectedPops.size(); ++locNum) {
-            QSharedPointer <population> currPop = selectedPops[locNum];
-            for (int i = 0; i < currPop->layoutType->locations.size(); ++i) {
-                glPushMatrix();
-
-                glTranslatef(currPop->layoutType->locations[i].x, currPop->layoutType->locations[i].y, currPop->layoutType->locations[i].z);
-
-                // if currently selected
-                if (currPop == selectedObject) {
-                    // move to pop location denoted by the spinboxes for x, y, z
-                    glTranslatef(loc3Offset.x, loc3Offset.y,loc3Offset.z);
-                } else {
-                    glTranslatef(currPop->loc3.x, currPop->loc3.y,currPop->loc3.z);
-                }
-
-                // print up text:
-                GLdouble modelviewMatrix[16];
-                GLdouble projectionMatrix[16];
-                GLint viewPort[4];
-                GLdouble winX;
-                GLdouble winY;
-                GLdouble winZ;
-                glGetIntegerv(GL_VIEWPORT, viewPort);
-                glGetDoublev(GL_MODELVIEW_MATRIX, modelviewMatrix);
-                glGetDoublev(GL_PROJECTION_MATRIX, projectionMatrix);
-                gluProject(0, 0, 0, modelviewMatrix, projectionMatrix, viewPort, &winX, &winY, &winZ);
-
-                winX /= RETINA_SUPPORT;
-                winY /= RETINA_SUPPORT;
-
-                if (orthoView) {
-                    winX += this->width()/4.0;
-                    winY -= this->height()/4.0;
-                }
-
-                if (imageSaveMode) {
-                    //painter.drawText(QRect(winX-(1.0-winZ)*220-20,imageSaveHeight-winY-(1.0-winZ)*220-10,40,20),QString::number(float(i)));
-                } else {
-                    if (orthoView) {
-                        painter.drawText(QRect(winX-(1.0-winZ)*220-10.0/zoomVal-10,this->height()-winY-(1.0-winZ)*220-10.0/zoomVal-10,40,20),QString::number(float(i)));
-                    } else {
-                        painter.drawText(QRect(winX-(1.0-winZ)*300-10.0/zoomVal,this->height()-winY-(1.0-winZ)*300-10.0/zoomVal,40,20),QString::number(float(i)));
-                        //painter.drawText(QRect(winX-(1.0-winZ)*600,this->height()-winY-(1.0-winZ)*600,40,20),QString::number(float(i)));
-                        //painter.drawText(QRect((winX-(1.0-winZ)*220-20),this->height()-(winY-(1.0-winZ)*220+50),40,20),QString::number(float(i)));
-                    }
-                }
-                glPopMatrix();
-            }
-        }
-        painter.setPen(oldPen);
-        painter.end();
-    } else {
-        // if the painter isn't there this doesn't get called!
-        QPainter painter(this);
-        painter.setRenderHint(QPainter::Antialiasing);
-        painter.end();
-    }
-
     glPopMatrix();
 }
 
@@ -1256,6 +1347,7 @@ void glConnectionWidget::typeChanged(int)
         // find the locations of the src and dst:
     }
 
+    ++synapseGeometryVersion;
     this->repaint();
 }
 
@@ -1280,6 +1372,7 @@ void glConnectionWidget::parsChangedPopulation(int value)
         }
     }
 
+    ++synapseGeometryVersion;
     this->repaint();
 }
 
@@ -1300,6 +1393,7 @@ void glConnectionWidget::parsChangedPopulation(double)
         }
     }
 
+    ++synapseGeometryVersion;
     this->repaint();
 }
 
@@ -1320,6 +1414,7 @@ void glConnectionWidget::parsChangedPopulation()
         }
     }
 
+    ++synapseGeometryVersion;
     this->repaint();
 }
 
@@ -1339,24 +1434,14 @@ void glConnectionWidget::parsChangedProjections()
             conn = currIn->conn;
         }
 
-        // regrab data for python based
-        if (conn->type == Python) {
-
-            // refresh the connections
-            if (((pythonscript_connection *) conn)->changed()) {
-                connections[i].clear();
-                // launch version increment dialog box:
-                generate_dialog generate(((pythonscript_connection *) conn), ((pythonscript_connection *) conn)->srcPop, ((pythonscript_connection *) conn)->dstPop, connections[i], connGenerationMutex, this);
-                bool retVal = generate.exec();
-                if (!retVal) {
-                    return;
-                }
-                ((pythonscript_connection *) conn)->connections = connections[i];
-                ((pythonscript_connection *) conn)->setUnchanged(true);
-            }
+        // regrab data for python based, or generated by a python script
+        pythonscript_connection * pyConn = pythonGenerator(conn);
+        if (pyConn != NULL && pyConn->changed()) {
+            this->generatePythonConnections(pyConn, pyConn->srcPop, pyConn->dstPop);
         }
     }
 
+    ++synapseGeometryVersion;
     repaint();
 }
 
@@ -1386,30 +1471,18 @@ void glConnectionWidget::parsChangedProjection()
             this->getConnections();
         }
 
-        // regrab data for python script based
-        if (conn->type == Python) {
-            // update the projection:
-            // find selected object
+        // regrab data for python script based, or generated; the
+        // connections now drawn stay until the new ones are ready
+        pythonscript_connection * pyConn = pythonGenerator(conn);
+        if (pyConn != NULL && pyConn->changed()) {
             for (int i = 0; i < this->selectedConns.size(); ++i) {
-
                 if (selectedObject == selectedConns[i]) {
-
-                    // refresh the connections
-                    if (((pythonscript_connection *) conn)->changed()) {
-                        connections[i].clear();
-                        // launch version increment dialog box:
-                        generate_dialog generate(((pythonscript_connection *) conn), src, dst, connections[i], connGenerationMutex, this);
-                        bool retVal = generate.exec();
-                        if (!retVal) {
-                            return;
-                        }
-                        ((pythonscript_connection *) conn)->connections = connections[i];
-                        ((pythonscript_connection *) conn)->setUnchanged(true);
-                    }
+                    this->generatePythonConnections(pyConn, src, dst);
                 }
             }
         }
 
+        ++synapseGeometryVersion;
         repaint();
     }
 }
@@ -1455,6 +1528,9 @@ void glConnectionWidget::refreshAll()
             continue;
         }
     }
+
+    // the layouts, or which connections are at which index, may have changed
+    ++synapseGeometryVersion;
 }
 
 void glConnectionWidget::setConnType(connectionType cType)
@@ -1470,6 +1546,7 @@ void glConnectionWidget::drawLocations(QVector <loc> locs)
     }
     locations.clear();
     this->locations.push_back(locs);
+    ++synapseGeometryVersion;
     this->repaint();
 }
 
@@ -1510,6 +1587,7 @@ void glConnectionWidget::getConnections()
         }
     }
 
+    ++synapseGeometryVersion;
     this->repaint();
 }
 
@@ -1582,16 +1660,9 @@ void glConnectionWidget::sysSelectionChanged(QModelIndex, QModelIndex)
                                     connections.back() = ((pythonscript_connection *) currIn->conn)->connections;
                                 } else {
                                     // generate
-                                    // launch version increment dialog box:
                                     QSharedPointer <population> popSrc = qSharedPointerDynamicCast <population> (currIn->source);
                                     QSharedPointer <population> popDst = qSharedPointerDynamicCast <population> (currIn->destination);
-                                    generate_dialog generate(((pythonscript_connection *) currIn->conn), popSrc, popDst, connections.back(), connGenerationMutex, this);
-                                    bool retVal = generate.exec();
-                                    if (!retVal) {
-                                        continue;
-                                    }
-                                    ((pythonscript_connection *) currIn->conn)->connections = connections.back();
-                                    ((pythonscript_connection *) currIn->conn)->setUnchanged(true);
+                                    this->generatePythonConnections((pythonscript_connection *) currIn->conn, popSrc, popDst);
                                 }
                             }
 
@@ -1639,14 +1710,7 @@ void glConnectionWidget::sysSelectionChanged(QModelIndex, QModelIndex)
                                 connections.back() = ((pythonscript_connection *) currTarg->connectionType)->connections;
                             } else {
                                 // generate
-                                // launch version increment dialog box:
-                                generate_dialog generate(((pythonscript_connection *) currTarg->connectionType), currTarg->proj->source, currTarg->proj->destination, connections.back(), connGenerationMutex, this);
-                                bool retVal = generate.exec();
-                                if (!retVal) {
-                                    return;
-                                }
-                                ((pythonscript_connection *) currTarg->connectionType)->connections = connections.back();
-                                ((pythonscript_connection *) currTarg->connectionType)->setUnchanged(true);
+                                this->generatePythonConnections((pythonscript_connection *) currTarg->connectionType, currTarg->proj->source, currTarg->proj->destination);
                             }
                         }
 
@@ -1672,10 +1736,69 @@ void glConnectionWidget::sysSelectionChanged(QModelIndex, QModelIndex)
         }
     }
 
+    ++synapseGeometryVersion;
+
     // force redraw!
     this->repaint();
 }
 
+void glConnectionWidget::generatePythonConnections(pythonscript_connection * conn, QSharedPointer <population> src, QSharedPointer <population> dst)
+{
+    // The script runs on the pythonConnectionWorker while the dialog shows
+    // its progress; the connections are drawn once pythonConnectionsDone()
+    // picks them up.
+    connect(conn, SIGNAL(connectionsDone()), this, SLOT(pythonConnectionsDone()), Qt::UniqueConnection);
+    // a dialog still open for the connection is for parameters since
+    // changed; closing it cancels its job
+    if (!this->generateDialogs.value(conn).isNull()) {
+        this->generateDialogs[conn]->reject();
+    }
+    generate_dialog * generate = new generate_dialog(conn, src, dst, this);
+    connect(generate, SIGNAL(finished(int)), generate, SLOT(deleteLater()));
+    this->generateDialogs[conn] = generate;
+    generate->show();
+}
+
+void glConnectionWidget::generateConnections()
+{
+    pythonscript_connection * conn = (pythonscript_connection *) sender()->property("ptr").value<void *>();
+    if (conn == NULL || conn->srcPop.isNull() || conn->dstPop.isNull()) {
+        return;
+    }
+    this->generatePythonConnections(conn, conn->srcPop, conn->dstPop);
+}
+
+void glConnectionWidget::pythonConnectionsDone()
+{
+    pythonscript_connection * pyConn = qobject_cast <pythonscript_connection *> (sender());
+    if (pyConn == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < selectedConns.size(); ++i) {
+
+        connection * conn;
+        if (selectedConns[i]->type == synapseObject) {
+            QSharedPointer <synapse> currTarg = qSharedPointerDynamicCast <synapse> (selectedConns[i]);
+            conn = currTarg->connectionType;
+        } else {
+            QSharedPointer<genericInput> currIn = qSharedPointerDynamicCast<genericInput> (selectedConns[i]);
+            conn = currIn->conn;
+        }
+
+        if (pythonGenerator(conn) == pyConn) {
+            if (pyConn->connection_target != NULL) {
+                pyConn->connection_target->getAllData(connections[i]);
+            } else {
+                connections[i] = pyConn->connections;
+            }
+        }
+    }
+
+    ++synapseGeometryVersion;
+    this->repaint();
+}
+
 void glConnectionWidget::connectionDataChanged(QModelIndex, QModelIndex)
 {
     // refetch the connections:
@@ -1762,6 +1885,15 @@ void glConnectionWidget::selectedNrnChanged(int index)
 #if QT_VERSION > QT_VERSION_CHECK(5, 0, 0)
 QImage glConnectionWidget:: renderQImage(int w, int h)
 {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 1, 0)
+    // render in an offscreen context, so the widget need not be on screen
+    offscreenState state;
+    if (this->beginOffscreen(w, h, this->getCamera(), true, state)) {
+        QImage img = this->renderOffscreenFrame(w, h);
+        this->endOffscreen(state);
+        return img;
+    }
+#endif
     // Set the rendering engine to the size of the image to render
     // Also set the format so that the depth buffer will work
     QOpenGLFramebufferObjectFormat format;
@@ -1853,3 +1985,177 @@ QPixmap glConnectionWidget::renderImage(int width, int height)
     imageSaveMode = false;
     return pix;
 }
+
+glCamera glConnectionWidget::getCamera() const
+{
+    glCamera camera;
+    camera.pos = this->pos;
+    camera.rot = this->rot;
+    camera.zoomFactor = this->zoomFactor;
+    camera.orthoView = this->orthoView;
+    return camera;
+}
+
+void glConnectionWidget::setCamera(const glCamera& camera)
+{
+    this->pos = camera.pos;
+    this->rot = camera.rot;
+    this->zoomFactor = camera.zoomFactor;
+    this->orthoView = camera.orthoView;
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 1, 0)
+bool glConnectionWidget::beginOffscreen(int width, int height, const glCamera& camera, bool fullDetail, offscreenState& state)
+{
+    if (offContext == NULL) {
+        QSurfaceFormat format;
+        format.setDepthBufferSize(24);
+        // all but the neurons are drawn with the fixed function pipeline
+        format.setProfile(QSurfaceFormat::CompatibilityProfile);
+        offSurface = new QOffscreenSurface;
+        offSurface->setFormat(format);
+        offSurface->create();
+        offContext = new QOpenGLContext;
+        offContext->setFormat(format);
+        if (!offContext->create()) {
+            DBG() << "could not create an offscreen GL context";
+            delete offContext;
+            offContext = NULL;
+            delete offSurface;
+            offSurface = NULL;
+            return false;
+        }
+    }
+    if (!offContext->makeCurrent(offSurface)) {
+        DBG() << "could not make the offscreen GL context current";
+        return false;
+    }
+    if (offNeurons == NULL) {
+        offNeurons = new neuronRenderer;
+        offNeurons->initialize();
+        offSynapses = new synapseRenderer;
+    }
+
+    state.camera = this->getCamera();
+    state.imageSaveMode = imageSaveMode;
+    state.imageSaveWidth = imageSaveWidth;
+    state.imageSaveHeight = imageSaveHeight;
+
+    this->setCamera(camera);
+    imageSaveMode = true;
+    imageSaveWidth = width;
+    imageSaveHeight = height;
+    offscreenMode = !fullDetail;
+    return true;
+}
+
+QImage glConnectionWidget::renderOffscreenFrame(int width, int height)
+{
+    QOpenGLFramebufferObjectFormat format;
+    format.setAttachment(QOpenGLFramebufferObject::Depth);
+    format.setSamples(4);
+    QOpenGLFramebufferObject fbo(width, height, format);
+    if (!fbo.isValid() || !fbo.bind()) {
+        return QImage();
+    }
+    this->drawScene(*offNeurons, *offSynapses);
+    fbo.release();
+    return fbo.toImage();
+}
+
+void glConnectionWidget::endOffscreen(const offscreenState& state)
+{
+    this->setCamera(state.camera);
+    imageSaveMode = state.imageSaveMode;
+    imageSaveWidth = state.imageSaveWidth;
+    imageSaveHeight = state.imageSaveHeight;
+    offscreenMode = false;
+    offContext->doneCurrent();
+    // hand back to the widget's own context, if it has one yet
+    if (this->isValid()) {
+        this->makeCurrent();
+    }
+}
+
+/*!
+ * Writes one frame of a sequence out as a PNG, on a pool thread, and
+ * releases its slot in the queue of frames waiting to be written.
+ */
+class framePngWriter : public QRunnable
+{
+public:
+    framePngWriter(const QImage& image, const QString& fileName, QSemaphore * pending, QAtomicInt * failures)
+        : image(image), fileName(fileName), pending(pending), failures(failures) {}
+    void run() {
+        if (!this->image.save(this->fileName, "PNG")) {
+            this->failures->ref();
+        }
+        this->pending->release();
+    }
+private:
+    QImage image;
+    QString fileName;
+    QSemaphore * pending;
+    QAtomicInt * failures;
+};
+
+bool glConnectionWidget::renderFrameSequence(const QString& dirName, int width, int height, const glCamera& camera,
+                                             int firstTime, int lastTime, int step, QString& err)
+{
+    QDir dir(dirName);
+    if (!dir.exists() && !dir.mkpath(".")) {
+        err = "Could not create the directory " + dirName;
+        return false;
+    }
+    if (step < 1) {
+        step = 1;
+    }
+
+    offscreenState state;
+    if (!this->beginOffscreen(width, height, camera, false, state)) {
+        err = "Could not create an offscreen GL context";
+        return false;
+    }
+
+    QOpenGLFramebufferObjectFormat format;
+    format.setAttachment(QOpenGLFramebufferObject::Depth);
+    format.setSamples(4);
+    QOpenGLFramebufferObject fbo(width, height, format);
+    if (!fbo.isValid()) {
+        this->endOffscreen(state);
+        err = "Could not create an offscreen framebuffer";
+        return false;
+    }
+
+    // Frames are drawn here, as GL needs the one context, and compressed and
+    // written on the pool. The semaphore bounds the frames held in memory.
+    QThreadPool pool;
+    QSemaphore pending(2 * pool.maxThreadCount());
+    QAtomicInt failures(0);
+    QVector < QVector < QColor > > colours = popColours;
+
+    int frame = 0;
+    for (int t = firstTime; t <= lastTime; t += step, ++frame) {
+        this->fetchLogColours(t);
+        fbo.bind();
+        this->drawScene(*offNeurons, *offSynapses);
+        fbo.release();
+        QImage img = fbo.toImage();
+
+        pending.acquire();
+        QString fileName = dir.absoluteFilePath(QString("frame_%1.png").arg(frame, 6, 10, QChar('0')));
+        pool.start(new framePngWriter(img, fileName, &pending, &failures));
+    }
+    pool.waitForDone();
+
+    popColours = colours;
+    ++popColoursVersion;
+    this->endOffscreen(state);
+
+    if (failures.load() > 0) {
+        err = QString::number(failures.load()) + " of " + QString::number(frame) + " frames could not be written";
+        return false;
+    }
+    return true;
+}
+#endif
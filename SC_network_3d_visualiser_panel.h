@@ -27,6 +27,9 @@
 
 #include "globalHeader.h"
 #include "SC_logged_data.h"
+#include "SC_network_3d_neuron_renderer.h"
+#include "SC_network_3d_synapse_renderer.h"
+#include <QPointer>
 
 class RNG
 {
@@ -62,11 +65,26 @@ struct loc3f {
     float z;
 };
 
+/*!
+ * The view of the 3D visualiser: its pan, rotation, zoom and projection.
+ */
+struct glCamera {
+    QPointF pos;
+    QPointF rot;
+    float zoomFactor;
+    bool orthoView;
+};
+
+class QOffscreenSurface;
+class QOpenGLContext;
+class generate_dialog;
+
 class glConnectionWidget : public QGLWidget
 {
     Q_OBJECT
 public:
     explicit glConnectionWidget(nl_rootdata * data, QWidget *parent = 0);
+    ~glConnectionWidget();
     QVector <QSharedPointer <population> > selectedPops;
     QVector < popLocs> pops;
     QVector <QSharedPointer<systemObject> > selectedConns;
@@ -83,11 +101,46 @@ public:
     void clear();
     QPixmap renderImage(int, int);
     void addLogs(QVector<logData *> *logs);
+    /*!
+     * Show every population of the model, coloured from logs (those of one
+     * run of an experiment), in place of the populations chosen in the
+     * tree view. For rendering a model with no GUI, as --batch does.
+     */
+    void showModel(QVector<logData *> *logs);
     void refreshAll();
+    glCamera getCamera() const;
+    void setCamera(const glCamera& camera);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 1, 0)
+    /*!
+     * Render the log times firstTime to lastTime, every step, to
+     * dirName/frame_000000.png and on, seen from camera. The frames are
+     * drawn in an offscreen GL context, which needs no window (so works
+     * headless, e.g. with QT_QPA_PLATFORM=offscreen on Mesa), and written
+     * out by a pool of threads while the next are drawn. Returns false,
+     * with a message in err, on failure.
+     */
+    bool renderFrameSequence(const QString& dirName, int width, int height, const glCamera& camera,
+                             int firstTime, int lastTime, int step, QString& err);
+#endif
+
+private slots:
+    //! Draw the connections of the sending pythonscript_connection
+    void pythonConnectionsDone();
 
 private:
+    /*!
+     * Generate conn's connections without waiting for them, showing the
+     * job's progress in a modeless generate_dialog.
+     */
+    void generatePythonConnections(pythonscript_connection * conn, QSharedPointer <population> src, QSharedPointer <population> dst);
+    //! The dialog of each connection being generated, so a new job replaces it
+    QMap <pythonscript_connection *, QPointer <generate_dialog> > generateDialogs;
     void drawNeuron(GLfloat, int, int, QColor);
     void setupView();
+    //! Draw everything bar the labels, with the given renderers
+    void drawScene(neuronRenderer& nrn, synapseRenderer& syn);
+    //! Colour the neurons from the logs at time
+    void fetchLogColours(int time);
     QString currentObjectName;
     QAbstractTableModel * model;
     QAbstractItemModel * sysModel;
@@ -117,6 +170,33 @@ private:
     QTimer timer;
     bool orthoView;
     bool repaintAllowed;
+    //! Draws the neurons from GL buffers
+    neuronRenderer neurons;
+    //! Draws the explicit connection lines from GL buffers
+    synapseRenderer synapses;
+    //! Changed whenever the layouts or the connection lists change in place
+    int synapseGeometryVersion;
+    //! Changed whenever popColours change
+    int popColoursVersion;
+    //! True while drawing offscreen frames, which use the normal level of detail
+    bool offscreenMode;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 1, 0)
+    //! What beginOffscreen() changed, for endOffscreen() to put back
+    struct offscreenState {
+        glCamera camera;
+        bool imageSaveMode;
+        int imageSaveWidth;
+        int imageSaveHeight;
+    };
+    bool beginOffscreen(int width, int height, const glCamera& camera, bool fullDetail, offscreenState& state);
+    QImage renderOffscreenFrame(int width, int height);
+    void endOffscreen(const offscreenState& state);
+    QOffscreenSurface * offSurface;
+    QOpenGLContext * offContext;
+    //! Renderers for the offscreen context, which has its own buffers
+    neuronRenderer * offNeurons;
+    synapseRenderer * offSynapses;
+#endif
 #if QT_VERSION > QT_VERSION_CHECK(5, 0, 0)
     QImage renderQImage(int w, int h);
 #endif
@@ -147,8 +227,11 @@ public slots:
     void selectedNrnChanged(int);
     void updateLogDataTime(int index);
     void updateLogData();
+    void logRowsAppended(qint64 firstRow, qint64 endRow);
     void toggleOrthoView(bool);
     void allowRepaint();
+    //! Generate the connections of the pythonscript_connection in the sender's "ptr" property
+    void generateConnections();
 
 protected:
     void initializeGL();
@@ -6,6 +6,12 @@
 #include "SC_versioncontrol.h"
 #include "EL_experiment.h"
 #include "SC_systemmodel.h"
+#include "NL_connection.h"
+#include "NL_projection_and_synapse.h"
+#include "NL_genericinput.h"
+#include "SC_python_connection_pool.h"
+#include "SC_export_cache.h"
+#include "SC_error_reporter.h"
 
 projectObject::projectObject(QObject *parent) :
     QObject(parent)
@@ -171,9 +177,7 @@ bool projectObject::open_project(QString fileName)
 bool projectObject::save_project(QString fileName, nl_rootdata * data)
 {
     if (!fileName.contains(".")) {
-        QMessageBox msgBox;
-        msgBox.setText("Project file needs .proj suffix.");
-        msgBox.exec();
+        errorReporter::report("Project file needs .proj suffix.");
         return false;
     }
     DBG() << "save_project ('" << fileName << "', rootData*)";
@@ -192,18 +196,28 @@ bool projectObject::save_project(QString fileName, nl_rootdata * data)
     // property/explicitDataBinaryFiles.
     //
     // However, we DO remove old connection binary files (but not
-    // explicitData binary files).
-    project_dir.setNameFilters(QStringList() << "conn*.bin");
-    QStringList files = project_dir.entryList(QDir::Files);
-    for (int i = 0; i < files.size(); ++i) {
-        // delete
-        project_dir.remove(files[i]);
-        // and remove from version control
-        if (this->version.isModelUnderVersion()) {
-            this->version.removeFromVersion(files[i]);
+    // explicitData binary files). When exporting into a run directory
+    // they are kept, so that those which haven't changed needn't be
+    // written again, and the stale ones are removed once everything has
+    // been exported.
+    exportCache * cache = exportCache::forDir(project_dir);
+    if (cache == NULL) {
+        project_dir.setNameFilters(QStringList() << "conn*.bin");
+        QStringList files = project_dir.entryList(QDir::Files);
+        for (int i = 0; i < files.size(); ++i) {
+            // delete
+            project_dir.remove(files[i]);
+            // and remove from version control
+            if (this->version.isModelUnderVersion()) {
+                this->version.removeFromVersion(files[i]);
+            }
         }
     }
 
+    // regenerate any out of date Python connectivity in parallel, before the
+    // network is written
+    this->regenerate_connections(data);
+
     // sync project
     copy_back_data(data);
 
@@ -243,7 +257,17 @@ bool projectObject::save_project(QString fileName, nl_rootdata * data)
     for (int i = 0; i < this->additionalFiles.size(); ++i) {
         // copy additionalFiles[i] to project_dir / additionalFiles[i].fileName()
         QFileInfo fileInfo(this->additionalFiles[i]);
-        QFile::copy(additionalFiles[i], project_dir.absolutePath() + QDir::separator() + fileInfo.fileName());
+        QString dst = project_dir.absolutePath() + QDir::separator() + fileInfo.fileName();
+        if (cache != NULL) {
+            exportCache::copyFile(additionalFiles[i], dst, fileInfo.size());
+        } else {
+            QFile::copy(additionalFiles[i], dst);
+        }
+    }
+
+    // anything left in a run directory from an earlier export is stale
+    if (cache != NULL) {
+        cache->removeUnexported();
     }
 
     // store the new file name
@@ -261,6 +285,71 @@ bool projectObject::save_project(QString fileName, nl_rootdata * data)
     return true;
 }
 
+/*!
+ * Add the Python generator of conn, if it has one which is out of date, to stale
+ */
+static void addStaleGenerator(connection * conn, QVector <pythonscript_connection *> &stale)
+{
+    if (conn == NULL) {
+        return;
+    }
+    pythonscript_connection * pyConn = NULL;
+    if (conn->type == Python) {
+        pyConn = dynamic_cast <pythonscript_connection *> (conn);
+    } else if (conn->generator) {
+        pyConn = dynamic_cast <pythonscript_connection *> (conn->generator);
+    }
+    if (pyConn == NULL || pyConn->srcPop.isNull() || pyConn->dstPop.isNull() || stale.contains(pyConn)) {
+        return;
+    }
+    pyConn->refreshScriptText();
+    if (pyConn->changed()) {
+        stale.push_back(pyConn);
+    }
+}
+
+static void addStaleGenerators(QSharedPointer <ComponentInstance> component, QVector <pythonscript_connection *> &stale)
+{
+    if (component.isNull()) {
+        return;
+    }
+    for (int i = 0; i < component->inputs.size(); ++i) {
+        addStaleGenerator(component->inputs[i]->conn, stale);
+    }
+}
+
+bool projectObject::regenerate_connections(nl_rootdata * data)
+{
+    QVector <pythonscript_connection *> stale;
+    for (int i = 0; i < data->populations.size(); ++i) {
+        QSharedPointer <population> pop = data->populations[i];
+        addStaleGenerators(pop->neuronType, stale);
+        for (int j = 0; j < pop->projections.size(); ++j) {
+            QSharedPointer <projection> proj = pop->projections[j];
+            for (int k = 0; k < proj->synapses.size(); ++k) {
+                QSharedPointer <synapse> syn = proj->synapses[k];
+                addStaleGenerator(syn->connectionType, stale);
+                addStaleGenerators(syn->weightUpdateCmpt, stale);
+                addStaleGenerators(syn->postSynapseCmpt, stale);
+            }
+        }
+    }
+    if (stale.isEmpty()) {
+        return true;
+    }
+
+    QWidget * parent = data->main;
+    pythonConnectionPool pool;
+    QString errs;
+    if (!pool.regenerate(stale, errs, parent)) {
+        // anything still out of date is regenerated in-process as the
+        // network is written, which reports the errors
+        DBG() << "Parallel connection generation failed:" << errs;
+        return false;
+    }
+    return true;
+}
+
 bool projectObject::import_network(QString fileName, cursorType cursorPos)
 {
     DBG() << "projectObject::import_network(" << fileName << ")";
@@ -389,9 +478,7 @@ bool projectObject::load_project_file(QString fileName)
     // open the file
     QFile file(fileName);
     if (!file.open(QIODevice::ReadOnly)) {
-        QMessageBox msgBox;
-        msgBox.setText("Could not open the project file");
-        msgBox.exec();
+        errorReporter::report("Could not open the project file");
         return false;
     }
 
@@ -599,23 +686,17 @@ bool projectObject::save_project_file(QString fileName)
 {
     // complain if there's no extension (client code should correctly set fileName)
     if (!fileName.contains(".")) {
-        QMessageBox msgBox;
-        msgBox.setText("Project file needs .proj suffix.");
-        msgBox.exec();
+        errorReporter::report("Project file needs .proj suffix.");
         return false;
     }
 
-    QFile file(fileName);
-    if (!file.open(QIODevice::WriteOnly)) {
-        QMessageBox msgBox;
-        msgBox.setText("Could not create the project file '" + fileName + "'");
-        msgBox.exec();
-        return false;
-    }
+    // written out at the end (unless it's unchanged in a run directory)
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
 
     // get a streamwriter
     QXmlStreamWriter * writer = new QXmlStreamWriter;
-    writer->setDevice(&file);
+    writer->setDevice(&buffer);
 
     // write elements
     writer->writeStartDocument();
@@ -673,10 +754,16 @@ bool projectObject::save_project_file(QString fileName)
     }
 
     writer->writeEndElement(); // SpineCreatorProject
+    delete writer;
+
+    if (!exportCache::writeFile(fileName, buffer.data())) {
+        errorReporter::report("Could not create the project file '" + fileName + "'");
+        return false;
+    }
 
     // add to version control
     if (this->version.isModelUnderVersion()) {
-        this->version.addToVersion(file.fileName());
+        this->version.addToVersion(fileName);
     }
 
     return true;
@@ -839,29 +926,29 @@ void projectObject::saveComponent(QString fileName, QDir project_dir, QSharedPoi
     }
 
     QString fname = project_dir.absoluteFilePath(fileName);
-    QFile file(fname);
-    if (!file.open(QIODevice::WriteOnly)) {
-        addError("saveComponent: Error creating file for '" + fname + "' - is there sufficient disk space?");
-        return;
-    }
 
     this->doc.setContent(QString(""));
 
     // get the 9ML description
     component->write(&this->doc);
 
-    // write out to file
-    QTextStream tsFromFile(&file );
+    // write out to file (unless it's unchanged in a run directory)
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    QTextStream tsFromFile(&buffer);
     tsFromFile << this->doc.toString();
     tsFromFile.flush();
+    if (!exportCache::writeFile(fname, buffer.data())) {
+        addError("saveComponent: Error creating file for '" + fname + "' - is there sufficient disk space?");
+        this->doc.clear();
+        return;
+    }
 
     // add to version control
     if (this->version.isModelUnderVersion()) {
-        this->version.addToVersion(file.fileName());
+        this->version.addToVersion(fname);
     }
 
-    file.close();
-
     // store path for easy access
     component->filePath = project_dir.absoluteFilePath(fileName);
 
@@ -942,29 +1029,28 @@ void projectObject::saveLayout(QString fileName, QDir project_dir, QSharedPointe
         fileName.append(".xml");
     }
 
-    QFile file(project_dir.absoluteFilePath(fileName));
-    if (!file.open(QIODevice::WriteOnly)) {
-        addError("Error creating file for '" + fileName + "' - is there sufficient disk space?");
-        return;
-    }
-
     this->doc.setContent(QString(""));
 
     // get the 9ML description
     layout->write(&this->doc);
 
-    // write out to file
-    QTextStream tsFromFile(&file);
+    // write out to file (unless it's unchanged in a run directory)
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    QTextStream tsFromFile(&buffer);
     tsFromFile << this->doc.toString();
     tsFromFile.flush();
+    if (!exportCache::writeFile(project_dir.absoluteFilePath(fileName), buffer.data())) {
+        addError("Error creating file for '" + fileName + "' - is there sufficient disk space?");
+        this->doc.clear();
+        return;
+    }
 
     // add to version control
     if (this->version.isModelUnderVersion()) {
-        this->version.addToVersion(file.fileName());
+        this->version.addToVersion(project_dir.absoluteFilePath(fileName));
     }
 
-    file.close();
-
     // store path for easy access
     layout->filePath = project_dir.absoluteFilePath(fileName);
 
@@ -1204,11 +1290,10 @@ void projectObject::loadNetwork(QString fileName, QDir project_dir, bool isProje
 
 void projectObject::saveNetwork(QString fileName, QDir projectDir)
 {
-    QFile fileModel(projectDir.absoluteFilePath(fileName));
-    if (!fileModel.open(QIODevice::WriteOnly)) {
-        addError("Error creating Network file - is there sufficient disk space?");
-        return;
-    }
+    // the network is written into a buffer first, so that an unchanged
+    // network isn't rewritten in a run directory
+    QBuffer fileModel;
+    fileModel.open(QIODevice::WriteOnly);
 
     // use stream writing for model UL file
     QXmlStreamWriter xmlOut;
@@ -1251,14 +1336,18 @@ void projectObject::saveNetwork(QString fileName, QDir projectDir)
     }
 
     xmlOut.writeEndDocument();
+    fileModel.close();
+
+    if (!exportCache::writeFile(projectDir.absoluteFilePath(fileName), fileModel.data())) {
+        addError("Error creating Network file - is there sufficient disk space?");
+        return;
+    }
 
     // add to version control
     if (this->version.isModelUnderVersion()) {
-        this->version.addToVersion(fileModel.fileName());
+        this->version.addToVersion(projectDir.absoluteFilePath(fileName));
     }
 
-    fileModel.close();
-
     // Clean up stale explicit data binary files, by searching through
     // xmlOut and comparing with the files in the model dir.
     this->cleanUpStaleExplicitData(fileName, projectDir);
@@ -1382,11 +1471,8 @@ bool projectObject::doesExperimentExist (experiment* e)
 void projectObject::saveExperiment(QString fileName, QDir project_dir, experiment * expt)
 {
     QString absPath = project_dir.absoluteFilePath(fileName);
-    QFile file (absPath);
-    if (!file.open(QIODevice::WriteOnly)) {
-        addError("Error creating file '" + absPath + "' - is there sufficient disk space?");
-        return;
-    }
+    QBuffer file;
+    file.open(QIODevice::WriteOnly);
 
     // use stream writer
     QXmlStreamWriter * xmlOutExpt = new QXmlStreamWriter;
@@ -1397,6 +1483,10 @@ void projectObject::saveExperiment(QString fileName, QDir project_dir, experimen
     delete xmlOutExpt;
 
     file.close();
+    if (!exportCache::writeFile(absPath, file.data())) {
+        addError("Error creating file '" + absPath + "' - is there sufficient disk space?");
+        return;
+    }
 
     // add to version control
     if (this->version.isModelUnderVersion()) {
@@ -1554,11 +1644,7 @@ bool projectObject::printWarnings(QString title)
     // display warnings:
     if (!warns.isEmpty()) {
         // display warnings
-        QMessageBox msgBox;
-        msgBox.setText("<P><b>" + title + "</b></P>" + warns);
-        msgBox.setIcon(QMessageBox::Critical);
-        msgBox.setTextFormat(Qt::RichText);
-        msgBox.exec();
+        errorReporter::report("<P><b>" + title + "</b></P>" + warns, QMessageBox::Critical, Qt::RichText);
     }
 
     return true;
@@ -1596,11 +1682,7 @@ bool projectObject::printErrors(QString title)
         // Display errors. (Seb has observed one hang here where the
         // msgBox failed to show when there was a project error.
         DBG() << "Errors in SC_projectobject.cpp: " << errors;
-        QMessageBox msgBox;
-        msgBox.setText("<P><b>" + title + "</b></P>" + errors);
-        msgBox.setIcon(QMessageBox::Critical);
-        msgBox.setTextFormat(Qt::RichText);
-        msgBox.exec();
+        errorReporter::report("<P><b>" + title + "</b></P>" + errors, QMessageBox::Critical, Qt::RichText);
     }
 
     return true;
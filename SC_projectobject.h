@@ -35,6 +35,13 @@ public:
     bool open_project(QString);
     bool save_project(QString, nl_rootdata *);
 
+    /*!
+     * Regenerate every out of date Python script connection in the network,
+     * running the scripts in parallel, and apply the results. Returns false
+     * if any could not be generated; those are left out of date.
+     */
+    bool regenerate_connections(nl_rootdata *);
+
     bool import_network(QString, cursorType);
 
     void import_component(QString);
@@ -27,9 +27,10 @@
 #include "NL_population.h"
 #include "NL_connection.h"
 #include "SC_network_3d_visualiser_panel.h"
+#include "SC_python_connection_worker.h"
 
 
-generate_dialog::generate_dialog(pythonscript_connection * currConn, QSharedPointer <population> src, QSharedPointer <population> dst, QVector < conn > &conns, QMutex * mutex, QWidget *parent) :
+generate_dialog::generate_dialog(pythonscript_connection * currConn, QSharedPointer <population> src, QSharedPointer <population> dst, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::generate_dialog)
 {
@@ -40,101 +41,74 @@ generate_dialog::generate_dialog(pythonscript_connection * currConn, QSharedPoin
     // generating connectivity
 
     this->currConn = currConn;
+    this->jobId = 0;
     currConn->srcPop = src;
     currConn->dstPop = dst;
-    currConn->conns = &conns;
-    currConn->mutex = mutex;
 
+    ui->progressBar->setRange(0, 100);
+    ui->progressBar->setValue(0);
 
+    pythonConnectionWorker * worker = pythonConnectionWorker::instance();
+    connect(worker, SIGNAL(progress(int,int)), this, SLOT(jobProgress(int,int)));
+    connect(worker, SIGNAL(generated(int,bool)), this, SLOT(jobGenerated(int,bool)));
 
-    // get rid of the dialog if we are successful
-    QTimer * timer = new QTimer;
-    timer->setSingleShot(true);
-    connect(timer, SIGNAL(timeout()), this, SLOT(doPython()));
-    timer->start(100);
-
-
-    //workerThread = new QThread(this);
-
-    //connect(workerThread, SIGNAL(started()), currConn, SLOT(generate_connections()));
-    //connect(workerThread, SIGNAL(finished()), this, SLOT(moveFromThread()));
-    //connect(currConn, SIGNAL(connectionsDone()), this, SLOT(moveFromThread()));
+    // queue the script once the dialog is showing
+    QTimer::singleShot(0, this, SLOT(doPython()));
+}
 
-    //connect(currConn, SIGNAL(progress(int)), ui->progressBar, SLOT(setValue(int)));
-    //if (parent != NULL)
-    //    connect(currConn, SIGNAL(progress(int)), ((glConnectionWidget *)parent), SLOT(redraw()));
+void generate_dialog::doPython() {
 
-    //currConn->moveToThread(workerThread);
+    pythonscript_connection * currConnPy = dynamic_cast <pythonscript_connection *> (currConn);
+    CHECK_CAST(currConnPy)
 
-    //workerThread->start();
+    this->jobId = pythonConnectionWorker::instance()->enqueue(currConnPy);
+    if (this->jobId == 0) {
+        // the layouts could not be generated
+        ui->errors->setText(currConnPy->errorLog);
+    }
+}
 
+void generate_dialog::jobProgress(int id, int percent)
+{
+    if (id == this->jobId) {
+        ui->progressBar->setValue(percent);
+    }
 }
 
-void generate_dialog::doPython() {
+void generate_dialog::jobGenerated(int id, bool ok)
+{
+    if (id != this->jobId) {
+        return;
+    }
+    this->jobId = 0;
 
     pythonscript_connection * currConnPy = dynamic_cast <pythonscript_connection *> (currConn);
     CHECK_CAST(currConnPy)
 
-    currConnPy->generate_connections();
-
-    if (!currConnPy->errorLog.isEmpty()) {
-        ui->errors->setText(currConnPy->errorLog);
+    if (ok) {
+        // the connections and weights have been applied to the connection
+        ui->progressBar->setValue(100);
+        this->accept();
     } else if (!currConnPy->pythonErrors.isEmpty()) {
         ui->errors->setText(currConnPy->pythonErrors);
     } else {
-        // move the weights across
-        ParameterInstance * par = currConnPy->getPropPointer();
-        if (par && currConnPy->hasWeight) {
-            par->currType = ExplicitList;
-            par->value = currConnPy->weights;
-            par->indices.clear();
-            for (int i = 0; i < currConnPy->weights.size(); ++i) {
-                par->indices.push_back(i);
-            }
-        }
-        this->accept();
+        ui->errors->setText("Connection generation did not complete");
     }
-
 }
 
-void generate_dialog::moveFromThread() {
-    //currConn->moveToThread(QApplication::instance()->thread());
-    workerThread->exit();
-    // see if errors:
-    if (currConn->type == Python) {
-        pythonscript_connection * currConnPy = dynamic_cast <pythonscript_connection *> (currConn);
-        CHECK_CAST(currConnPy)
-        if (!currConnPy->errorLog.isEmpty()) {
-            ui->errors->setText(currConnPy->errorLog);
-        } else if (!currConnPy->pythonErrors.isEmpty()) {
-            ui->errors->setText(currConnPy->pythonErrors);
-        } else {
-            // move the weights across
-            for (int i = 0; i < currConnPy->srcPop->projections.size(); ++i) {
-                QSharedPointer <projection> proj = currConnPy->srcPop->projections[i];
-                for (int j = 0; j < proj->synapses.size(); ++j) {
-                    QSharedPointer <synapse> syn = proj->synapses[j];
-                    // if we have found the connection
-                    if (syn->connectionType == currConnPy) {
-                        // now we know which weight update we have to look at
-                        for (int k = 0; k < syn->weightUpdateCmpt->ParameterList.size(); ++k) {
-                            if (syn->weightUpdateCmpt->ParameterList[k]->name == currConnPy->weightProp) {
-                                // found the weight - now to alter it
-                                ParameterInstance * par = syn->weightUpdateCmpt->ParameterList[k];
-                                par->currType = ExplicitList;
-                                par->value = currConnPy->weights;
-                            }
-                        }
-                    }
-                }
-            }
-            this->accept();
-        }
+void generate_dialog::reject()
+{
+    if (this->jobId != 0) {
+        pythonConnectionWorker::instance()->cancel(this->jobId);
+        this->jobId = 0;
     }
-
+    QDialog::reject();
 }
 
 generate_dialog::~generate_dialog()
 {
+    if (this->jobId != 0) {
+        pythonConnectionWorker::instance()->cancel(this->jobId);
+    }
     delete ui;
 }
@@ -35,24 +35,31 @@ class generate_dialog;
 /*!
  * \brief The generate_dialog class alerts the user that python cnnectivity is being generated
  *
+ * The script is queued on the pythonConnectionWorker, so the GUI keeps
+ * running while it does. The dialog is shown modeless; it shows the progress
+ * of the job, and Cancel stops it. The connection emits connectionsDone()
+ * once the job's output has been applied to it.
  */
 class generate_dialog : public QDialog
 {
     Q_OBJECT
     
 public:
-    explicit generate_dialog(kernel_connection * currConn, QSharedPointer <population>src, QSharedPointer <population>dst, QVector <conn> &conns, QMutex * mutex, QWidget *parent = 0);
-    explicit generate_dialog(pythonscript_connection * currConn, QSharedPointer <population>src, QSharedPointer <population>dst, QVector <conn> &conns, QMutex * mutex, QWidget *parent = 0);
+    explicit generate_dialog(pythonscript_connection * currConn, QSharedPointer <population>src, QSharedPointer <population>dst, QWidget *parent = 0);
     ~generate_dialog();
     
 private:
     Ui::generate_dialog *ui;
     connection * currConn;
-    QThread *workerThread;
+    int jobId;
 
 public slots:
-    void moveFromThread();
     void doPython();
+    void reject();
+
+private slots:
+    void jobProgress(int id, int percent);
+    void jobGenerated(int id, bool ok);
 };
 
 #endif // GENERATE_DIALOG_H
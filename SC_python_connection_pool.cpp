@@ -0,0 +1,420 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifdef _DEBUG
+  #undef _DEBUG
+  #include <Python.h>
+  #define _DEBUG
+#else
+  #include <Python.h>
+#endif
+
+#include "SC_python_connection_pool.h"
+#include "SC_python_connection_worker.h"
+#include "NL_connection.h"
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+/*
+ * The runner, written to each job's directory as runner.py and run as
+ * "python runner.py <dir>". It reads args.json, src.bin and dst.bin, calls
+ * connectionFunc, and writes out.bin: a header of the number of connections
+ * (int64) and whether delays and weights follow (2 x int32), then the src
+ * and dst (int32), delay (float32) and weight (float64) columns. Progress is
+ * reported on stdout, and errors on stderr. It runs under Python 2.7 and 3.
+ */
+static const char * runnerSource =
+        "import sys, json, struct, array, traceback\n"
+        "d = sys.argv[1]\n"
+        "cfg = json.load(open(d + '/args.json'))\n"
+        "def spinecreator_progress(fraction):\n"
+        "    sys.stdout.write('progress %f\\n' % fraction)\n"
+        "    sys.stdout.flush()\n"
+        "def readLocs(name, n):\n"
+        "    a = array.array('f')\n"
+        "    f = open(d + '/' + name, 'rb')\n"
+        "    if n > 0:\n"
+        "        a.fromfile(f, 3 * n)\n"
+        "    f.close()\n"
+        "    if cfg['buffers'] and sys.version_info >= (3, 3):\n"
+        "        return memoryview(a).cast('B').cast('f', [n, 3])\n"
+        "    return [(a[3*i], a[3*i+1], a[3*i+2]) for i in range(n)]\n"
+        "try:\n"
+        "    g = {'__name__': '__main__', 'spinecreator_progress': spinecreator_progress}\n"
+        "    exec(compile(open(d + '/script.py').read(), '<string>', 'exec'), g)\n"
+        "    args = [readLocs('src.bin', cfg['nsrc']), readLocs('dst.bin', cfg['ndst'])] + cfg['pars']\n"
+        "    out = g['connectionFunc'](*args)\n"
+        "    delay = None\n"
+        "    weight = None\n"
+        "    if isinstance(out, list):\n"
+        "        n = len(out)\n"
+        "        src = array.array('i', [int(c[0]) for c in out])\n"
+        "        dst = array.array('i', [int(c[1]) for c in out])\n"
+        "        if cfg['delay'] and n > 0 and len(out[0]) > 2:\n"
+        "            delay = array.array('f', [float(c[2]) for c in out])\n"
+        "        if cfg['weight'] and n > 0 and len(out[0]) > 3:\n"
+        "            weight = array.array('d', [float(c[3]) for c in out])\n"
+        "    else:\n"
+        "        import numpy\n"
+        "        if isinstance(out, tuple):\n"
+        "            cols = [numpy.asarray(c).ravel() for c in out[:4]]\n"
+        "        else:\n"
+        "            a = numpy.asarray(out)\n"
+        "            cols = [a[:, j] for j in range(min(a.shape[1], 4))]\n"
+        "        n = len(cols[0])\n"
+        "        src = numpy.ascontiguousarray(cols[0], dtype=numpy.int32)\n"
+        "        dst = numpy.ascontiguousarray(cols[1], dtype=numpy.int32)\n"
+        "        if cfg['delay'] and len(cols) > 2:\n"
+        "            delay = numpy.ascontiguousarray(cols[2], dtype=numpy.float32)\n"
+        "        if cfg['weight'] and len(cols) > 3:\n"
+        "            weight = numpy.ascontiguousarray(cols[3], dtype=numpy.float64)\n"
+        "    f = open(d + '/out.bin', 'wb')\n"
+        "    f.write(struct.pack('=qii', n, delay is not None, weight is not None))\n"
+        "    for c in (src, dst, delay, weight):\n"
+        "        if c is not None:\n"
+        "            c.tofile(f)\n"
+        "    f.close()\n"
+        "except Exception:\n"
+        "    traceback.print_exc()\n"
+        "    sys.exit(1)\n";
+
+pythonConnectionPool::pythonConnectionPool(QObject * parent) :
+    QObject(parent),
+    nextJob(0),
+    running(0),
+    maxProcesses(qMax(1, QThread::idealThreadCount())),
+    cancelled(false),
+    runner(runnerSource),
+    progressDialog(NULL)
+{
+}
+
+pythonConnectionPool::~pythonConnectionPool()
+{
+    for (int i = 0; i < this->jobs.size(); ++i) {
+        delete this->jobs[i].process;
+        delete this->jobs[i].dir;
+    }
+}
+
+QString pythonConnectionPool::pythonProgram()
+{
+    QSettings settings;
+    QString program = settings.value("python/programname", "").toString();
+    if (program.isEmpty()) {
+#ifdef Q_OS_WIN
+        program = "python";
+#else
+        program = QString("python%1.%2").arg(PY_MAJOR_VERSION).arg(PY_MINOR_VERSION);
+#endif
+    }
+    return program;
+}
+
+void pythonConnectionPool::setMaxProcesses(int n)
+{
+    this->maxProcesses = qMax(1, n);
+}
+
+bool pythonConnectionPool::regenerate(const QVector <pythonscript_connection *> &conns, QString &errs, QWidget * progressParent)
+{
+    QTime qtimer;
+    qtimer.start();
+
+    errs.clear();
+    this->jobs.clear();
+    this->nextJob = 0;
+    this->running = 0;
+    this->cancelled = false;
+
+    // prepare every job up front, on the GUI thread
+    for (int i = 0; i < conns.size(); ++i) {
+        poolJob p;
+        p.job = QSharedPointer <pythonConnectionJob> (new pythonConnectionJob());
+        p.dir = NULL;
+        p.process = NULL;
+        p.progress = 0;
+        p.done = false;
+        if (!conns[i]->prepareGeneration(*p.job)) {
+            errs += conns[i]->errorLog + "\n";
+            continue;
+        }
+        p.dir = new QTemporaryDir();
+        if (!p.dir->isValid() || !this->writeInputs(p)) {
+            errs += "Could not write the inputs for connection script '" + conns[i]->scriptName + "'\n";
+            delete p.dir;
+            continue;
+        }
+        this->jobs.push_back(p);
+    }
+    if (this->jobs.isEmpty()) {
+        return errs.isEmpty();
+    }
+
+    if (progressParent != NULL || qobject_cast <QApplication *> (QCoreApplication::instance())) {
+        this->progressDialog = new QProgressDialog("Generating connections using Python...", "Cancel",
+                                                   0, this->jobs.size() * 100, progressParent);
+        this->progressDialog->setWindowModality(Qt::WindowModal);
+        this->progressDialog->setMinimumDuration(500);
+        connect(this->progressDialog, SIGNAL(canceled()), this, SLOT(cancel()));
+    }
+
+    DBG() << "Running" << this->jobs.size() << "connection scripts," << this->maxProcesses << "at a time";
+    this->startNext();
+    if (this->running > 0) {
+        this->loop.exec();
+    }
+
+    delete this->progressDialog;
+    this->progressDialog = NULL;
+
+    // apply everything that succeeded in one go
+    bool ok = !this->cancelled && errs.isEmpty();
+    for (int i = 0; i < this->jobs.size(); ++i) {
+        pythonConnectionJob * job = this->jobs[i].job.data();
+        if (this->cancelled || job->conn.isNull()) {
+            continue;
+        }
+        if (!job->conn->applyGeneration(*job)) {
+            errs += job->conn->scriptName + ": " + job->errors + "\n";
+            ok = false;
+        }
+    }
+    if (this->cancelled) {
+        errs += "Connection generation was cancelled\n";
+    }
+
+    DBG() << "Regenerated" << this->jobs.size() << "connections in" << qtimer.elapsed() << "ms";
+    return ok;
+}
+
+bool pythonConnectionPool::writeInputs(poolJob &p)
+{
+    const pythonConnectionJob &job = *p.job;
+    QDir dir(p.dir->path());
+
+    QFile script(dir.filePath("script.py"));
+    QFile runnerFile(dir.filePath("runner.py"));
+    if (!script.open(QIODevice::WriteOnly) || !runnerFile.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    script.write(job.scriptText.toUtf8());
+    runnerFile.write(this->runner.toUtf8());
+
+    // the locations as packed float x,y,z, just as they are held
+    QFile src(dir.filePath("src.bin"));
+    QFile dst(dir.filePath("dst.bin"));
+    if (!src.open(QIODevice::WriteOnly) || !dst.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    src.write((const char *) job.srcLocs.constData(), job.srcLocs.size() * sizeof(loc));
+    dst.write((const char *) job.dstLocs.constData(), job.dstLocs.size() * sizeof(loc));
+
+    QJsonArray pars;
+    for (int i = 0; i < job.parNames.size(); ++i) {
+        if (job.parNames[i].endsWith("_string")) {
+            pars.append(job.parText[i]);
+        } else {
+            pars.append(job.parValues[i]);
+        }
+    }
+    QJsonObject args;
+    args["nsrc"] = job.srcLocs.size();
+    args["ndst"] = job.dstLocs.size();
+    args["pars"] = pars;
+    args["delay"] = job.hasDelay;
+    args["weight"] = job.hasWeight;
+    args["buffers"] = job.hasBuffers;
+
+    QFile argsFile(dir.filePath("args.json"));
+    if (!argsFile.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    return argsFile.write(QJsonDocument(args).toJson()) > 0;
+}
+
+bool pythonConnectionPool::readOutputs(poolJob &p)
+{
+    pythonConnectionJob &job = *p.job;
+
+    QFile out(QDir(p.dir->path()).filePath("out.bin"));
+    if (!out.open(QIODevice::ReadOnly)) {
+        job.errors = "Python Error: the script produced no output";
+        return false;
+    }
+    const qint64 headerSize = sizeof(qint64) + 2 * sizeof(qint32);
+    const uchar * data = out.size() >= headerSize ? out.map(0, out.size()) : NULL;
+    if (data == NULL) {
+        job.errors = "Python Error: the script output could not be read";
+        return false;
+    }
+
+    qint64 n;
+    qint32 hasDelay;
+    qint32 hasWeight;
+    memcpy(&n, data, sizeof(qint64));
+    memcpy(&hasDelay, data + sizeof(qint64), sizeof(qint32));
+    memcpy(&hasWeight, data + sizeof(qint64) + sizeof(qint32), sizeof(qint32));
+    qint64 expected = headerSize + n * (2 * sizeof(qint32) + (hasDelay ? sizeof(float) : 0) + (hasWeight ? sizeof(double) : 0));
+    if (n < 0 || out.size() != expected) {
+        job.errors = "Python Error: the script output is truncated";
+        return false;
+    }
+
+    // scatter the columns into the connection list
+    const uchar * col = data + headerSize;
+    job.connections.resize(n);
+    job.weights.clear();
+    for (qint64 i = 0; i < n; ++i) {
+        memcpy(&job.connections[i].src, col + i * sizeof(qint32), sizeof(qint32));
+    }
+    col += n * sizeof(qint32);
+    for (qint64 i = 0; i < n; ++i) {
+        memcpy(&job.connections[i].dst, col + i * sizeof(qint32), sizeof(qint32));
+    }
+    col += n * sizeof(qint32);
+    if (hasDelay) {
+        for (qint64 i = 0; i < n; ++i) {
+            memcpy(&job.connections[i].metric, col + i * sizeof(float), sizeof(float));
+        }
+        col += n * sizeof(float);
+    } else if (n > 0) {
+        job.connections[0].metric = NO_DELAY;
+    }
+    if (hasWeight) {
+        job.weights.resize(n);
+        memcpy(job.weights.data(), col, n * sizeof(double));
+    }
+
+    out.unmap((uchar *) data);
+    return true;
+}
+
+void pythonConnectionPool::startNext()
+{
+    while (this->running < this->maxProcesses && this->nextJob < this->jobs.size() && !this->cancelled) {
+        poolJob &p = this->jobs[this->nextJob++];
+        p.process = new QProcess();
+        p.process->setWorkingDirectory(p.dir->path());
+        connect(p.process, SIGNAL(finished(int,QProcess::ExitStatus)), this, SLOT(processFinished(int,QProcess::ExitStatus)));
+        connect(p.process, SIGNAL(error(QProcess::ProcessError)), this, SLOT(processError(QProcess::ProcessError)));
+        connect(p.process, SIGNAL(readyReadStandardOutput()), this, SLOT(processOutput()));
+        p.process->start(pythonConnectionPool::pythonProgram(), QStringList() << "runner.py" << p.dir->path());
+        ++this->running;
+    }
+}
+
+int pythonConnectionPool::findJob(QObject * process)
+{
+    for (int i = 0; i < this->jobs.size(); ++i) {
+        if (this->jobs[i].process == process) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void pythonConnectionPool::processOutput()
+{
+    int i = this->findJob(sender());
+    if (i < 0) {
+        return;
+    }
+    QProcess * process = this->jobs[i].process;
+    while (process->canReadLine()) {
+        QString line = QString::fromUtf8(process->readLine()).trimmed();
+        if (line.startsWith("progress ")) {
+            float fraction = qBound(0.0f, line.mid(9).toFloat(), 1.0f);
+            this->jobs[i].progress = (int) (fraction * 90.0f);
+        } else {
+            DBG() << line;
+        }
+    }
+    this->updateProgress();
+}
+
+void pythonConnectionPool::processFinished(int exitCode, QProcess::ExitStatus status)
+{
+    int i = this->findJob(sender());
+    if (i < 0 || this->jobs[i].done) {
+        return;
+    }
+    poolJob &p = this->jobs[i];
+    if (status != QProcess::NormalExit || exitCode != 0) {
+        p.job->errors = "Python Error:\n" + QString::fromUtf8(p.process->readAllStandardError());
+    } else {
+        this->readOutputs(p);
+    }
+    this->finish(p);
+}
+
+void pythonConnectionPool::processError(QProcess::ProcessError error)
+{
+    int i = this->findJob(sender());
+    if (i < 0 || this->jobs[i].done) {
+        return;
+    }
+    // a crash or kill is reported by finished() as well
+    if (error == QProcess::FailedToStart) {
+        poolJob &p = this->jobs[i];
+        p.job->errors = "Could not start " + pythonConnectionPool::pythonProgram()
+                + " - set the Python program path in the settings";
+        this->finish(p);
+    }
+}
+
+void pythonConnectionPool::finish(poolJob &p)
+{
+    p.done = true;
+    p.progress = 100;
+    --this->running;
+    this->updateProgress();
+    this->startNext();
+    if (this->running == 0) {
+        this->loop.quit();
+    }
+}
+
+void pythonConnectionPool::updateProgress()
+{
+    if (this->progressDialog == NULL) {
+        return;
+    }
+    int total = 0;
+    for (int i = 0; i < this->jobs.size(); ++i) {
+        total += this->jobs[i].progress;
+    }
+    this->progressDialog->setValue(total);
+}
+
+void pythonConnectionPool::cancel()
+{
+    this->cancelled = true;
+    for (int i = 0; i < this->jobs.size(); ++i) {
+        if (this->jobs[i].process != NULL && !this->jobs[i].done) {
+            this->jobs[i].process->kill();
+        }
+    }
+}
@@ -0,0 +1,108 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef PYTHONCONNECTIONPOOL_H
+#define PYTHONCONNECTIONPOOL_H
+
+#include "globalHeader.h"
+#include <QProcess>
+#include <QEventLoop>
+#include <QTemporaryDir>
+#include <QProgressDialog>
+
+struct pythonConnectionJob;
+
+/*!
+ * \brief Regenerates many Python script connections at once, each in a
+ * Python process of its own, so that the GIL doesn't serialise them.
+ *
+ * Each script's inputs are written to a temporary directory, along with a
+ * small runner script which calls connectionFunc and writes its output back
+ * as packed binary columns. Up to the number of cores run at a time. Once
+ * they have all finished, the results are applied to their connections on
+ * the GUI thread, each connection's in one go. A connection whose script
+ * failed is left as it was (and still out of date) while the others are
+ * updated; if the user cancels, none are.
+ */
+class pythonConnectionPool : public QObject
+{
+    Q_OBJECT
+public:
+    explicit pythonConnectionPool(QObject * parent = 0);
+    ~pythonConnectionPool();
+
+    /*!
+     * Regenerate conns, running the event loop until they have all finished
+     * or the user cancels. A progress dialog is shown, parented on
+     * progressParent, unless it is NULL and there is no GUI. Returns false if
+     * any script failed or the run was cancelled, with the reasons in errs;
+     * the connections which did succeed are still applied.
+     */
+    bool regenerate(const QVector <pythonscript_connection *> &conns, QString &errs, QWidget * progressParent = NULL);
+
+    /*!
+     * The Python interpreter to run scripts with: the python/programname
+     * setting if there is one, otherwise the python that SpineCreator links.
+     */
+    static QString pythonProgram();
+
+    /*!
+     * Set the most scripts to run at once. The default is the number of cores.
+     */
+    void setMaxProcesses(int n);
+
+private slots:
+    void processFinished(int exitCode, QProcess::ExitStatus status);
+    void processError(QProcess::ProcessError error);
+    void processOutput();
+    void cancel();
+
+private:
+    struct poolJob
+    {
+        QSharedPointer <pythonConnectionJob> job;
+        QTemporaryDir * dir;
+        QProcess * process;
+        int progress;
+        bool done;
+    };
+
+    bool writeInputs(poolJob &p);
+    bool readOutputs(poolJob &p);
+    void startNext();
+    void finish(poolJob &p);
+    void updateProgress();
+    int findJob(QObject * process);
+
+    QVector <poolJob> jobs;
+    int nextJob;
+    int running;
+    int maxProcesses;
+    bool cancelled;
+    QString runner;
+    QEventLoop loop;
+    QProgressDialog * progressDialog;
+};
+
+#endif // PYTHONCONNECTIONPOOL_H
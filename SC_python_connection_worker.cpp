@@ -0,0 +1,229 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifdef _DEBUG
+  #undef _DEBUG
+  #include <Python.h>
+  #define _DEBUG
+#else
+  #include <Python.h>
+#endif
+
+#include "SC_python_connection_worker.h"
+#include "NL_connection.h"
+
+// PyThreadState_SetAsyncExc() took a signed thread id before Python 3.7
+#if PY_VERSION_HEX >= 0x03070000
+typedef unsigned long pyThreadId;
+#else
+typedef long pyThreadId;
+#endif
+
+pythonConnectionJob::pythonConnectionJob() :
+    id(0),
+    worker(NULL),
+    hasDelay(false),
+    hasWeight(false),
+    hasBuffers(false),
+    progress(0),
+    started(0),
+    cancelled(0)
+{
+}
+
+pythonConnectionWorker * pythonConnectionWorker::worker = NULL;
+
+pythonConnectionWorker * pythonConnectionWorker::instance()
+{
+    if (worker == NULL) {
+        worker = new pythonConnectionWorker();
+        worker->start();
+    }
+    return worker;
+}
+
+void pythonConnectionWorker::shutdown()
+{
+    if (worker == NULL) {
+        return;
+    }
+    QList <int> ids = worker->jobs.keys();
+    for (int i = 0; i < ids.size(); ++i) {
+        worker->cancel(ids[i]);
+    }
+    {
+        QMutexLocker locker(&worker->lock);
+        worker->stopping = true;
+        worker->wake.wakeAll();
+    }
+    worker->wait();
+    delete worker;
+    worker = NULL;
+}
+
+pythonConnectionWorker::pythonConnectionWorker() :
+    lastId(0),
+    stopping(false),
+    running(NULL),
+    runningThreadId(0)
+{
+    // the worker signals are emitted on the worker thread, and are queued
+    // back to the GUI thread (where this object lives) before being acted on
+    connect(this, SIGNAL(workerProgress(int,int)), this, SLOT(relayProgress(int,int)), Qt::QueuedConnection);
+    connect(this, SIGNAL(workerFinished(int)), this, SLOT(finishJob(int)), Qt::QueuedConnection);
+}
+
+pythonConnectionWorker::~pythonConnectionWorker()
+{
+}
+
+int pythonConnectionWorker::enqueue(pythonscript_connection * conn)
+{
+    // only the latest edit of a connection is worth generating
+    QMap <int, QSharedPointer <pythonConnectionJob> >::const_iterator i;
+    for (i = this->jobs.constBegin(); i != this->jobs.constEnd(); ++i) {
+        if (i.value()->conn == conn) {
+            this->cancel(i.key());
+        }
+    }
+
+    QSharedPointer <pythonConnectionJob> job(new pythonConnectionJob());
+    if (!conn->prepareGeneration(*job)) {
+        return 0;
+    }
+    job->id = ++this->lastId;
+    job->worker = this;
+    this->jobs[job->id] = job;
+
+    QMutexLocker locker(&this->lock);
+    this->pending.enqueue(job);
+    this->wake.wakeOne();
+
+    DBG() << "Queued connection script job" << job->id << "(" << this->pending.size() << "waiting)";
+    return job->id;
+}
+
+void pythonConnectionWorker::cancel(int id)
+{
+    if (!this->jobs.contains(id)) {
+        return;
+    }
+    QSharedPointer <pythonConnectionJob> job = this->jobs[id];
+    job->cancelled.fetchAndStoreOrdered(1);
+
+    // a queued job is skipped when it reaches the front of the queue, but a
+    // running script has to be interrupted. The check against running is
+    // made holding the GIL, so the exception can't land in the next job.
+    if (job->started.loadAcquire()) {
+        PyGILState_STATE gil = PyGILState_Ensure();
+        if (this->running == job.data()) {
+            PyThreadState_SetAsyncExc((pyThreadId) this->runningThreadId, PyExc_KeyboardInterrupt);
+        }
+        PyGILState_Release(gil);
+    }
+}
+
+bool pythonConnectionWorker::isPending(int id)
+{
+    return this->jobs.contains(id);
+}
+
+void pythonConnectionWorker::reportProgress(pythonConnectionJob * job, int percent)
+{
+    percent = qBound(0, percent, 100);
+    if (job->progress.fetchAndStoreOrdered(percent) != percent && job->worker != NULL) {
+        emit job->worker->workerProgress(job->id, percent);
+    }
+}
+
+void pythonConnectionWorker::run()
+{
+    forever {
+        QSharedPointer <pythonConnectionJob> job;
+        {
+            QMutexLocker locker(&this->lock);
+            while (this->pending.isEmpty() && !this->stopping) {
+                this->wake.wait(&this->lock);
+            }
+            if (this->stopping) {
+                return;
+            }
+            job = this->pending.dequeue();
+        }
+
+        // Mark the job started before looking for a cancel, and look again
+        // once it is the running job (cancel() checks that holding the GIL
+        // too). Either cancel() sees the job running and interrupts it, or
+        // the job sees the cancel; it can't slip between the two.
+        job->started.fetchAndStoreOrdered(1);
+        if (!job->cancelled.loadAcquire()) {
+            PyGILState_STATE gil = PyGILState_Ensure();
+            this->running = job.data();
+            this->runningThreadId = (unsigned long) PyThread_get_thread_ident();
+
+            if (!job->cancelled.loadAcquire()) {
+                pythonscript_connection::runGeneration(*job);
+            }
+
+            this->running = NULL;
+            if (job->cancelled.loadAcquire()) {
+                // a cancel that arrived after the script returned would
+                // otherwise be raised in the next script
+                PyThreadState_SetAsyncExc((pyThreadId) this->runningThreadId, NULL);
+                PyErr_Clear();
+            }
+            PyGILState_Release(gil);
+        }
+
+        emit workerFinished(job->id);
+    }
+}
+
+void pythonConnectionWorker::relayProgress(int id, int percent)
+{
+    if (!this->jobs.contains(id)) {
+        return;
+    }
+    QSharedPointer <pythonConnectionJob> job = this->jobs[id];
+    if (job->conn) {
+        emit job->conn->progress(percent);
+    }
+    emit progress(id, percent);
+}
+
+void pythonConnectionWorker::finishJob(int id)
+{
+    QSharedPointer <pythonConnectionJob> job = this->jobs.take(id);
+    if (job.isNull()) {
+        return;
+    }
+
+    bool ok = false;
+    if (job->cancelled.loadAcquire()) {
+        DBG() << "Connection script job" << id << "was cancelled";
+    } else if (job->conn) {
+        ok = job->conn->applyGeneration(*job);
+    }
+    emit generated(id, ok);
+}
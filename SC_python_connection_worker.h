@@ -0,0 +1,158 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef PYTHONCONNECTIONWORKER_H
+#define PYTHONCONNECTIONWORKER_H
+
+#include "globalHeader.h"
+#include <QThread>
+#include <QQueue>
+#include <QWaitCondition>
+#include <QPointer>
+
+class pythonConnectionWorker;
+
+/*!
+ * \brief A single run of a connection script.
+ *
+ * The inputs are copied from the pythonscript_connection on the GUI thread
+ * (see pythonscript_connection::prepareGeneration()), so the script can run
+ * while the model is being edited. The outputs are only copied back into the
+ * connection, on the GUI thread, once the script has finished.
+ */
+struct pythonConnectionJob
+{
+    pythonConnectionJob();
+
+    int id;
+    // only touched on the GUI thread
+    QPointer <pythonscript_connection> conn;
+    pythonConnectionWorker * worker;
+
+    // inputs
+    QString scriptText;
+    QStringList parNames;
+    QVector <double> parValues;
+    QVector <QString> parText;
+    QString weightProp;
+    QVector <loc> srcLocs;
+    QVector <loc> dstLocs;
+    bool hasDelay;
+    bool hasWeight;
+    bool hasBuffers;
+
+    // outputs
+    QVector <conn> connections;
+    QVector <double> weights;
+    QString errors;
+
+    QAtomicInt progress;
+    QAtomicInt started;
+    QAtomicInt cancelled;
+};
+
+/*!
+ * \brief Runs connection scripts one after another on a thread of their own.
+ *
+ * The main thread releases the Python GIL once the interpreter is set up, and
+ * the worker takes it for as long as each script runs. Jobs are queued with
+ * enqueue(), which returns straight away. When a job finishes its output is
+ * applied to the connection on the GUI thread in one go and generated() is
+ * emitted; nothing is applied if the job was cancelled or the connection has
+ * gone.
+ */
+class pythonConnectionWorker : public QThread
+{
+    Q_OBJECT
+public:
+    /*!
+     * The worker shared by the whole application, created and started on the
+     * first call. Must be called from the GUI thread.
+     */
+    static pythonConnectionWorker * instance();
+
+    /*!
+     * Stop the worker, cancelling any jobs, before Python is finalised.
+     */
+    static void shutdown();
+
+    /*!
+     * Queue the connection for generation, cancelling any job already queued
+     * or running for it. Returns the job id, or 0 if the layouts could not be
+     * generated, in which case conn->errorLog says why.
+     */
+    int enqueue(pythonscript_connection * conn);
+
+    /*!
+     * Cancel a queued or running job. A running script is interrupted with a
+     * KeyboardInterrupt at its next Python instruction.
+     */
+    void cancel(int id);
+
+    /*!
+     * True while the job is queued or running.
+     */
+    bool isPending(int id);
+
+    /*!
+     * Record the progress of a job, in percent. May be called from any thread.
+     */
+    static void reportProgress(pythonConnectionJob * job, int percent);
+
+signals:
+    void progress(int id, int percent);
+    void generated(int id, bool ok);
+
+    // emitted on the worker thread
+    void workerProgress(int id, int percent);
+    void workerFinished(int id);
+
+private slots:
+    void relayProgress(int id, int percent);
+    void finishJob(int id);
+
+private:
+    pythonConnectionWorker();
+    ~pythonConnectionWorker();
+
+    void run();
+
+    static pythonConnectionWorker * worker;
+
+    int lastId;
+    // GUI thread only
+    QMap <int, QSharedPointer <pythonConnectionJob> > jobs;
+
+    // guarded by lock
+    QMutex lock;
+    QWaitCondition wake;
+    QQueue <QSharedPointer <pythonConnectionJob> > pending;
+    bool stopping;
+
+    // guarded by the GIL
+    pythonConnectionJob * running;
+    unsigned long runningThreadId;
+};
+
+#endif // PYTHONCONNECTIONWORKER_H
@@ -24,6 +24,7 @@
 
 #include "SC_settings.h"
 #include "ui_settings_window.h"
+#include "SC_viewELexptpanelhandler.h"
 #include "QSettings"
 
 settings_window::settings_window(QWidget *parent) :
@@ -92,6 +93,10 @@ settings_window::settings_window(QWidget *parent) :
     ui->openGLDetailSpinBox->setValue(lod);
     connect(ui->openGLDetailSpinBox, SIGNAL(valueChanged(int)), this, SLOT(setGLDetailLevel(int)));
 
+    // how many simulations are run from the experiment panel at once
+    ui->maxRunsSpinBox->setValue(viewELExptPanelHandler::maxConcurrentRuns());
+    connect(ui->maxRunsSpinBox, SIGNAL(valueChanged(int)), this, SLOT(setMaxConcurrentRuns(int)));
+
     // change dev stuff box
     bool devMode = settings.value("dev_mode_on", "false").toBool();
     ui->dev_mode_check->setChecked(devMode);
@@ -296,6 +301,12 @@ void settings_window::setGLDetailLevel(int value)
     settings.setValue("glOptions/detail", value);
 }
 
+void settings_window::setMaxConcurrentRuns(int value)
+{
+    QSettings settings;
+    settings.setValue("simulation/max_concurrent_runs", value);
+}
+
 void settings_window::setDevMode(bool toggle)
 {
     QSettings settings;
@@ -85,6 +85,7 @@ public slots:
     void changedEnvVar(QString);
     void saveAsBinaryToggled(bool);
     void setGLDetailLevel(int);
+    void setMaxConcurrentRuns(int);
     void setDevMode(bool);
     void close();
     void scriptSelectionChanged(QListWidgetItem *current, QListWidgetItem *previous);
@@ -0,0 +1,280 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "SC_simulation_progress.h"
+
+// each run gets a socket of its own
+static int progressServerCount = 0;
+
+simulationProgress::simulationProgress(float duration, QObject * parent) :
+    QObject(parent),
+    duration(duration),
+    simTime(0),
+    emittedTime(0),
+    wallTime(0),
+    running(false),
+    connected(false),
+    pending(false),
+    server(NULL)
+{
+    this->updateTimer.setSingleShot(true);
+    connect(&this->updateTimer, SIGNAL(timeout()), this, SLOT(update()));
+    connect(&this->backstopTimer, SIGNAL(timeout()), this, SLOT(backstop()));
+    connect(&this->watcher, SIGNAL(fileChanged(QString)), this, SLOT(changed()));
+    connect(&this->watcher, SIGNAL(directoryChanged(QString)), this, SLOT(changed()));
+}
+
+simulationProgress::~simulationProgress()
+{
+    this->stop();
+}
+
+void simulationProgress::addToEnvironment(QProcessEnvironment &env)
+{
+    if (this->server == NULL) {
+        this->server = new QLocalServer(this);
+        connect(this->server, SIGNAL(newConnection()), this, SLOT(newConnection()));
+        QString name = "spinecreator-progress-" + QString::number(QCoreApplication::applicationPid())
+                + "-" + QString::number(progressServerCount++);
+        // a socket left behind by a crash would stop us listening
+        QLocalServer::removeServer(name);
+        if (!this->server->listen(name)) {
+            DBG() << "Could not open the progress socket" << name << ":" << this->server->errorString();
+            delete this->server;
+            this->server = NULL;
+            return;
+        }
+    }
+    env.insert("SPINECREATOR_PROGRESS", this->server->fullServerName());
+}
+
+void simulationProgress::start(QString outDir)
+{
+    this->timeFileName = QDir(outDir).absoluteFilePath("model/time.txt");
+    // one left from an earlier run would show its progress
+    QFile::remove(this->timeFileName);
+
+    this->simTime = 0;
+    this->message.clear();
+    this->emittedTime = 0;
+    this->emittedMessage.clear();
+    this->wallTime = 0;
+    this->wallClock.start();
+    this->running = true;
+
+    if (!this->connected) {
+        this->watch();
+        this->backstopTimer.start(PROGRESS_BACKSTOP_INTERVAL_MS);
+    }
+}
+
+void simulationProgress::stop()
+{
+    if (!this->running) {
+        return;
+    }
+    this->wallTime = this->wallClock.elapsed();
+    this->running = false;
+    this->updateTimer.stop();
+    this->backstopTimer.stop();
+
+    // pick up the last update
+    if (this->server != NULL) {
+        QList <QLocalSocket *> sockets = this->server->findChildren <QLocalSocket *> ();
+        for (int i = 0; i < sockets.size(); ++i) {
+            this->readLines(sockets[i]);
+        }
+        this->server->close();
+    }
+    if (!this->connected) {
+        this->readTimeFile();
+    }
+
+    if (!this->watcher.files().isEmpty()) {
+        this->watcher.removePaths(this->watcher.files());
+    }
+    if (!this->watcher.directories().isEmpty()) {
+        this->watcher.removePaths(this->watcher.directories());
+    }
+}
+
+float simulationProgress::getSimTime() const
+{
+    return this->simTime;
+}
+
+qint64 simulationProgress::getWallTime() const
+{
+    return this->running ? this->wallClock.elapsed() : this->wallTime;
+}
+
+double simulationProgress::getThroughput() const
+{
+    qint64 wall = this->getWallTime();
+    if (wall <= 0) {
+        return 0;
+    }
+    return this->simTime / (wall / 1000.0);
+}
+
+float simulationProgress::getFraction() const
+{
+    if (this->duration <= 0) {
+        return 0;
+    }
+    return qBound(0.0f, this->simTime / (this->duration * 1000), 1.0f);
+}
+
+QString simulationProgress::getMessage() const
+{
+    return this->message;
+}
+
+bool simulationProgress::isConnected() const
+{
+    return this->connected;
+}
+
+void simulationProgress::newConnection()
+{
+    while (this->server->hasPendingConnections()) {
+        QLocalSocket * socket = this->server->nextPendingConnection();
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readSocket()));
+        connect(socket, SIGNAL(disconnected()), this, SLOT(socketClosed()));
+    }
+    // the socket is used from now on, so the time file needn't be watched
+    if (!this->connected) {
+        DBG() << "Simulator progress is being reported on" << this->server->fullServerName();
+        this->connected = true;
+        this->backstopTimer.stop();
+        if (!this->watcher.files().isEmpty()) {
+            this->watcher.removePaths(this->watcher.files());
+        }
+        if (!this->watcher.directories().isEmpty()) {
+            this->watcher.removePaths(this->watcher.directories());
+        }
+    }
+}
+
+void simulationProgress::readSocket()
+{
+    QLocalSocket * socket = qobject_cast <QLocalSocket *> (sender());
+    if (socket != NULL) {
+        this->readLines(socket);
+    }
+}
+
+void simulationProgress::socketClosed()
+{
+    QLocalSocket * socket = qobject_cast <QLocalSocket *> (sender());
+    if (socket != NULL) {
+        this->readLines(socket);
+        socket->deleteLater();
+    }
+}
+
+void simulationProgress::readLines(QLocalSocket * socket)
+{
+    bool read = false;
+    while (socket->canReadLine()) {
+        this->parse(QString::fromUtf8(socket->readLine()));
+        read = true;
+    }
+    if (read) {
+        this->changed();
+    }
+}
+
+void simulationProgress::changed()
+{
+    this->pending = true;
+    // a simulator can report far more often than is worth showing
+    if (this->running && !this->updateTimer.isActive()) {
+        this->updateTimer.start(PROGRESS_UPDATE_INTERVAL_MS);
+    }
+}
+
+void simulationProgress::backstop()
+{
+    // only a change the watcher missed is worth an update
+    this->readTimeFile();
+    if (this->simTime != this->emittedTime || this->message != this->emittedMessage) {
+        this->changed();
+    }
+}
+
+void simulationProgress::update()
+{
+    if (!this->connected) {
+        this->readTimeFile();
+        // the file may have been made, or replaced, since it was watched
+        this->watch();
+    }
+    if (this->pending) {
+        this->pending = false;
+        // the directory changes for other files too
+        if (this->simTime != this->emittedTime || this->message != this->emittedMessage) {
+            this->emittedTime = this->simTime;
+            this->emittedMessage = this->message;
+            emit progressed();
+        }
+    }
+}
+
+void simulationProgress::parse(QString line)
+{
+    line = line.trimmed();
+    if (line.isEmpty()) {
+        return;
+    }
+    bool ok;
+    float t = line.toFloat(&ok);
+    if (ok) {
+        this->simTime = t;
+        this->message.clear();
+    } else {
+        this->message = line;
+    }
+}
+
+void simulationProgress::readTimeFile()
+{
+    QFile simTimeFile(this->timeFileName);
+    if (!simTimeFile.open(QFile::ReadOnly)) {
+        return;
+    }
+    this->parse(QTextStream(&simTimeFile).readLine());
+}
+
+void simulationProgress::watch()
+{
+    // the directory is watched for the file being made
+    QString dir = QFileInfo(this->timeFileName).absolutePath();
+    if (QFileInfo(dir).isDir() && !this->watcher.directories().contains(dir)) {
+        this->watcher.addPath(dir);
+    }
+    if (QFile::exists(this->timeFileName) && !this->watcher.files().contains(this->timeFileName)) {
+        this->watcher.addPath(this->timeFileName);
+    }
+}
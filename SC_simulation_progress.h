@@ -0,0 +1,136 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef SIMULATIONPROGRESS_H
+#define SIMULATIONPROGRESS_H
+
+#include "globalHeader.h"
+#include <QFileSystemWatcher>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QProcessEnvironment>
+#include <QElapsedTimer>
+
+/*!
+ * The most often progressed() is emitted, however often the simulator
+ * reports. Reports which arrive in the meantime are coalesced.
+ */
+#define PROGRESS_UPDATE_INTERVAL_MS 100
+
+/*!
+ * How often the time file is checked when no change has been signalled, in
+ * case the file system doesn't report changes (network drives, for example).
+ */
+#define PROGRESS_BACKSTOP_INTERVAL_MS 1000
+
+/*!
+ * \brief Follows the progress of a running simulator.
+ *
+ * A simulator which supports it connects to the local socket named in the
+ * SPINECREATOR_PROGRESS environment variable and writes one line for each
+ * update: either the simulation time reached, in ms, or a status message.
+ * Otherwise its model/time.txt in the output directory, which holds the same
+ * thing, is watched for changes.
+ *
+ * The simulation time, wall time and throughput are available for as long
+ * as the object lives, so a list of runs can show them all.
+ */
+class simulationProgress : public QObject
+{
+    Q_OBJECT
+public:
+    /*!
+     * duration is the length of the experiment, in s.
+     */
+    explicit simulationProgress(float duration, QObject * parent = 0);
+    ~simulationProgress();
+
+    /*!
+     * Open the progress socket and add its name to env, the simulator's
+     * environment. If the socket can't be opened only the time file is
+     * followed.
+     */
+    void addToEnvironment(QProcessEnvironment &env);
+
+    /*!
+     * Start the wall clock and follow the simulator writing into outDir.
+     */
+    void start(QString outDir);
+
+    /*!
+     * Stop following the simulator, reading any last update first. The
+     * wall clock stops too.
+     */
+    void stop();
+
+    // the simulation time reached, in ms
+    float getSimTime() const;
+    // how long the simulator has been running for, in ms
+    qint64 getWallTime() const;
+    // simulated ms for each s of wall time
+    double getThroughput() const;
+    // how far through the experiment the simulation is, from 0 to 1
+    float getFraction() const;
+    // the last status message, if it came after the last time
+    QString getMessage() const;
+    // whether the simulator is reporting over the socket
+    bool isConnected() const;
+
+signals:
+    void progressed();
+
+private slots:
+    void newConnection();
+    void readSocket();
+    void socketClosed();
+    void changed();
+    void update();
+    void backstop();
+
+private:
+    void readLines(QLocalSocket * socket);
+    void parse(QString line);
+    void readTimeFile();
+    void watch();
+
+    float duration;
+    float simTime;
+    QString message;
+    // what progressed() was last emitted for
+    float emittedTime;
+    QString emittedMessage;
+    QElapsedTimer wallClock;
+    qint64 wallTime;
+    bool running;
+    bool connected;
+    bool pending;
+
+    QLocalServer * server;
+    QString timeFileName;
+    QFileSystemWatcher watcher;
+    QTimer updateTimer;
+    QTimer backstopTimer;
+};
+
+#endif // SIMULATIONPROGRESS_H
@@ -1,5 +1,7 @@
 #include "SC_utilities.h"
 #include <QSettings>
+#include <cmath>
+#include <qnumeric.h>
 
 void
 SCUtilities::storeError (QString emsg)
@@ -12,3 +14,104 @@ SCUtilities::storeError (QString emsg)
     settings.setValue("errorText", emsg);
     settings.endArray();
 }
+
+// Compare the (lower case) word w with the start of [p, end), ignoring case
+static inline bool startsWithWord (const char* p, const char* end, const char* w)
+{
+    for (; *w != '\0'; ++p, ++w) {
+        if (p >= end || (*p | 0x20) != *w) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const char*
+SCUtilities::parseNumber (const char* p, const char* end, double& v)
+{
+    bool neg = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        neg = (*p == '-');
+        ++p;
+    }
+
+    if (startsWithWord (p, end, "inf")) {
+        v = neg ? -Q_INFINITY : Q_INFINITY;
+        p += 3;
+        if (startsWithWord (p, end, "inity")) {
+            p += 5;
+        }
+        return p;
+    }
+    if (startsWithWord (p, end, "nan")) {
+        v = qQNaN();
+        return p + 3;
+    }
+
+    // Up to 19 significant digits fit in the mantissa; beyond that only the
+    // exponent is adjusted.
+    quint64 mant = 0;
+    int sigDigits = 0;
+    int exp10 = 0;
+    bool any = false;
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (sigDigits < 19) {
+            mant = mant*10 + (*p - '0');
+            if (mant != 0) { ++sigDigits; }
+        } else {
+            ++exp10;
+        }
+        any = true;
+        ++p;
+    }
+    if (p < end && *p == '.') {
+        ++p;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (sigDigits < 19) {
+                mant = mant*10 + (*p - '0');
+                if (mant != 0) { ++sigDigits; }
+                --exp10;
+            }
+            any = true;
+            ++p;
+        }
+    }
+    if (!any) {
+        return (const char*)0;
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p+1;
+        bool eneg = false;
+        if (q < end && (*q == '-' || *q == '+')) {
+            eneg = (*q == '-');
+            ++q;
+        }
+        if (q < end && *q >= '0' && *q <= '9') {
+            int e = 0;
+            while (q < end && *q >= '0' && *q <= '9') {
+                if (e < 10000) { e = e*10 + (*q - '0'); }
+                ++q;
+            }
+            exp10 += eneg ? -e : e;
+            p = q;
+        } // else the 'e' isn't part of the number
+    }
+
+    // Powers of ten which are exact in a double
+    static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+                                    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+                                    1e20, 1e21, 1e22 };
+    double d = (double)mant;
+    if (mant != 0 && exp10 != 0) {
+        if (exp10 > 0 && exp10 <= 22) {
+            d *= pow10[exp10];
+        } else if (exp10 < 0 && exp10 >= -22) {
+            d /= pow10[-exp10];
+        } else {
+            d *= pow(10.0, (double)exp10);
+        }
+    }
+    v = neg ? -d : d;
+    return p;
+}
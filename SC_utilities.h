@@ -40,6 +40,13 @@ public:
      * "errors".
      */
     static void storeError (QString emsg);
+
+    /*!
+     * Parse one number from [p, end), without allocating. Returns the
+     * character after the number, or NULL if there was no number at p.
+     * Always uses '.' as the decimal point, whatever the locale.
+     */
+    static const char* parseNumber (const char* p, const char* end, double& v);
 };
 
 #endif // _SC_UTILITIES_H_
@@ -35,7 +35,11 @@
 #include "SC_projectobject.h"
 #include "SC_undocommands.h"
 #include "qmessageboxresizable.h"
+#include "SC_experiment_sweep_dialog.h"
+#include "SC_export_cache.h"
+#include "SC_simulation_progress.h"
 #include <QTimer>
+#include <QThread>
 
 
 #if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
@@ -53,6 +57,7 @@
 viewELExptPanelHandler::viewELExptPanelHandler(QObject *parent) :
     QObject(parent)
 {
+    this->startingRuns = false;
 }
 
 viewELExptPanelHandler::viewELExptPanelHandler(viewELstruct * viewEL, nl_rootdata * data, QObject *parent) :
@@ -66,6 +71,7 @@ viewELExptPanelHandler::viewELExptPanelHandler(viewELstruct * viewEL, nl_rootdat
     this->exptOutputs = new QVBoxLayout;
     this->exptChanges = new QVBoxLayout;
     this->cursor = QPointF(0,0);
+    this->startingRuns = false;
 
     // visual experiments test code - all looks good but not right now...
 #ifdef NEW_EXPERIMENT_VIEW
@@ -133,6 +139,21 @@ viewELExptPanelHandler::viewELExptPanelHandler(viewELstruct * viewEL, nl_rootdat
 
 }
 
+viewELExptPanelHandler::~viewELExptPanelHandler()
+{
+    for (int i = 0; i < this->runs.size(); ++i) {
+        simulationRun * run = this->runs[i];
+        if (run->process != NULL) {
+            run->process->disconnect(this);
+            run->process->kill();
+            run->process->waitForFinished(1000);
+            delete run->process;
+        }
+        delete run->progress;
+        delete run;
+    }
+}
+
 void viewELExptPanelHandler::recursiveDeleteLoop(QLayout * parentLayout)
 {
     QLayoutItem * item;
@@ -275,6 +296,21 @@ void viewELExptPanelHandler::redrawSimulatorParams(experiment * currentExperimen
     connect(solver, SIGNAL(currentIndexChanged(int)), this, SLOT(changedSolver(int)));
     formSim->addRow("Solver:",solver);
 
+    //procedure
+    QComboBox * procedureBox = new QComboBox;
+    procedureBox->addItem("Single run",(int) SingleRun);
+    procedureBox->addItem("Repeat runs",(int) RepeatRuns);
+    procedureBox->addItem("Tuning",(int) Tuning);
+    for (int i = 0; i < procedureBox->count(); ++i) {
+        if (((procedure) procedureBox->itemData(i).toInt()) == currentExperiment->setup.exptProcedure) {
+            procedureBox->setCurrentIndex(i);
+            break;
+        }
+    }
+    procedureBox->setToolTip("Repeat runs and Tuning run the experiment many times, over a list of input seeds or over values of its changed properties");
+    connect(procedureBox, SIGNAL(currentIndexChanged(int)), this, SLOT(changedProcedure(int)));
+    formSim->addRow("Procedure:",procedureBox);
+
     //solver order
     if (currentExperiment->setup.solver == RungeKutta) {
         QSpinBox * solverOrd = new QSpinBox;
@@ -613,7 +649,7 @@ void viewELExptPanelHandler::delExperiment()
     int index = sender()->property("index").toUInt();
 
     // check we aren't running - don't delete if we are
-    if (data->experiments[index] == this->runExpt) {
+    if (data->experiments[index]->running) {
         return;
     }
 
@@ -797,6 +833,20 @@ void viewELExptPanelHandler::changedSolver(int index)
     redrawExpt();
 }
 
+void viewELExptPanelHandler::changedProcedure(int index)
+{
+    experiment * currentExperiment = NULL;
+
+    // find currentExperiment
+    for (int i = 0; i < data->experiments.size(); ++i) {
+        if (data->experiments[i]->selected) {currentExperiment = data->experiments[i]; break;}
+    }
+
+    if (currentExperiment == NULL) return;
+
+    currentExperiment->setup.exptProcedure = (procedure) ((QComboBox *) sender())->itemData(index).toInt();
+}
+
 void viewELExptPanelHandler::changedSolverOrder(int val)
 {
     experiment * currentExperiment = NULL;
@@ -1776,20 +1826,17 @@ void viewELExptPanelHandler::delChangedProp()
 
 void viewELExptPanelHandler::run()
 {
-    QSettings settings;
-    settings.setProperty("MERR", QString("False"));
-
-    QToolButton * runButton = qobject_cast < QToolButton * > (sender());
-    if (runButton) {
-        runButton->disconnect(this);
-        runButton->setText("Run experiment");
-        QCommonStyle style;
-        runButton->setIcon(style.standardIcon(QStyle::SP_MediaStop));
-        connect(runButton, SIGNAL(clicked()), this, SLOT(cancelRun()));
+    // repeat runs and tuning are run as a sweep, which has its own dialog
+    for (int i = 0; i < data->experiments.size(); ++i) {
+        if (data->experiments[i]->selected && data->experiments[i]->setup.exptProcedure != SingleRun) {
+            experimentSweepDialog * sweep = new experimentSweepDialog(this->data, data->experiments[i], i, this->main);
+            sweep->exec();
+            return;
+        }
     }
 
-    simulatorStdOutText = "";
-    simulatorStdErrText = "";
+    QSettings settings;
+    settings.setProperty("MERR", QString("False"));
 
     // fetch current experiment sim engine
     experiment * currentExperiment = NULL;
@@ -1805,78 +1852,32 @@ void viewELExptPanelHandler::run()
     }
 
     if (currentExperiment == NULL) {
-        this->cleanUpPostRun("", "");
         return;
     }
 
-    this->runExpt = currentExperiment;
-    this->runExpt->running = true;
+    simulationRun * run = new simulationRun;
+    run->expt = currentExperiment;
+    run->exptNum = currentExptNum;
+    run->project = this->data->currProject;
+    run->state = simulationRun::Queued;
+    run->process = NULL;
+    run->progress = NULL;
+    run->shownProgress = -1;
 
     QString simName = currentExperiment->setup.simType;
-
-    // load path
-    settings.beginGroup("simulators/" + simName);
     DBG() << "Simulator name: " << simName;
-    QString path = settings.value("path").toString();
-    // Check that path exists and is executable.
-    QFile the_script(path);
-#ifndef Q_OS_WIN
-    if (!the_script.exists()) {
-        // Error - convert_script file doesn't exist
-        this->cleanUpPostRun("Simulator Error", "The simulator '" + path + "' does not exist.");
-        return;
-    } else {
-        // Path exists, check it's a file and is executable
-        // NB: In QT 5.x this would be QFileDevice::ExeOwner etc
-        if (the_script.permissions() & (QFile::ExeOwner|QFile::ExeGroup|QFile::ExeOther)) {
-            // Probably Ok - we have execute permission of some kind.
-        } else {
-            // Error - no execute permission on script
-            this->cleanUpPostRun("Simulator Error", "The simulator '" + path + "' is not executable.");
-            return;
-        }
-    }
-//#else
-    if (simName != "BRAHMS") {
-        if (!the_script.exists()) {
-            // Error - convert_script file doesn't exist
-            this->cleanUpPostRun("Simulator Error", "The simulator '" + path + "' does not exist.");
-            return;
-        } else {
-            // Path exists, check it's a file and is executable
-            // NB: In QT 5.x this would be QFileDevice::ExeOwner etc
-            if (the_script.permissions() & (QFile::ExeOwner|QFile::ExeGroup|QFile::ExeOther)) {
-                // Probably Ok - we have execute permission of some kind.
-            } else {
-                // Error - no execute permission on script
-                this->cleanUpPostRun("Simulator Error", "The simulator '" + path + "' is not executable.");
-                return;
-            }
-        }
-    }
-#endif
 
-    // The convert_script takes the working directory as a script argument
-    QString wk_dir_string = settings.value("working_dir").toString();
-    settings.endGroup();
-    wk_dir_string = QDir::toNativeSeparators(wk_dir_string);
-#ifdef Q_OS_WIN
-    if (simName == "BRAHMS") {
-        // on windows using Ubuntu BASH we must convert the path
-        wk_dir_string = wk_dir_string.replace("\\","/");
-        wk_dir_string = wk_dir_string.replace("C:","/mnt/c");
-        wk_dir_string = wk_dir_string.replace("D:","/mnt/d");
+    // load the path, environment and working directory, checking that the
+    // simulator exists and is executable
+    QString err;
+    if (!run->command.load(simName, err)) {
+        this->cleanUpPostRun(run, "Simulator Error", err);
+        return;
     }
-#endif
-    QDir wk_dir(wk_dir_string);
-
-    // clear error message lookup
-    this->errorMessages.clear();
-    this->errorStrings.clear();
 
     // try and find an error message lookup
     // FIXME: Need to get this from installed version first, then look in working directory.
-    QFile errorMsgLookup(wk_dir.absoluteFilePath("errorMsgLookup.txt"));
+    QFile errorMsgLookup(QDir(run->command.workingDir).absoluteFilePath("errorMsgLookup.txt"));
     if (errorMsgLookup.open(QIODevice::ReadOnly)) {
         // file exists! start parsing line by line
         QByteArray line = errorMsgLookup.readLine();
@@ -1888,31 +1889,14 @@ void viewELExptPanelHandler::run()
             // if we have two sides then the line is correctly formatted
             if (parts.size() == 2) {
                 // formatted correctly - add to lists
-                this->errorStrings.push_back(parts[0]);
-                this->errorMessages.push_back(parts[1]);
+                run->errorStrings.push_back(parts[0]);
+                run->errorMessages.push_back(parts[1]);
             }
             // read next line
             line = errorMsgLookup.readLine();
         }
     }
 
-    // set up the environment for the spawned processes
-    QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
-
-    settings.beginGroup("simulators/" + simName + "/envVar");
-
-    // load environment variable values for the simulator.
-    QStringList keysTemp = settings.childKeys();
-
-    for (int i = 0; i < keysTemp.size(); ++i) {
-        env.insert(keysTemp[i], settings.value(keysTemp[i]).toString());
-    }
-    settings.endGroup();
-
-    // add the working dir to the path - this allows Mac users to have the preflight in
-    // SpineML_2_BRAHMS
-    env.insert("PATH", env.value("PATH", "") + ":" + wk_dir.absolutePath());
-
     // If the model has changed compared with the one currently saved,
     // then we must write out the current in-memory model to a
     // temporary location and execute that model.
@@ -1942,25 +1926,23 @@ void viewELExptPanelHandler::run()
         if (!this->tdir.isReadable()) {
 #endif
             DBG() << "Can't use temporary simulator directory!";
-            runButton->setEnabled(true);
+            this->cleanUpPostRun(run, "", "");
             return;
         }
 
-        // clear directory
-        QDir model_dir(this->tdir.path());
-        QStringList files = model_dir.entryList(QDir::Files);
-        for (int i = 0; i < files.size(); ++i) {
-            model_dir.remove(files[i]);
-        }
-
-        // Write the model into the temporary dir
+        // Write the model into the temporary dir. It is kept between
+        // runs, and only the files which have changed since the last run
+        // are written again.
         tFilePath = this->tdir.path()+ QDir::separator() + "temp.proj";
         settings.setValue("files/currentFileName", tFilePath);
         DBG() << "Saving project temporarily to: " << tFilePath;
+        exportCache::begin(this->tdir.path());
         // save_project changes the current project's filepath.
-        if (!this->data->currProject->save_project(tFilePath, this->data)) {
+        bool saved = this->data->currProject->save_project(tFilePath, this->data);
+        exportCache::end();
+        if (!saved) {
             DBG() << "Failed to save the model into the temporary model directory";
-            this->cleanUpPostRun("Model save error", "The simulation could not be started");
+            this->cleanUpPostRun(run, "Model save error", "The simulation could not be started");
             // Revert currProject->filePath here
             this->data->currProject->filePath = previousFilePath;
             return;
@@ -1971,163 +1953,382 @@ void viewELExptPanelHandler::run()
     }
 #endif
 
-    QProcess * simulator = new QProcess;
-    if (!simulator) {
-        // Really bad error - memory allocation error. The following will probably fail:
-        this->cleanUpPostRun("Memory Allocation Error", "The simulator failed to start - you're out of RAM.");
+    // The run gets a snapshot of the model in a directory of its own, so
+    // the model can be changed, and run again, while this run goes on.
+    if (!this->prepareRun(run, QFileInfo(tFilePath).dir().path(), err)) {
+        this->cleanUpPostRun(run, "Simulator Error", err);
         return;
     }
 
-    simulator->setWorkingDirectory(wk_dir.absolutePath());
-    simulator->setProcessEnvironment(env);
+    this->runs.push_back(run);
+    run->expt->running = true;
+    if (run->expt->runButton) {
+        run->expt->runButton->disconnect(this);
+        QCommonStyle style;
+        run->expt->runButton->setIcon(style.standardIcon(QStyle::SP_MediaStop));
+        connect(run->expt->runButton, SIGNAL(clicked()), this, SLOT(cancelRun()));
+    }
+    this->showRunState(run);
 
-    // This is a project-specific* output directory, stored in a
-    // folder in the working directory.
-    //
-    // *: Actually, it's experiment specific, because if another
-    // experiment in the same project has a different simulator, then
-    // this path will differ. However, I don't add a _exptN
-    // suffix. That said, true experiment-specific data storage would
-    // enable easy comparison of two experiments and would be great.
-    QString out_dir_name = wk_dir.absolutePath() + QDir::separator() + "temp" + QDir::separator() + data->currProject->getFilenameFriendlyName() + "_e" + QString::number(currentExptNum);
+    this->startQueuedRuns();
+}
 
-    simulator->setProperty("logpath", out_dir_name + QDir::separator() + "log");
+/*!
+ * \brief viewELExptPanelHandler::hasRuns
+ * Whether any of project's runs are still queued or running, and so point
+ * into its experiments.
+ */
+bool viewELExptPanelHandler::hasRuns(projectObject * project)
+{
+    for (int i = 0; i < this->runs.size(); ++i) {
+        if (this->runs[i]->project == project) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    QFileInfo projFileInfo(tFilePath); // tFilePath contains the path
-                                       // to the model being executed,
-                                       // either in the original location
-                                       // or in the temporary directory.
-    QString modelpath(projFileInfo.dir().path());
-    {
-        QStringList al;
-#ifdef Q_OS_WIN
-        //bool isPython = false;
-        if (simName == "BRAHMS") {
-            out_dir_name = wk_dir.absolutePath() + "/temp";
-             // on windows using Ubuntu BASH we must convert the path
-             modelpath = modelpath.replace("\\","/");
-             modelpath = modelpath.replace("C:","/mnt/c");
-             modelpath = modelpath.replace("D:","/mnt/d");
-             path =  QString("c:\\WINDOWS\\sysnative\\bash.exe -c ") + QString('"') + path + \
-                     QString(" -m ") + modelpath + \
-                     QString(" -w ") + wk_dir.absolutePath() + \
-                     QString(" -o ") + out_dir_name + \
-                     QString(" -e ") + QString("%1").arg(currentExptNum) + \
-                     QString('"') \
-                     ;
-        } else {
-            if (path.contains("python.exe")) {
-                //isPython = true;
-                QStringList pathbits = path.split("python.exe ");
-                qDebug() << pathbits;
-                if (pathbits.size() > 1) {
-                    path = pathbits[0] + QString("python.exe");
-                    al << QDir::toNativeSeparators(pathbits[1]);
-                }
-            }
-            al << "-m" << QDir::toNativeSeparators(modelpath)                          // path to input model
-               << "-w" << QDir::toNativeSeparators(wk_dir.absolutePath())              // path to simulator dir
-               << "-o" << QDir::toNativeSeparators(out_dir_name)                    // Output dir
-               << "-e" << QString("%1").arg(currentExptNum); // The experiment to execute
+/*!
+ * \brief viewELExptPanelHandler::prepareRun
+ * Make the directory for a run, and link or copy the model in modelSource
+ * into it. The runs of an experiment are kept together in
+ * working_dir/temp/<project>_e<N>, each in a directory named for when it was
+ * launched, and only the last KEPT_RUNS of them are kept.
+ */
+bool viewELExptPanelHandler::prepareRun(simulationRun * run, QString modelSource, QString &err)
+{
+    // the working directory as this system sees it - the command's may be
+    // the one the Windows BASH sees
+    QSettings settings;
+    QString wk_dir_string = QDir::toNativeSeparators(settings.value("simulators/" + run->command.simName + "/working_dir").toString());
+    QString exptDirName = QDir(wk_dir_string).absolutePath() + QDir::separator() + "temp" + QDir::separator()
+            + run->project->getFilenameFriendlyName() + "_e" + QString::number(run->exptNum);
+    this->removeOldRuns(exptDirName);
+
+    QDir exptDir(exptDirName);
+    QString name = "run-" + QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss-zzz");
+    QString runName = name;
+    for (int i = 1; exptDir.exists(runName); ++i) {
+        runName = name + "-" + QString::number(i);
+    }
+    if (!exptDir.mkpath(runName + QDir::separator() + "model") || !exptDir.mkpath(runName + QDir::separator() + "out")) {
+        err = "Could not make the run directory '" + exptDir.absoluteFilePath(runName) + "'";
+        return false;
+    }
+    run->dir = exptDir.absoluteFilePath(runName);
+    run->modelDir = run->dir + QDir::separator() + "model";
+    run->outDir = run->dir + QDir::separator() + "out";
+    run->logPath = run->outDir + QDir::separator() + "log";
+    run->cancelFileName = QDir::toNativeSeparators(run->outDir + QDir::separator() + "model" + QDir::separator() + "stop.txt");
+
+    // the model files are written again, never changed in place, when the
+    // model is next exported, so they can be shared
+    QDir source(modelSource);
+    QStringList files = source.entryList(QDir::Files);
+    for (int i = 0; i < files.size(); ++i) {
+        if (!exportCache::linkOrCopy(source.absoluteFilePath(files[i]), QDir(run->modelDir).absoluteFilePath(files[i]))) {
+            err = "Could not copy '" + files[i] + "' into '" + run->modelDir + "'";
+            return false;
         }
-#else
-        // handle python convert_scripts...
-        if (path.contains("python")) {
-            //isPython = true;
-            QStringList pathbits = path.split("python ");
-            qDebug() << pathbits;
-            if (pathbits.size() > 1) {
-                path = pathbits[0] + QString("python");
-                al << QDir::toNativeSeparators(pathbits[1]);
+    }
+    DBG() << "Prepared run" << run->dir;
+    return true;
+}
+
+/*!
+ * \brief viewELExptPanelHandler::removeOldRuns
+ * Remove the oldest runs in an experiment's directory, leaving room for a
+ * new one. Runs which are still queued or running are left alone.
+ */
+void viewELExptPanelHandler::removeOldRuns(QString exptDirName)
+{
+    QDir exptDir(exptDirName);
+    QStringList old = exptDir.entryList(QStringList() << "run-*", QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+    for (int i = 0; i + KEPT_RUNS - 1 < old.size(); ++i) {
+        QString path = exptDir.absoluteFilePath(old[i]);
+        bool active = false;
+        for (int j = 0; j < this->runs.size(); ++j) {
+            if (this->runs[j]->dir == path) {
+                active = true;
             }
         }
-        al << "-m" << modelpath                          // path to input model
-           << "-w" << wk_dir.absolutePath()              // path to SpineML_2_BRAHMS dir
-           << "-o" << out_dir_name                       // Output dir
-           << "-e" << QString("%1").arg(currentExptNum); // The experiment to execute
+        if (!active) {
+            DBG() << "Removing old run" << path;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+            QDir(path).removeRecursively();
 #endif
+        }
+    }
+}
 
-        // In settings we set REBUILD - apparently to be an
-        // environment variable. However, the way to set
-        // convert_script_s2b to rebuild is to pass a -r option.
-        settings.beginGroup("simulators/" + simName);
-        QString rebuild = settings.value("envVar/REBUILD").toString();
-        settings.endGroup();
-        if (rebuild == "true") {
-            al << "-r"; // Add the -r option for rebuilding components
-        } // else don't rebuild
-
-#ifndef Q_OS_WIN
-        DBG() << "(Unix) Starting with path: " << path << " arg list: " << al;
-        simulator->start(path,al);
-#else
-        if (simName == "BRAHMS") {
-            DBG() << "(Windows (BRAHMS)) Starting with path: " << path;
-            simulator->execute(path);
+QString viewELExptPanelHandler::latestLogPath(QString exptDirName)
+{
+    QDir exptDir(exptDirName);
+    QStringList runs = exptDir.entryList(QStringList() << "run-*", QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+    for (int i = runs.size() - 1; i >= 0; --i) {
+        QString logPath = exptDir.absoluteFilePath(runs[i]) + QDir::separator() + "out" + QDir::separator() + "log";
+        if (QDir(logPath).exists()) {
+            return logPath;
+        }
+    }
+    // the output of a run from before runs had directories of their own
+    return exptDir.absoluteFilePath("log");
+}
+
+int viewELExptPanelHandler::maxConcurrentRuns()
+{
+    QSettings settings;
+    return qMax(1, settings.value("simulation/max_concurrent_runs", QThread::idealThreadCount()).toInt());
+}
+
+/*!
+ * \brief viewELExptPanelHandler::startQueuedRuns
+ * Start the queued runs, in the order they were launched, while fewer than
+ * maxConcurrentRuns() are running.
+ */
+void viewELExptPanelHandler::startQueuedRuns()
+{
+    // an error box runs the event loop, which could come back here
+    if (this->startingRuns) {
+        return;
+    }
+    this->startingRuns = true;
+
+    int running = 0;
+    QVector <simulationRun *> waiting;
+    for (int i = 0; i < this->runs.size(); ++i) {
+        if (this->runs[i]->state == simulationRun::Running) {
+            ++running;
+        } else if (this->runs[i]->state == simulationRun::Queued) {
+            waiting.push_back(this->runs[i]);
+        }
+    }
+
+    int budget = maxConcurrentRuns();
+    for (int i = 0; i < waiting.size() && running < budget; ++i) {
+        // it may have been cancelled meanwhile
+        if (!this->runs.contains(waiting[i]) || waiting[i]->state != simulationRun::Queued) {
+            continue;
+        }
+        QString err;
+        if (this->startRun(waiting[i], err)) {
+            ++running;
         } else {
-            DBG() << "(Windows) Starting with path: " << path << " arg list: " << al;
-            simulator->start(path,al);
+            this->cleanUpPostRun(waiting[i], "Simulator Error", err);
         }
-#endif
     }
 
+    this->startingRuns = false;
+}
+
+/*!
+ * The position of a run's experiment in its project now, or -1 if it has
+ * been removed
+ */
+static int currentExptNum(nl_rootdata * data, simulationRun * run)
+{
+    if (run->project == data->currProject) {
+        return data->experiments.indexOf(run->expt);
+    }
+    return run->project->experimentList.indexOf(run->expt);
+}
+
+bool viewELExptPanelHandler::startRun(simulationRun * run, QString &err)
+{
+    // the experiment may have been moved while the run was queued. The
+    // snapshot numbers the experiments as they were when it was taken, so
+    // its file is renamed to match.
+    int exptNum = currentExptNum(this->data, run);
+    if (exptNum < 0) {
+        err = "The experiment was removed before its run could start.";
+        return false;
+    }
+    if (exptNum != run->exptNum) {
+        QDir model(run->modelDir);
+        QString queuedFile = "experiment" + QString::number(run->exptNum) + ".xml";
+        QString exptFile = "experiment" + QString::number(exptNum) + ".xml";
+        model.rename(exptFile, exptFile + ".moved");
+        if (!model.rename(queuedFile, exptFile)) {
+            err = "Could not renumber the experiment in '" + run->modelDir + "'";
+            return false;
+        }
+        model.rename(exptFile + ".moved", queuedFile);
+        run->exptNum = exptNum;
+    }
+
+    run->process = new QProcess;
+    // simulators which support it report their progress over a socket,
+    // the others through their time.txt
+    run->progress = new simulationProgress(run->expt->setup.duration, this);
+
+    connect(run->process, SIGNAL(finished(int,QProcess::ExitStatus)), this, SLOT(simulatorFinished(int, QProcess::ExitStatus)));
+    connect(run->process, SIGNAL(readyReadStandardOutput()), this, SLOT(simulatorStandardOutput()));
+    connect(run->process, SIGNAL(readyReadStandardError()), this, SLOT(simulatorStandardError()));
+    connect(run->progress, SIGNAL(progressed()), this, SLOT(simulatorProgressed()));
+
+    // before the simulator starts, as it clears out any old progress
+    run->progress->start(run->outDir);
+    run->command.start(run->process, run->modelDir, run->outDir, run->exptNum, run->progress);
+
     // Wait a couple of seconds for the process to start
-#ifndef Q_OS_WIN
-    if (!simulator->waitForStarted(10000)) {
+    if (!run->process->waitForStarted(10000)) {
         // Error - simulator failed to start. It would be great to get
-        // the output to show in the window. It may exist in wk_dir.absolutePath() / temp/run/out.log and err.log
-        this->cleanUpPostRun("Simulator Error", "The simulator '" + path + "' failed to start.");
-# if 0
-        // This call to delete the simulator appears to be dangerous -
-        // it is possible for waitForStarted to fail without the
-        // simulator crashing - in which case deleting the simulator
-        // causes a crash later on... for this reason I have left it
-        // as a memory leak
-        delete simulator;
-# endif
+        // the output to show in the window.
+        err = "The simulator '" + run->command.program + "' failed to start.";
+        return false;
+    }
+    run->state = simulationRun::Running;
+    DBG() << "Started run" << run->dir;
+    this->showRunState(run);
+
+    // and pick up logs as they are written
+    connect(&logFollowTimer, SIGNAL(timeout()), this, SLOT(followNewLogs()), Qt::UniqueConnection);
+    if (!logFollowTimer.isActive()) {
+        logFollowTimer.start(500);
+    }
+    return true;
+}
+
+simulationRun * viewELExptPanelHandler::findRun(QObject * object)
+{
+    for (int i = 0; i < this->runs.size(); ++i) {
+        if (this->runs[i]->process == object || this->runs[i]->progress == object) {
+            return this->runs[i];
+        }
+    }
+    return NULL;
+}
+
+void viewELExptPanelHandler::showRunState(simulationRun * run)
+{
+    if (!run->expt->runButton) {
         return;
     }
-#endif
+    if (run->state == simulationRun::Queued) {
+        run->expt->runButton->setText("Queued");
+        run->expt->runButton->setToolTip("Waiting for one of the " + QString::number(maxConcurrentRuns()) + " simulations allowed at once to finish");
+    } else if (run->state == simulationRun::Running) {
+        run->expt->runButton->setText("Running");
+        run->expt->runButton->setToolTip(run->dir);
+    }
+}
 
-#ifdef Q_OS_WIN
-    if (simName == "BRAHMS") {
-        settings.beginGroup("simulators/" + simName);
-        out_dir_name  = settings.value("working_dir").toString() + QDir::separator() + "temp";
-        settings.endGroup();
-        this->logpath = out_dir_name + QDir::separator() + "log";
-    } else {
-        if (!simulator->waitForStarted(1000)) {
-            // Error - simulator failed to start. It would be great to get
-            // the output to show in the window. It may exist in wk_dir.absolutePath() / temp/run/out.log and err.log
-            this->cleanUpPostRun("Simulator Error", "The simulator '" + path + "' failed to start.");
-            return;
+/*!
+ * \brief viewELExptPanelHandler::followNewLogs
+ * Load any log reports which have appeared in the running simulations' log
+ * directories since the last call, and put them into follow mode. The logs
+ * themselves then watch their files for new rows.
+ */
+void viewELExptPanelHandler::followNewLogs()
+{
+    bool running = false;
+    for (int i = 0; i < this->runs.size(); ++i) {
+        if (this->runs[i]->state == simulationRun::Running) {
+            running = true;
+            this->followNewLogs(this->runs[i]);
         }
     }
-#endif
+    if (!running) {
+        logFollowTimer.stop();
+    }
+}
 
-    connect(simulator, SIGNAL(finished(int,QProcess::ExitStatus)), this, SLOT(simulatorFinished(int, QProcess::ExitStatus)));
-    connect(simulator, SIGNAL(readyReadStandardOutput()), this, SLOT(simulatorStandardOutput()));
-    connect(simulator, SIGNAL(readyReadStandardError()), this, SLOT(simulatorStandardError()));
+void viewELExptPanelHandler::followNewLogs(simulationRun * run)
+{
+    if (!main->existsViewGV(run->expt)) {
+        return;
+    }
 
-    // now start a timer to check on the simulation progress
-    connect(&simTimeChecker, SIGNAL(timeout()), this, SLOT(checkForSimTime()));
-    this->simTimeMax = currentExperiment->setup.duration;
+    QDir logs(run->logPath);
+    QStringList filter;
+    filter << "*.xml";
+    logs.setNameFilters(filter);
 
-    this->simTimeFileName = QDir::toNativeSeparators(out_dir_name + QDir::separator() + "model" + QDir::separator() + "time.txt");
-    QFile::remove(simTimeFileName);
-    this->simCancelFileName = QDir::toNativeSeparators(out_dir_name + QDir::separator() + "model" + QDir::separator() + "stop.txt");
-    simTimeChecker.start(17);
+    QStringList fresh;
+    QStringList files = logs.entryList();
+    for (int i = 0; i < files.size(); ++i) {
+        if (!run->followedLogs.contains(files[i])) {
+            fresh.push_back(files[i]);
+        }
+    }
+    if (fresh.isEmpty()) {
+        return;
+    }
+
+    this->loadRunLogs(run, fresh, logs);
+
+    // Follow those which loaded; a report which is still being written will
+    // fail to load and is tried again next time
+    viewGVpropertieslayout* props = main->viewGV[run->expt]->properties;
+    for (int i = 0; i < fresh.size(); ++i) {
+        QString xmlName = logs.absoluteFilePath(fresh[i]);
+        for (int j = 0; j < props->vLogData.size(); ++j) {
+            if (props->vLogData[j]->logFileXMLname == xmlName) {
+                props->vLogData[j]->setFollowing(true);
+                run->followedLogs.push_back(fresh[i]);
+            }
+        }
+    }
+}
+
+/*!
+ * \brief viewELExptPanelHandler::loadRunLogs
+ * Load the given logs of a run into its experiment's graphs. A log already
+ * loaded from an earlier run of the experiment is moved onto this run's,
+ * so the plots made from it show the new run.
+ */
+void viewELExptPanelHandler::loadRunLogs(simulationRun * run, QStringList files, QDir &logs)
+{
+    viewGVpropertieslayout* props = main->viewGV[run->expt]->properties;
+    QString exptDir = QFileInfo(run->dir).absolutePath();
+    for (int j = 0; j < props->vLogData.size(); ++j) {
+        logData * log = props->vLogData[j];
+        QFileInfo info(log->logFileXMLname);
+        if (!files.contains(info.fileName()) || info.absolutePath() == logs.absolutePath()
+                || !info.absoluteFilePath().startsWith(exptDir)) {
+            continue;
+        }
+        // only once the new report can be read
+        QString previous = log->logFileXMLname;
+        log->logFileXMLname = logs.absoluteFilePath(info.fileName());
+        if (!log->setupFromXML()) {
+            log->logFileXMLname = previous;
+            log->setupFromXML();
+        }
+    }
+
+    props->populateVLogData (files, &logs);
+    props->currentLogDataDir = run->logPath;
+
+    // and insert logs into visualiser
+    if (data->main->viewVZ.OpenGLWidget != NULL) {
+        data->main->viewVZ.OpenGLWidget->addLogs(&props->vLogData);
+    }
+}
+
+void viewELExptPanelHandler::stopFollowingLogs(simulationRun * run)
+{
+    if (main->existsViewGV(run->expt)) {
+        viewGVpropertieslayout* props = main->viewGV[run->expt]->properties;
+        for (int j = 0; j < props->vLogData.size(); ++j) {
+            // reads the last rows, and saves each log's summary index
+            props->vLogData[j]->setFollowing(false);
+        }
+    }
+    run->followedLogs.clear();
 }
 
 /*!
  * \brief viewELExptPanelHandler::cleanUpPostRun
+ * \param run
  * \param msg
  * \param msgDetail
  * If a run ends due to being aborted (user or code) or successfully we have to do some clean up - this
  * was duplicated code so it is now merged into this function. Can pass an optional error message and
- * message detail.
+ * message detail. The run is taken out of the registry and deleted, and any
+ * queued run waiting for it is started.
  */
-void viewELExptPanelHandler::cleanUpPostRun(QString msg, QString msgDetail) {
+void viewELExptPanelHandler::cleanUpPostRun(simulationRun * run, QString msg, QString msgDetail) {
     if (!msg.isEmpty()) {
         QMessageBox msgBox;
         msgBox.setWindowTitle(msg);
@@ -2135,118 +2336,156 @@ void viewELExptPanelHandler::cleanUpPostRun(QString msg, QString msgDetail) {
         msgBox.setText(msgDetail);
         msgBox.exec();
     }
-    if (this->runExpt) {
-        if (this->runExpt->runButton) {
-            this->runExpt->runButton->disconnect(this);
-            this->runExpt->runButton->setText("Run experiment");
+
+    int index = this->runs.indexOf(run);
+    if (index >= 0) {
+        this->runs.remove(index);
+    }
+
+    // the experiment's button goes back to Run once none of its runs are left
+    bool exptRunning = false;
+    for (int i = 0; i < this->runs.size(); ++i) {
+        if (this->runs[i]->expt == run->expt) {
+            exptRunning = true;
+        }
+    }
+    if (!exptRunning) {
+        if (run->expt->runButton) {
+            run->expt->runButton->disconnect(this);
+            run->expt->runButton->setText("Run experiment");
+            run->expt->runButton->setToolTip("");
             QCommonStyle style;
-            this->runExpt->runButton->setIcon(style.standardIcon(QStyle::SP_MediaPlay));
-            connect(this->runExpt->runButton, SIGNAL(clicked()), this, SLOT(run()));
+            run->expt->runButton->setIcon(style.standardIcon(QStyle::SP_MediaPlay));
+            connect(run->expt->runButton, SIGNAL(clicked()), this, SLOT(run()));
         }
-        this->runExpt->running = false;
-        this->runExpt = NULL;
+        run->expt->running = false;
     }
+
+    if (run->state == simulationRun::Running) {
+        this->stopFollowingLogs(run);
+    }
+    if (run->progress) {
+        run->progress->disconnect(this);
+        run->progress->deleteLater();
+    }
+    if (run->process) {
+        run->process->disconnect(this);
+        run->process->deleteLater();
+    }
+    delete run;
+
+    // start whatever was waiting for it
+    QTimer::singleShot(0, this, SLOT(startQueuedRuns()));
 }
 
 /*!
  * \brief viewELExptPanelHandler::cancelRun
  * This function writes a file that can then be picked up by compatible simulators.
  * The presence of the file causes the simulator to stop running and save logs.
+ * The runs of the experiment whose button was pressed are stopped; those
+ * still queued are dropped.
  */
 void viewELExptPanelHandler::cancelRun() {
 
-    if (!runExpt) return;
+    QVector <simulationRun *> cancelling;
+    for (int i = 0; i < this->runs.size(); ++i) {
+        if (this->runs[i]->expt->runButton == sender()) {
+            cancelling.push_back(this->runs[i]);
+        }
+    }
 
-    QFile simCancelFile(simCancelFileName);
+    for (int i = 0; i < cancelling.size(); ++i) {
+        simulationRun * run = cancelling[i];
+        if (run->state == simulationRun::Queued) {
+            this->cleanUpPostRun(run, "", "");
+            continue;
+        }
 
-    simCancelFile.open(QFile::WriteOnly);
-    simCancelFile.close();
+        QFile simCancelFile(run->cancelFileName);
+
+        simCancelFile.open(QFile::WriteOnly);
+        simCancelFile.close();
 
 #ifdef Q_OS_WIN
-    Sleep(2000);
-    this->simulatorFinished(0,QProcess::NormalExit);
+        Sleep(2000);
+        this->runFinished(run, QProcess::NormalExit);
 #endif
-
+    }
 }
 
 /*!
- * \brief viewELExptPanelHandler::checkForSimTime
- * This function is used to pick up the infromation left by a simulator, and
- * use it to provide progress feedback to the user. This is done via access to a
- * file called 'time.txt' which is currently located in the simulation model folder.
- *
+ * \brief viewELExptPanelHandler::simulatorProgressed
+ * Show the progress reported by the simulator on the run button and its
+ * progress bar. Updates are already coalesced by simulationProgress, and the
+ * bar is only restyled when it has moved.
  */
-void viewELExptPanelHandler::checkForSimTime() {
-
-    if (!runExpt) return;
+void viewELExptPanelHandler::simulatorProgressed() {
 
-    QFile simTimeFile(simTimeFileName);
-
-    simTimeFile.open(QFile::ReadOnly);
-
-    if (simTimeFile.isOpen()) {
-        float simTimeCurr = 0;
-        QTextStream tStream(&simTimeFile);
-        QString line = tStream.readLine();
-        if (line.contains("*")) {
-            if (runExpt->runButton) {
-                runExpt->runButton->setText(line);
-            }
-        } else {
-            simTimeCurr = line.toFloat();
-            // update the UI progress bar
-            if (runExpt->runButton) {
-                runExpt->runButton->setText("Running: " + QString::number(simTimeCurr) + "ms");
-                float proportion = simTimeCurr / (this->simTimeMax*1000);
-                runExpt->progressBar->setStyleSheet(QString("QLabel {background-color: qlineargradient(spread:pad, x1:0, y1:0, x2:1, y2:0, stop:0 rgba(150, 255, 150, 255), ") \
-                                       + QString("stop:") + QString::number(proportion) + QString(" rgba(150, 255, 150, 255), stop:")  + QString::number(proportion+0.01) + QString(" rgba(150, 255, 150, 0), stop:1 rgba(255, 255, 255, 0))}"));
+    simulationRun * run = this->findRun(sender());
+    if (!run || run->state != simulationRun::Running) return;
 
-            }
+    experiment * runExpt = run->expt;
+    float simTimeCurr = run->progress->getSimTime();
+    QString message = run->progress->getMessage();
+    if (!message.isEmpty()) {
+        if (runExpt->runButton) {
+            runExpt->runButton->setText(message);
         }
-#ifdef Q_OS_WIN
-    experiment * currentExperiment;
-    // find currentExperiment
-    for (int i = 0; i < data->experiments.size(); ++i) {
-        if (data->experiments[i]->selected) {
-            currentExperiment = data->experiments[i];
-            //currentExptNum = i;
-            break;
+    } else if (runExpt->runButton) {
+        // update the UI progress bar
+        runExpt->runButton->setText("Running: " + QString::number(simTimeCurr) + "ms");
+        runExpt->runButton->setToolTip(QString::number(run->progress->getWallTime() / 1000.0, 'f', 1) + "s elapsed, "
+                                       + QString::number(run->progress->getThroughput(), 'f', 1) + " simulated ms per s");
+        int shown = (int) (run->progress->getFraction() * 1000);
+        if (shown != run->shownProgress && runExpt->progressBar) {
+            run->shownProgress = shown;
+            float proportion = shown / 1000.0;
+            runExpt->progressBar->setStyleSheet(QString("QLabel {background-color: qlineargradient(spread:pad, x1:0, y1:0, x2:1, y2:0, stop:0 rgba(150, 255, 150, 255), ") \
+                                   + QString("stop:") + QString::number(proportion) + QString(" rgba(150, 255, 150, 255), stop:")  + QString::number(proportion+0.01) + QString(" rgba(150, 255, 150, 0), stop:1 rgba(255, 255, 255, 0))}"));
         }
     }
-
-    if (currentExperiment == NULL) {
-        return;
-    }
-
+#ifdef Q_OS_WIN
     // check if we have finished...
-    if (currentExperiment->setup.simType == "BRAHMS") {
-        if (simTimeCurr > this->simTimeMax*1000-0.2) {
+    if (runExpt->setup.simType == "BRAHMS") {
+        if (simTimeCurr > runExpt->setup.duration*1000-0.2) {
             Sleep(2000);
-            this->simulatorFinished(0,QProcess::NormalExit);
+            this->runFinished(run, QProcess::NormalExit);
         }
     }
 #endif
-        simTimeFile.close();
-    }
 }
 
 void viewELExptPanelHandler::simulatorFinished(int, QProcess::ExitStatus status)
 {
-    // stop updating the bar
-    simTimeChecker.disconnect();
-    simTimeChecker.stop();
-    QFile::remove(simCancelFileName);
-
-    // find currentExperiment (could make use of MainWindow::getCurrentExpt)
-    experiment* currentExperiment = (experiment*)0;
-    for (int i = 0; i < data->experiments.size(); ++i) {
-        if (data->experiments[i]->selected) {currentExperiment = data->experiments[i]; break;}
+    simulationRun * run = this->findRun(sender());
+    if (run) {
+        this->runFinished(run, status);
     }
-    if (currentExperiment == (experiment*)0) {
-        this->cleanUpPostRun("", "");
+}
+
+void viewELExptPanelHandler::runFinished(simulationRun * run, QProcess::ExitStatus status)
+{
+    if (run->state != simulationRun::Running) {
         return;
     }
 
+    // stop updating the bar
+    run->progress->disconnect(this);
+    run->progress->stop();
+    DBG() << "Simulated" << run->progress->getSimTime() << "ms in" << run->progress->getWallTime() << "ms";
+    this->stopFollowingLogs(run);
+    run->state = simulationRun::Finished;
+    QFile::remove(run->cancelFileName);
+
+    // keep what the simulator said with the run
+    QFile consoleLog(run->dir + QDir::separator() + "simulator.log");
+    if (consoleLog.open(QIODevice::WriteOnly)) {
+        consoleLog.write(run->stdOutText.toUtf8());
+        consoleLog.close();
+    }
+
+    experiment * currentExperiment = run->expt;
+
     float proportion = 0;
     if (currentExperiment->progressBar) {
         currentExperiment->progressBar->setStyleSheet(QString("QLabel {background-color: qlineargradient(spread:pad, x1:0, y1:0, x2:1, y2:0, stop:0 rgba(150, 255, 150, 0), ") \
@@ -2254,37 +2493,26 @@ void viewELExptPanelHandler::simulatorFinished(int, QProcess::ExitStatus status)
     }
 
     // check for errors we can present
-    for (int i = 0; i < (int) errorStrings.size(); ++i) {
+    for (int i = 0; i < (int) run->errorStrings.size(); ++i) {
 
         // check if error there
-        if (simulatorStdOutText.contains(errorStrings[i])) {
+        if (run->stdOutText.contains(run->errorStrings[i])) {
             // error found
             QMessageBoxResizable msgBox;
             msgBox.setWindowTitle("Simulator Error Report");
             msgBox.setIcon(QMessageBox::Critical);
-            msgBox.setText(errorMessages[i]);
-            msgBox.setDetailedText(simulatorStdOutText);
+            msgBox.setText(run->errorMessages[i]);
+            msgBox.setDetailedText(run->stdOutText);
             msgBox.addButton(QMessageBox::Ok);
             msgBox.setDefaultButton(QMessageBox::Ok);
             msgBox.exec();
-            this->cleanUpPostRun("", "");
+            this->cleanUpPostRun(run, "", "");
             return;
         }
     }
 
     // collect logs
-#ifndef Q_OS_WIN
-    // Update the view of the logfiles
-    QDir logs(sender()->property("logpath").toString());
-#else
-
-    QDir logs;
-    if (currentExperiment->setup.simType == "BRAHMS") {
-        logs = QDir(QString(this->logpath));
-    } else {
-        logs = QDir(sender()->property("logpath").toString());
-    }
-#endif
+    QDir logs(run->logPath);
 
     QStringList filter;
     filter << "*.xml";
@@ -2294,12 +2522,7 @@ void viewELExptPanelHandler::simulatorFinished(int, QProcess::ExitStatus status)
     // First ensure viewGV[currentExperiment] exists. if not, do nothing?
     if (main->existsViewGV(currentExperiment)) {
         DBG() << "viewGV exists for currentExperiment; updating logdata etc.";
-        data->main->viewGV[currentExperiment]->properties->populateVLogData (logs.entryList(), &logs);
-
-        // and insert logs into visualiser
-        if (data->main->viewVZ.OpenGLWidget != NULL) {
-            data->main->viewVZ.OpenGLWidget->addLogs(&data->main->viewGV[currentExperiment]->properties->vLogData);
-        }
+        this->loadRunLogs(run, logs.entryList(), logs);
     } else {
         DBG() << "viewGV didn't exist for currentExperiment, so not updating logdata etc.";
     }
@@ -2308,45 +2531,52 @@ void viewELExptPanelHandler::simulatorFinished(int, QProcess::ExitStatus status)
     if (status == QProcess::CrashExit) {
         QMessageBox msgBox;
         msgBox.setWindowTitle("Simulator Crash");
-        msgBox.setText(simulatorStdErrText);
+        msgBox.setText(run->stdErrText);
         msgBox.addButton(QMessageBox::Ok);
         msgBox.setDefaultButton(QMessageBox::Ok);
         msgBox.exec();
-        this->cleanUpPostRun("", "");
+        this->cleanUpPostRun(run, "", "");
         return;
     }
 
     if (status == QProcess::NormalExit) {
         // check if we are running in batch mode (i.e. run button is not set)
-        if (this->runExpt->runButton) {
+        if (currentExperiment->runButton) {
             QMessageBoxResizable msgBox;
             msgBox.setWindowTitle("Simulator Complete");
             msgBox.setIcon(QMessageBox::Information);
             msgBox.setText("Simulator has finished. See below for more details.");
-            msgBox.setDetailedText(simulatorStdOutText);
+            msgBox.setDetailedText(run->stdOutText);
             msgBox.addButton(QMessageBox::Ok);
             msgBox.setDefaultButton(QMessageBox::Ok);
             msgBox.exec();
         }
         // signal others
-        this->cleanUpPostRun("", "");
+        this->cleanUpPostRun(run, "", "");
         emit simulationDone();
         return;
     }
 
-    this->cleanUpPostRun("", "");
+    this->cleanUpPostRun(run, "", "");
 }
 
 void viewELExptPanelHandler::simulatorStandardOutput()
 {
     QByteArray data = ((QProcess *) sender())->readAllStandardOutput();
-    simulatorStdOutText = simulatorStdOutText + QString().fromUtf8(data);
+    simulationRun * run = this->findRun(sender());
+    if (run) {
+        run->stdOutText = run->stdOutText + QString().fromUtf8(data);
+    }
 }
 
 void viewELExptPanelHandler::simulatorStandardError()
 {
     QByteArray data = ((QProcess *) sender())->readAllStandardError();
-    simulatorStdOutText = simulatorStdOutText + QString().fromUtf8(data);
+    simulationRun * run = this->findRun(sender());
+    if (run) {
+        run->stdOutText = run->stdOutText + QString().fromUtf8(data);
+        run->stdErrText = run->stdErrText + QString().fromUtf8(data);
+    }
 }
 
 void viewELExptPanelHandler::mouseMove(float xGL, float yGL)
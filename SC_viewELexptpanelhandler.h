@@ -26,12 +26,61 @@
 #define VIEWVISEXPTPANELHANDLER_H
 
 #include "globalHeader.h"
+#include "SC_experiment_sweep.h"
 
 #if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
   #include <QTemporaryDir>
 #endif
 
 struct viewELstruct;
+class simulationProgress;
+
+/*!
+ * How many earlier runs of an experiment are kept in its output directory.
+ */
+#define KEPT_RUNS 5
+
+/*!
+ * \brief A simulation launched from the experiment panel. Each launch has a
+ * directory of its own, holding a snapshot of the model as it was when Run
+ * was pressed, the simulator's output and its console log, so several can
+ * run at once.
+ */
+struct simulationRun
+{
+    enum runState {
+        Queued,
+        Running,
+        Finished
+    };
+
+    experiment * expt;
+    // the experiment's number in the model snapshot; it is renumbered when
+    // the run starts if the experiment has been moved meanwhile
+    int exptNum;
+    projectObject * project;
+    simulatorCommand command;
+
+    // the run directory, with the model snapshot in model/ and the
+    // simulator's output in out/
+    QString dir;
+    QString modelDir;
+    QString outDir;
+    QString logPath;
+    QString cancelFileName;
+
+    runState state;
+    QProcess * process;
+    simulationProgress * progress;
+    // the progress last drawn on the bar, in tenths of a percent
+    int shownProgress;
+
+    QString stdOutText;
+    QString stdErrText;
+    QStringList errorStrings;
+    QStringList errorMessages;
+    QStringList followedLogs;
+};
 
 
 class viewELExptPanelHandler : public QObject
@@ -40,6 +89,7 @@ class viewELExptPanelHandler : public QObject
 public:
     explicit viewELExptPanelHandler(QObject *parent = 0);
     explicit viewELExptPanelHandler(viewELstruct * viewEL, nl_rootdata * data, QObject *parent = 0);
+    ~viewELExptPanelHandler();
     nl_rootdata * data;
     //void redraw();
 
@@ -48,6 +98,19 @@ public:
      */
     MainWindow* main;
 
+    /*!
+     * The log directory of the latest run of an experiment, given the
+     * experiment's output directory.
+     */
+    static QString latestLogPath(QString exptDirName);
+
+    /*!
+     * The most simulations run from the experiment panel at once, as set in
+     * the settings. Further runs wait for one of them to finish. Sweeps have
+     * a limit of their own, which starts at this, and are not counted.
+     */
+    static int maxConcurrentRuns();
+
 private:
     viewELstruct * viewEL;
     void redrawExpt();
@@ -68,12 +131,6 @@ private:
     QVBoxLayout * exptOutputs;
     QVBoxLayout * exptChanges;
 
-    QString simulatorStdOutText;
-    QString simulatorStdErrText;
-
-    QStringList errorStrings;
-    QStringList errorMessages;
-
     QVector <QWidget * > forDeleting;
 
     void recursiveDeleteLoop(QLayout * parentLayout);
@@ -94,16 +151,36 @@ private:
 
     GLWidget * gl;
 
-    QTimer simTimeChecker;
-    QString simTimeFileName;
-    QString simCancelFileName;
-#ifdef Q_OS_WIN
-    QString logpath;
-#endif
-    float simTimeMax;
-    experiment * runExpt;
+    /*!
+     * The runs launched from the panel which are queued or running, in the
+     * order they were launched.
+     */
+    QVector <simulationRun *> runs;
+
+    /*!
+     * Whether any of project's runs are queued or running.
+     */
+    bool hasRuns(projectObject * project);
+
+    bool startingRuns;
+    bool prepareRun(simulationRun * run, QString modelSource, QString &err);
+    void removeOldRuns(QString exptDirName);
+    bool startRun(simulationRun * run, QString &err);
+    void runFinished(simulationRun * run, QProcess::ExitStatus status);
+    simulationRun * findRun(QObject * object);
+    void showRunState(simulationRun * run);
+
+    /*!
+     * While a simulation runs, its log directory is checked for new log
+     * reports, which are loaded in follow mode so that plots grow as the
+     * simulator writes its logs.
+     */
+    QTimer logFollowTimer;
+    void followNewLogs(simulationRun * run);
+    void loadRunLogs(simulationRun * run, QStringList files, QDir &logs);
+    void stopFollowingLogs(simulationRun * run);
 
-    void cleanUpPostRun(QString, QString);
+    void cleanUpPostRun(simulationRun * run, QString, QString);
 
 signals:
     void enableRun(bool);
@@ -123,6 +200,7 @@ public slots:
     void changedDuration();
     void changedSolver(int);
     void changedSolverOrder(int);
+    void changedProcedure(int);
     void addInput();
     void setInputName();
     void setInputComponent();
@@ -180,7 +258,9 @@ public slots:
     void simulatorFinished(int, QProcess::ExitStatus);
     void simulatorStandardOutput();
     void simulatorStandardError();
-    void checkForSimTime();
+    void simulatorProgressed();
+    void followNewLogs();
+    void startQueuedRuns();
 
     /*!
      * \brief Called when the mouse moves on the model view
@@ -24,6 +24,7 @@
 
 #include <QApplication>
 #include "mainwindow.h"
+#include "SC_batch_runner.h"
 
 // A global for a fixed qhash, which should work between machines. See:
 // http://stackoverflow.com/questions/27378143/qt-5-produce-random-attribute-order-in-xml
@@ -39,8 +40,32 @@ int main(int argc, char *argv[])
 #endif
 
 
+    // --batch runs projects without a display, so use the offscreen
+    // platform unless another has been asked for
+    bool batch = false;
+    for (int i = 1; i < argc; ++i) {
+        if (QString(argv[i]) == "--batch") {
+            batch = true;
+        }
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    if (batch && qgetenv("QT_QPA_PLATFORM").isEmpty()) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+#endif
+
     QApplication a(argc, argv);
     a.setAttribute(Qt::AA_DontCreateNativeWidgetSiblings, true);
+
+    QCoreApplication::setOrganizationName("SpineML");
+    QCoreApplication::setOrganizationDomain("sheffield.ac.uk");
+    QCoreApplication::setApplicationName("SpineCreator");
+
+    if (batch) {
+        batchRunner runner;
+        return runner.exec(a.arguments());
+    }
+
     MainWindow w;
     w.show();
     // Some features that we switch on if possible:
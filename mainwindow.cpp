@@ -43,6 +43,7 @@
 #include "EL_experiment.h"
 #include <QCryptographicHash>
 #include "SC_undocommands.h"
+#include "SC_python_connection_worker.h"
 #include "SC_versioncontrol.h"
 #include "qcustomplot.h"
 #include "SC_projectobject.h"
@@ -63,24 +64,11 @@
 #include "qdebug.h"
 #include "SC_aboutdialog.h"
 
+// the main thread's Python state, while it isn't holding the GIL
+static PyThreadState * pyMainThreadState = NULL;
 
-MainWindow::
-MainWindow(QWidget *parent) :
-    QMainWindow(parent),
-    ui(new Ui::MainWindow),
-    maxRecentFiles(12) // Number of files which show in the recent projects menu
+void MainWindow::initialisePython()
 {
-
-    data.main = this;
-    this->setWindowTitle("SpineCreator - Graphical SNN creation");
-
-    QCoreApplication::setOrganizationName("SpineML");
-    QCoreApplication::setOrganizationDomain("sheffield.ac.uk");
-    QCoreApplication::setApplicationName("SpineCreator");
-
-    // initialise GUI
-    ui->setupUi(this);
-
 #define PYTHON_NO_DEBUG
 #ifdef PYTHON_NO_DEBUG
 
@@ -161,7 +149,42 @@ MainWindow(QWidget *parent) :
         QSettings pysettings2;
         pysettings2.setValue ("python/initialisation", "false");
     }
+
+    // Connection scripts are run on the pythonConnectionWorker thread, so
+    // release the GIL here; it is taken by whichever thread runs Python.
+#if PY_VERSION_HEX < 0x03070000
+    PyEval_InitThreads();
 #endif
+    pyMainThreadState = PyEval_SaveThread();
+#endif
+
+}
+
+void MainWindow::finalisePython()
+{
+    // clear up python, once the connection scripts are stopped
+    pythonConnectionWorker::shutdown();
+    if (pyMainThreadState != NULL) {
+        PyEval_RestoreThread(pyMainThreadState);
+        pyMainThreadState = NULL;
+    }
+    Py_Finalize();
+}
+
+MainWindow::
+MainWindow(QWidget *parent) :
+    QMainWindow(parent),
+    ui(new Ui::MainWindow),
+    maxRecentFiles(12) // Number of files which show in the recent projects menu
+{
+
+    data.main = this;
+    this->setWindowTitle("SpineCreator - Graphical SNN creation");
+
+    // initialise GUI
+    ui->setupUi(this);
+
+    MainWindow::initialisePython();
 
 #ifdef DEBUG
     DBG() << "Python interpreter: " << (wchar_t*)Py_GetProgramName();
@@ -745,7 +768,8 @@ void MainWindow::updateDatas (void)
     DBG() << "Current expt num is " << currentExptNum;
 
     // Build up the correct log path (compare with code in
-    // SC_viewELexptpanelhander.cpp)
+    // SC_viewELexptpanelhander.cpp) - the latest run's, as each run has a
+    // directory of its own
     if (currentExptNum != -1) {
         QSettings settings;
         QString simName = currentExperiment->setup.simType;
@@ -757,7 +781,7 @@ void MainWindow::updateDatas (void)
         QString out_dir_name = wk_dir.absolutePath() + QDir::separator() + "temp"
             + QDir::separator() + data.currProject->getFilenameFriendlyName()
             + "_e" + QString::number(currentExptNum);
-        QString perexpt_logpath = out_dir_name + QDir::separator() + "log";
+        QString perexpt_logpath = viewELExptPanelHandler::latestLogPath(out_dir_name);
         QDir logs(perexpt_logpath);
         QStringList filter;
         filter << "*.xml";
@@ -909,8 +933,7 @@ MainWindow::~MainWindow()
         this->viewVZ.layout.clear();
     }
 
-    // clear up python
-    Py_Finalize();
+    MainWindow::finalisePython();
 
     // Ensure viewELhandler's destructor is called to clean up temporary model directory
     delete this->viewELhandler;
@@ -1882,6 +1905,16 @@ void MainWindow::export_project_as()
 
 void MainWindow::close_project()
 {
+    // the runs point into the project's experiments
+    if (this->viewELhandler->hasRuns(data.currProject)) {
+        QMessageBox msgBox(this);
+        msgBox.setIcon(QMessageBox::Warning);
+        msgBox.setText("<b>Simulations are running!                </b>");
+        msgBox.setInformativeText("Project '" + data.currProject->name + "' has simulations queued or running. Cancel them, or wait for them to finish, before closing it.");
+        msgBox.exec();
+        return;
+    }
+
     // check
     if (data.currProject->isChanged(&data)) {
         if (!promptToSave()) {
@@ -122,6 +122,20 @@ class MainWindow : public QMainWindow
 public:
     explicit MainWindow(QWidget *parent = 0);
     ~MainWindow();
+
+    /*!
+     * Start the embedded Python interpreter, using the python/programname
+     * and python/pythonhome settings, and release the GIL for the
+     * connection script threads. Called by the constructor, and by the
+     * batch runner, which has no MainWindow.
+     */
+    static void initialisePython();
+
+    /*!
+     * Stop the connection script worker and shut Python down.
+     */
+    static void finalisePython();
+
     nl_rootdata data;
     QUndoGroup * undoStacks;
 
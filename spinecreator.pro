@@ -46,7 +46,18 @@ SOURCES += main.cpp \
     SC_export_network_image.cpp \
     NL_genericinput.cpp \
     SC_python_connection_generate_dialog.cpp \
+    SC_python_connection_worker.cpp \
+    SC_python_connection_pool.cpp \
+    SC_experiment_sweep.cpp \
+    SC_experiment_sweep_dialog.cpp \
+    SC_batch_runner.cpp \
+    SC_error_reporter.cpp \
+    SC_export_cache.cpp \
+    SC_simulation_progress.cpp \
     SC_logged_data.cpp \
+    SC_logged_data_summary.cpp \
+    SC_logged_data_events.cpp \
+    SC_logged_data_text.cpp \
     SC_component_scene.cpp \
     SC_component_view.cpp \
     SC_component_propertiesmanager.cpp \
@@ -62,7 +73,9 @@ SOURCES += main.cpp \
     SC_viewVZlayoutedithandler.cpp \
     SC_layout_cinterpreter.cpp \
     SC_network_2d_visualiser_panel.cpp \
-    SC_network_3d_visualiser_panel.cpp
+    SC_network_3d_visualiser_panel.cpp \
+    SC_network_3d_neuron_renderer.cpp \
+    SC_network_3d_synapse_renderer.cpp
 
 HEADERS += mainwindow.h \
     globalHeader.h \
@@ -95,7 +108,18 @@ HEADERS += mainwindow.h \
     SC_export_network_image.h \
     NL_genericinput.h \
     SC_python_connection_generate_dialog.h \
+    SC_python_connection_worker.h \
+    SC_python_connection_pool.h \
+    SC_experiment_sweep.h \
+    SC_experiment_sweep_dialog.h \
+    SC_batch_runner.h \
+    SC_error_reporter.h \
+    SC_export_cache.h \
+    SC_simulation_progress.h \
     SC_logged_data.h \
+    SC_logged_data_summary.h \
+    SC_logged_data_events.h \
+    SC_logged_data_text.h \
     SC_component_scene.h \
     SC_component_view.h \
     SC_component_propertiesmanager.h \
@@ -111,7 +135,9 @@ HEADERS += mainwindow.h \
     SC_viewVZlayoutedithandler.h \
     SC_layout_cinterpreter.h \
     SC_network_2d_visualiser_panel.h \
-    SC_network_3d_visualiser_panel.h
+    SC_network_3d_visualiser_panel.h \
+    SC_network_3d_neuron_renderer.h \
+    SC_network_3d_synapse_renderer.h
 
 FORMS += mainwindow.ui \
     valuelistdialog.ui \